@@ -0,0 +1,100 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_COMPACT_GRAPH_H
+#define __CONMAN_COMPACT_GRAPH_H
+
+#include <vector>
+#include <utility>
+
+#include <boost/unordered_map.hpp>
+
+#include <rtt/RTT.hpp>
+
+namespace conman
+{
+  namespace graph
+  {
+    //! Dense integer identifier of a block in a \ref CompactModel
+    typedef unsigned int BlockId;
+
+    /** \brief Compressed sparse row (CSR) adjacency lists
+     *
+     * The neighbors of vertex \c v are stored contiguously in \ref targets
+     * between \c offsets[v] and \c offsets[v+1], sorted by id and without
+     * duplicates.
+     */
+    struct CompactAdjacency
+    {
+      //! The start of each vertex's neighbors in \ref targets (n_vertices+1)
+      std::vector<unsigned int> offsets;
+      //! The neighbors of all vertices
+      std::vector<BlockId> targets;
+
+      //! Build the adjacency lists from a list of (source, target) pairs
+      void build(
+          const size_t n_vertices,
+          std::vector<std::pair<BlockId, BlockId> > edges);
+
+      //! Remove all vertices and edges
+      void clear();
+
+      //! Get the number of neighbors of a vertex
+      size_t degree(const BlockId v) const
+      {
+        return offsets[v+1] - offsets[v];
+      }
+
+      //! Get a pointer to the first neighbor of a vertex
+      const BlockId* begin(const BlockId v) const
+      {
+        return targets.empty() ? NULL : &targets[0] + offsets[v];
+      }
+
+      //! Get a pointer past the last neighbor of a vertex
+      const BlockId* end(const BlockId v) const
+      {
+        return targets.empty() ? NULL : &targets[0] + offsets[v+1];
+      }
+    };
+
+    /** \brief Frozen snapshot of a Scheme's ESG
+     *
+     * The Boost graphs used to model a scheme store shared pointers in list
+     * based containers, which is convenient while blocks are being added and
+     * removed, but slow to traverse. Since the topology can't change while a
+     * scheme is running, the scheme copies its execution order and ESG into
+     * flat arrays when it starts, and compiles execution plans from them
+     * until it's stopped. Conflicts are already kept in a dense bit matrix,
+     * so they aren't copied.
+     *
+     * Block ids are assigned in execution order, so iterating over \ref
+     * blocks visits the blocks in a valid serial schedule.
+     */
+    struct CompactModel
+    {
+      //! The blocks, indexed by id
+      std::vector<RTT::TaskContext*> blocks;
+      //! The scheme's vertex index of each block, indexed by id
+      std::vector<unsigned int> indices;
+      //! A map from blocks onto their ids
+      boost::unordered_map<RTT::TaskContext*, BlockId> ids;
+
+      //! Execution Scheduling Graph (ESG) successors and predecessors
+      CompactAdjacency exec_out, exec_in;
+
+      //! Get the number of blocks in the model
+      size_t size() const { return blocks.size(); }
+
+      //! Get the id of a block, returns false if it isn't in the model
+      bool getId(RTT::TaskContext *block, BlockId &id) const;
+
+      //! Remove all blocks
+      void clear();
+    };
+  }
+}
+
+#endif // ifndef __CONMAN_COMPACT_GRAPH_H
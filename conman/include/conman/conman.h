@@ -22,12 +22,15 @@
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/graph/topological_sort.hpp>
 #include <boost/graph/labeled_graph.hpp>
+#include <boost/dynamic_bitset.hpp>
 
 //! Conman Controller Manager
 namespace conman 
 {
   //! Forward declarations
   class Hook;
+  class HookService;
+  class OutputGate;
 
   namespace graph 
   {
@@ -47,6 +50,22 @@ namespace conman
       RTT::TaskContext *block;
       //! The conman Hook service for this block (cached pointer)
       boost::shared_ptr<conman::Hook> hook;
+      /** \brief The conman HookService for this block (cached pointer)
+       *
+       * The scheme and its blocks live in the same process, so the scheme
+       * calls the service directly instead of going through the \ref hook
+       * OperationCallers, which remain available for scripting.
+       */
+      conman::HookService *hook_service;
+      /** \brief The gate on this block's outputs for hot standby
+       *
+       * This is NULL until the block is first put into standby (see
+       * Scheme::standbyBlock). It's emptied, but kept, when the block is
+       * disabled, since the published execution plan might still refer to it.
+       * A block stopped by a mode switch keeps its relays, with the gate open,
+       * until the execution plan is recompiled.
+       */
+      boost::shared_ptr<conman::OutputGate> gate;
     };
 
     //! Boost Graph Edge Metadata for Data Flow Graph
@@ -54,9 +73,16 @@ namespace conman
     {
       typedef boost::shared_ptr<DataFlowEdge> Ptr;
 
+      DataFlowEdge() :
+        latched(false),
+        latch_cost(1.0) { }
+
       //! If true, execution scheduling does not consider this edge as a constraint
       bool latched;
 
+      //! The relative cost of latching this edge (see Scheme::latchFeedback)
+      double latch_cost;
+
       //! Model representing a single RTT data port connection
       struct Connection 
       {
@@ -170,11 +196,20 @@ namespace conman
       return graph[vertex]->index;
     }
 
-    //! Boost Graph Cycle Visitor used to capture cycles in data flow graphs
+    //! Thrown by FlowCycleVisitor to stop enumerating cycles
+    struct CycleLimitReached { };
+
+    /** \brief Boost Graph Cycle Visitor used to capture cycles in data flow graphs
+     *
+     * If \ref max_cycles is non-zero, this throws CycleLimitReached once that
+     * many cycles have been captured, since the number of cycles can grow
+     * exponentially with the size of the graph.
+     */
     struct FlowCycleVisitor
     {
-      FlowCycleVisitor(std::vector<DataFlowPath> &cycles_)
-        : cycles(cycles_)
+      FlowCycleVisitor(std::vector<DataFlowPath> &cycles_, const size_t max_cycles_ = 0)
+        : cycles(cycles_),
+          max_cycles(max_cycles_)
       {
         cycles.clear();
       }
@@ -185,9 +220,14 @@ namespace conman
         {
           DataFlowPath p_vec(p.begin(),p.end());
           cycles.push_back(p_vec);
+
+          if(max_cycles > 0 && cycles.size() >= max_cycles) {
+            throw CycleLimitReached();
+          }
         }
 
       std::vector<DataFlowPath> &cycles;
+      size_t max_cycles;
     };
 
     /** \brief Boost graph for representing the conflicts between components
@@ -234,9 +274,62 @@ namespace conman
     static const Mode EXCLUSIVE = 1;
   };
 
+  //! Criticality levels describe which blocks must run when a cycle overruns.
+  struct Criticality {
+    typedef unsigned int Level;
+    //! Can be skipped or deferred when a cycle exceeds its budget.
+    static const Level BEST_EFFORT = 0;
+    //! Always executed, even when a cycle exceeds its budget.
+    static const Level CRITICAL = 1;
+  };
+
+  /** \brief Overrun policies describe how a scheme handles a cycle which is too long.
+   *
+   * SKIP and DEFER are only applied in ExecutionMode::SERIAL.
+   */
+  struct OverrunPolicy {
+    typedef unsigned int Mode;
+    //! Execute all blocks, and only report the overrun.
+    static const Mode EVENT = 0;
+    //! Skip the remaining non-critical blocks until their next period.
+    static const Mode SKIP = 1;
+    //! Execute the remaining non-critical blocks on the next cycle.
+    static const Mode DEFER = 2;
+  };
+
+  //! Instrumentation levels describe how much effort goes into statistics.
+  struct Instrumentation {
+    typedef unsigned int Level;
+    //! Only track what is needed for scheduling.
+    static const Level OFF = 0;
+    //! Measure every Nth execution.
+    static const Level SAMPLED = 1;
+    //! Measure every execution.
+    static const Level FULL = 2;
+  };
+
+  /** \brief Convert a duration in seconds to the nearest nanosecond
+   *
+   * Unlike RTT::Seconds_to_nsecs, this rounds instead of truncating, so that
+   * periods like 0.001 s are converted exactly.
+   */
+  static inline RTT::nsecs SecondsToNSecs(const RTT::Seconds s)
+  {
+    return static_cast<RTT::nsecs>((s < 0.0) ? (s * 1E9 - 0.5) : (s * 1E9 + 0.5));
+  }
+
   //! Structure for representing groups of comopnents
   typedef boost::unordered_map<std::string, boost::unordered_set<std::string> > GroupMap;
 
+  //! Dense integer handle of a block in a Scheme (see Scheme::getBlockHandle)
+  typedef unsigned int BlockHandle;
+  //! Dense integer handle of a block group in a Scheme (see Scheme::getGroupHandle)
+  typedef unsigned int GroupHandle;
+  //! Dense integer handle of a mode in a Scheme (see Scheme::getModeHandle)
+  typedef unsigned int ModeHandle;
+  //! Set of blocks in a Scheme with one bit per BlockHandle
+  typedef boost::dynamic_bitset<> BlockSet;
+
 
   //! Get all ports for a service
   static const void GetAllPorts(
@@ -0,0 +1,275 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_DYNAMIC_TOPOLOGICAL_ORDER_H
+#define __CONMAN_DYNAMIC_TOPOLOGICAL_ORDER_H
+
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/graph/graph_traits.hpp>
+#include <boost/graph/topological_sort.hpp>
+
+namespace conman
+{
+  namespace graph
+  {
+    /** \brief Topological ordering which is maintained as edges are added
+     *
+     * This implements the dynamic topological sort algorithm by Pearce and
+     * Kelly ("A Dynamic Topological Sort Algorithm for Directed Acyclic
+     * Graphs", 2006). When an edge is added which contradicts the current
+     * order, only the vertices between its endpoints in the order which are
+     * reachable from them are searched and shuffled. Removing edges never
+     * invalidates a topological order.
+     *
+     * If an added edge closes a cycle, the order becomes invalid and must be
+     * recomputed from scratch with \ref reset once the cycle has been broken.
+     * While invalid, vertex and edge updates are ignored.
+     *
+     * The graph must be bidirectional, and it must be modified before the
+     * corresponding update is applied to the order.
+     */
+    template <class Graph>
+    class DynamicTopologicalOrder
+    {
+    public:
+      typedef typename boost::graph_traits<Graph>::vertex_descriptor Vertex;
+
+      DynamicTopologicalOrder() : valid_(true) { }
+
+      //! True if the order is a valid topological order of the graph
+      bool valid() const { return valid_; }
+
+      //! Get the vertices in topological order (only meaningful if valid)
+      const std::vector<Vertex>& order() const { return order_; }
+
+      //! Mark the order as invalid, so that it must be reset
+      void invalidate() { valid_ = false; }
+
+      /** \brief Recompute the order from scratch with a full topological sort
+       *
+       * Returns false if the graph has cycles.
+       */
+      bool reset(const Graph &graph)
+      {
+        std::list<Vertex> sorted;
+
+        order_.clear();
+        position_.clear();
+
+        try {
+          boost::topological_sort(graph, std::front_inserter(sorted));
+        } catch(boost::not_a_dag &) {
+          valid_ = false;
+          return false;
+        }
+
+        order_.assign(sorted.begin(), sorted.end());
+        for(size_t i=0; i < order_.size(); i++) {
+          position_[order_[i]] = i;
+        }
+
+        valid_ = true;
+        return true;
+      }
+
+      //! Add a vertex without any edges to the end of the order
+      void addVertex(const Vertex v)
+      {
+        if(!valid_) { return; }
+
+        position_[v] = order_.size();
+        order_.push_back(v);
+      }
+
+      //! Remove a vertex from the order
+      void removeVertex(const Vertex v)
+      {
+        if(!valid_) { return; }
+
+        typename PositionMap::iterator it = position_.find(v);
+        if(it == position_.end()) {
+          return;
+        }
+
+        const size_t removed = it->second;
+        position_.erase(it);
+        order_.erase(order_.begin() + removed);
+
+        for(size_t i=removed; i < order_.size(); i++) {
+          position_[order_[i]] = i;
+        }
+      }
+
+      /** \brief Update the order after the edge (source, target) was added
+       *
+       * Returns false if the edge closes a cycle, in which case the order
+       * becomes invalid.
+       */
+      bool addEdge(const Graph &graph, const Vertex source, const Vertex target)
+      {
+        if(!valid_) { return false; }
+
+        typename PositionMap::const_iterator source_it = position_.find(source);
+        typename PositionMap::const_iterator target_it = position_.find(target);
+
+        if(source_it == position_.end() || target_it == position_.end()) {
+          valid_ = false;
+          return false;
+        }
+
+        const size_t lower = target_it->second;
+        const size_t upper = source_it->second;
+
+        // The order already respects the edge
+        if(upper < lower) {
+          return true;
+        }
+
+        // Find the vertices affected by the edge
+        forward_.clear();
+        backward_.clear();
+        visited_.clear();
+
+        if(!this->searchForward(graph, target, source, upper)) {
+          valid_ = false;
+          return false;
+        }
+
+        this->searchBackward(graph, source, lower);
+
+        // Move the vertices which reach the source ahead of the vertices
+        // which are reachable from the target, reusing their positions
+        std::sort(backward_.begin(), backward_.end(), PositionLess(position_));
+        std::sort(forward_.begin(), forward_.end(), PositionLess(position_));
+
+        slots_.clear();
+        for(size_t i=0; i < backward_.size(); i++) {
+          slots_.push_back(position_[backward_[i]]);
+        }
+        for(size_t i=0; i < forward_.size(); i++) {
+          slots_.push_back(position_[forward_[i]]);
+        }
+        std::sort(slots_.begin(), slots_.end());
+
+        size_t slot = 0;
+        for(size_t i=0; i < backward_.size(); i++, slot++) {
+          order_[slots_[slot]] = backward_[i];
+          position_[backward_[i]] = slots_[slot];
+        }
+        for(size_t i=0; i < forward_.size(); i++, slot++) {
+          order_[slots_[slot]] = forward_[i];
+          position_[forward_[i]] = slots_[slot];
+        }
+
+        return true;
+      }
+
+    private:
+      typedef boost::unordered_map<Vertex, size_t> PositionMap;
+
+      //! Ordering of vertices by their current position
+      struct PositionLess
+      {
+        PositionLess(const PositionMap &position_) : position(position_) { }
+        bool operator()(const Vertex &a, const Vertex &b) const
+        {
+          return position.find(a)->second < position.find(b)->second;
+        }
+        const PositionMap &position;
+      };
+
+      /** \brief Collect the vertices reachable from the target which are
+       * ordered before the source, returns false if the source is reachable
+       */
+      bool searchForward(
+          const Graph &graph,
+          const Vertex start,
+          const Vertex source,
+          const size_t upper)
+      {
+        stack_.clear();
+        stack_.push_back(start);
+        visited_.insert(start);
+
+        while(!stack_.empty()) {
+          const Vertex v = stack_.back();
+          stack_.pop_back();
+
+          if(v == source) {
+            return false;
+          }
+
+          forward_.push_back(v);
+
+          typename boost::graph_traits<Graph>::out_edge_iterator edge_it, edge_end;
+          for(boost::tie(edge_it, edge_end) = out_edges(v, graph);
+              edge_it != edge_end;
+              ++edge_it)
+          {
+            const Vertex w = target(*edge_it, graph);
+            if(position_[w] <= upper && visited_.insert(w).second) {
+              stack_.push_back(w);
+            }
+          }
+        }
+
+        return true;
+      }
+
+      //! Collect the vertices which reach the source ordered after the target
+      void searchBackward(
+          const Graph &graph,
+          const Vertex start,
+          const size_t lower)
+      {
+        stack_.clear();
+        stack_.push_back(start);
+        visited_.insert(start);
+
+        while(!stack_.empty()) {
+          const Vertex v = stack_.back();
+          stack_.pop_back();
+
+          backward_.push_back(v);
+
+          typename boost::graph_traits<Graph>::in_edge_iterator edge_it, edge_end;
+          for(boost::tie(edge_it, edge_end) = in_edges(v, graph);
+              edge_it != edge_end;
+              ++edge_it)
+          {
+            const Vertex w = source(*edge_it, graph);
+            if(position_[w] > lower && visited_.insert(w).second) {
+              stack_.push_back(w);
+            }
+          }
+        }
+      }
+
+      //! True if order_ is a topological order of the graph
+      bool valid_;
+      //! The vertices in topological order
+      std::vector<Vertex> order_;
+      //! The position of each vertex in order_
+      PositionMap position_;
+
+      //! \name Search buffers (kept to avoid reallocating)
+      //\{
+      std::vector<Vertex> forward_;
+      std::vector<Vertex> backward_;
+      std::vector<Vertex> stack_;
+      std::vector<size_t> slots_;
+      boost::unordered_set<Vertex> visited_;
+      //\}
+    };
+  }
+}
+
+#endif // ifndef __CONMAN_DYNAMIC_TOPOLOGICAL_ORDER_H
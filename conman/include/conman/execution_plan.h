@@ -0,0 +1,286 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_EXECUTION_PLAN_H
+#define __CONMAN_EXECUTION_PLAN_H
+
+#include <vector>
+#include <algorithm>
+
+#include <rtt/RTT.hpp>
+
+#include <conman/conman.h>
+#include <conman/hook_service.h>
+#include <conman/port_relay.h>
+#include <conman/timer.h>
+
+namespace conman
+{
+  /** \brief A single precompiled entry in a Scheme's execution plan
+   *
+   * This is a plain structure so that the plan can be stored contiguously and
+   * iterated without touching the Boost graph structures or the reference
+   * counts of any shared pointers.
+   */
+  struct ExecutionStep
+  {
+    //! The vertex index of the block (see graph::DataFlowVertex::index)
+    unsigned int index;
+    //! The control and/or estimation block
+    RTT::TaskContext *block;
+    //! The block's conman hook service (called directly, not through RTT)
+    conman::HookService *hook;
+    /** \brief The number of scheme cycles per execution of this block
+     *
+     * A divisor of zero means that the scheme does not have a fixed period,
+     * and the hook decides whether or not the block should run based on its
+     * desired minimum execution period.
+     */
+    unsigned int rate_divisor;
+    //! The scheme cycle (modulo \ref rate_divisor) on which this block is due
+    unsigned int phase;
+    //! The length of the longest ESG path leading to this block
+    unsigned int level;
+    //! The number of ESG predecessors of this block (excluding itself)
+    unsigned int n_predecessors;
+    //! The estimated execution duration of this block in nanoseconds
+    RTT::nsecs load;
+    //! The criticality of this block (see Criticality)
+    conman::Criticality::Level criticality;
+    //! True if this block was held back by an overrun and is due regardless
+    bool deferred;
+    //! The pipeline stage of this block (see PipelineExecutor)
+    unsigned int stage;
+    //! The gate on the block's outputs, or NULL if it has never been in standby
+    conman::OutputGate *gate;
+
+    //! Check if this block is due on a given scheme cycle
+    bool isDue(const unsigned long long cycle) const
+    {
+      return rate_divisor == 0 || cycle % rate_divisor == phase;
+    }
+
+    /** \brief Execute this step if the block is running and due
+     *
+     * Durations are measured with \c timer, and \c timestamp is a reading
+     * which is passed on from one step to the next (see
+     * HookService::timedUpdate).
+     *
+     * Returns false if the block was executed and its update failed.
+     */
+    bool execute(
+        const RTT::nsecs time,
+        const unsigned long long cycle,
+        const conman::Timer &timer,
+        RTT::nsecs &timestamp)
+    {
+      // Check if the task is running
+      if(block->getTaskState() != RTT::TaskContext::Running) {
+        return true;
+      }
+
+      bool success;
+
+      if(rate_divisor == 0) {
+        // Let the hook decide if the block is due
+        success = hook->timedUpdate(time, timer, timestamp);
+      } else if(cycle % rate_divisor != phase) {
+        // The block isn't due on this cycle
+        return true;
+      } else {
+        // The block is due, so execute it without re-checking its period
+        success = hook->timedExecute(time, timer, timestamp);
+      }
+
+      // Pass or drop the outputs of a block in standby
+      if(gate) {
+        gate->update();
+        timestamp = 0;
+      }
+
+      return success;
+    }
+
+    /** \brief Execute this step if the block is running
+     *
+     * This is used for steps taken from a slot list, which are known to be
+     * due.
+     */
+    bool executeDue(
+        const RTT::nsecs time,
+        const conman::Timer &timer,
+        RTT::nsecs &timestamp)
+    {
+      if(block->getTaskState() != RTT::TaskContext::Running) {
+        return true;
+      }
+
+      const bool success = hook->timedExecute(time, timer, timestamp);
+
+      // Pass or drop the outputs of a block in standby
+      if(gate) {
+        gate->update();
+        timestamp = 0;
+      }
+
+      return success;
+    }
+  };
+
+  /** \brief A compiled, topologically-sorted execution plan
+   *
+   * The plan is compiled from the Execution Scheduling Graph (ESG) whenever
+   * the scheme's model or the set of enabled blocks changes, so that the
+   * scheme's real-time loop only needs to iterate over a flat array.
+   *
+   * Blocks in the same level have no ESG paths between them, so they can be
+   * executed concurrently once all of the lower levels have been executed.
+   */
+  struct ExecutionPlan
+  {
+    //! The scheme period that was used to compute the rate divisors (ns)
+    RTT::nsecs period;
+    /** \brief The execution steps in topological order
+     *
+     * The steps are additionally sorted by level, so that all of the blocks
+     * which only depend on blocks in lower levels are contiguous.
+     */
+    std::vector<ExecutionStep> steps;
+    /** \brief The offsets of the first step of each level in \ref steps
+     *
+     * This has one more element than the number of levels, so that level
+     * \c l spans <tt>[level_offsets[l], level_offsets[l+1])</tt>.
+     */
+    std::vector<unsigned int> level_offsets;
+    /** \brief The ESG successors of each step, as indices into \ref steps
+     *
+     * The successors of step \c i are
+     * <tt>successors[successor_offsets[i]]</tt> through
+     * <tt>successors[successor_offsets[i+1]-1]</tt>.
+     */
+    std::vector<unsigned int> successors;
+    //! The offsets of the first successor of each step in \ref successors
+    std::vector<unsigned int> successor_offsets;
+
+    /** \brief The number of scheme cycles in the static cyclic schedule
+     *
+     * This is the least common multiple of the rate divisors of all steps,
+     * or zero if the scheme has no fixed period or the hyperperiod would be
+     * too long to precompute.
+     */
+    unsigned int hyperperiod;
+    /** \brief The steps which are due in each slot of the hyperperiod
+     *
+     * The steps due on cycle \c c are
+     * <tt>slot_steps[slot_offsets[s]]</tt> through
+     * <tt>slot_steps[slot_offsets[s+1]-1]</tt> for <tt>s = c % hyperperiod</tt>,
+     * in execution order.
+     */
+    std::vector<unsigned int> slot_steps;
+    //! The offsets of the first step of each slot in \ref slot_steps
+    std::vector<unsigned int> slot_offsets;
+
+    /** \brief The number of the next scheme cycle to execute
+     *
+     * This is never reset when the plan is recompiled, so that the phases of
+     * running blocks are preserved.
+     */
+    unsigned long long cycle;
+
+    ExecutionPlan() : period(0), hyperperiod(0), cycle(0) { }
+
+    /** \brief Compute the hyperperiod and the step lists for each slot
+     *
+     * Returns false if the hyperperiod is longer than \c max_hyperperiod
+     * cycles, in which case the plan has no slot lists and each step's rate
+     * is checked every cycle.
+     */
+    bool computeSlots(const unsigned int max_hyperperiod);
+
+    /** \brief Exchange the schedule of this plan with another plan
+     *
+     * The cycle counts are not exchanged, and no memory is allocated.
+     */
+    void swap(ExecutionPlan &other)
+    {
+      std::swap(period, other.period);
+      std::swap(hyperperiod, other.hyperperiod);
+      steps.swap(other.steps);
+      level_offsets.swap(other.level_offsets);
+      successors.swap(other.successors);
+      successor_offsets.swap(other.successor_offsets);
+      slot_steps.swap(other.slot_steps);
+      slot_offsets.swap(other.slot_offsets);
+    }
+
+    /** \brief Compute the least common multiple of all rate divisors
+     *
+     * Returns zero if the scheme has no fixed period or the hyperperiod is
+     * longer than \c max_hyperperiod cycles.
+     */
+    unsigned int computeHyperperiod(const unsigned int max_hyperperiod) const;
+
+    /** \brief Choose phases which minimize the peak estimated load per cycle
+     *
+     * Blocks with the same rate which are connected in the ESG are given the
+     * same phase, so that each one still sees its inputs from the same cycle.
+     * The phases of \c pinned steps (and any steps connected to them in this
+     * way) are kept. The remaining groups of blocks are placed greedily in
+     * order of decreasing load, each into the phase whose busiest cycle is
+     * the least busy.
+     *
+     * Returns false if the plan doesn't have a hyperperiod of at most
+     * \c max_hyperperiod cycles, in which case the phases are unchanged.
+     */
+    bool balancePhases(
+        const std::vector<bool> &pinned,
+        const unsigned int max_hyperperiod);
+
+    /** \brief Compute the estimated load of each cycle in the hyperperiod
+     *
+     * This is the sum of the loads of the steps which are due in each slot.
+     */
+    void getSlotLoads(std::vector<RTT::nsecs> &loads) const;
+
+    //! Get the number of dependency levels in the plan
+    unsigned int getNumLevels() const
+    {
+      return level_offsets.empty() ? 0 : level_offsets.size() - 1;
+    }
+
+    /** \brief Compute the number of scheme cycles per execution of a block
+     *
+     * This is the smallest number of scheme periods which is at least as
+     * long as the desired minimum period, or zero if the scheme has no fixed
+     * period.
+     */
+    static unsigned int RateDivisor(
+        const RTT::nsecs scheme_period,
+        const RTT::nsecs desired_min_period)
+    {
+      if(scheme_period <= 0) {
+        return 0;
+      }
+
+      if(desired_min_period <= scheme_period) {
+        return 1;
+      }
+
+      return (desired_min_period + scheme_period - 1) / scheme_period;
+    }
+
+    //! Same as \ref RateDivisor with periods in seconds
+    static unsigned int RateDivisor(
+        const RTT::Seconds scheme_period,
+        const RTT::Seconds desired_min_period)
+    {
+      return RateDivisor(
+          SecondsToNSecs(scheme_period),
+          SecondsToNSecs(desired_min_period));
+    }
+  };
+}
+
+#endif // ifndef __CONMAN_EXECUTION_PLAN_H
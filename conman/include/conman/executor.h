@@ -0,0 +1,126 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_EXECUTOR_H
+#define __CONMAN_EXECUTOR_H
+
+#include <string>
+#include <vector>
+
+#include <rtt/RTT.hpp>
+
+#include <conman/execution_plan.h>
+#include <conman/timer.h>
+
+namespace conman
+{
+  //! Execution modes describe how a Scheme executes its blocks each cycle.
+  struct ExecutionMode {
+    typedef unsigned int Mode;
+    //! Execute all blocks serially in the scheme's thread.
+    static const Mode SERIAL = 0;
+    //! Execute each dependency level of the plan concurrently.
+    static const Mode WAVEFRONT = 1;
+    //! Execute each block as soon as its predecessors have finished.
+    static const Mode WORK_STEALING = 2;
+    //! Execute each independent pipeline stage concurrently.
+    static const Mode PIPELINE = 3;
+  };
+
+  /** \brief Base class for engines which execute an ExecutionPlan in parallel
+   *
+   * An executor owns a fixed pool of worker threads which are created with the
+   * scheduler and priority of the scheme's activity. Each call to \ref execute
+   * runs one full cycle of the plan, and all blocks are guaranteed to have
+   * finished executing when it returns. The thread which calls \ref execute
+   * participates in the execution as worker 0.
+   *
+   * Durations are measured with the timer of the scheme which owns the
+   * executor.
+   *
+   * The plan is only modified by the scheme's thread between calls to \ref
+   * execute, and the executor is notified of such modifications through \ref
+   * configure.
+   */
+  class Executor
+  {
+  public:
+    Executor(const std::string &name, const conman::Timer &timer);
+    virtual ~Executor();
+
+    /** \brief Create and start the worker threads
+     *
+     * \param n_workers The number of threads in addition to the calling thread
+     * \param cpu_affinity The CPU affinity mask for the workers (~0 for any)
+     * \param pin If true, each worker is pinned to a single CPU from the
+     * affinity mask, in order
+     */
+    bool startWorkers(
+        const unsigned int n_workers,
+        const int scheduler,
+        const int priority,
+        const unsigned int cpu_affinity,
+        const bool pin = false);
+
+    //! Stop and destroy the worker threads
+    void stopWorkers();
+
+    //! Get the number of worker threads, not including the calling thread
+    unsigned int getNumWorkers() const;
+
+    /** \brief Allocate the buffers needed to execute a newly compiled plan
+     *
+     * This is called by the thread which compiles the plan, before the plan
+     * is published, so it may run concurrently with \ref execute. It must
+     * only touch buffers which aren't used by the current cycle.
+     */
+    virtual void prepare(const conman::ExecutionPlan &plan);
+
+    /** \brief Switch to a newly published plan
+     *
+     * This is called by the scheme's thread at a cycle boundary, and it must
+     * not be called while \ref execute is running. The buffers allocated by
+     * \ref prepare are swapped in, so this doesn't need to allocate.
+     */
+    virtual void configure(conman::ExecutionPlan &plan) = 0;
+
+    /** \brief Execute one cycle of the plan
+     *
+     * Returns false if any block failed to update.
+     */
+    virtual bool execute(const RTT::nsecs time) = 0;
+
+    /** \brief Get the fraction of time each participant spent executing blocks
+     *
+     * The first element corresponds to the thread which calls \ref execute.
+     * Returns false if the executor does not measure utilization.
+     */
+    virtual bool getUtilization(std::vector<double> &utilization) const;
+
+  protected:
+    //! The timer of the scheme which owns this executor
+    const conman::Timer &timer_;
+
+    //! Wake each worker thread up to call \ref work once
+    void dispatch();
+
+    /** \brief Execute a share of the current cycle
+     *
+     * This is called by each worker thread after \ref dispatch, and by the
+     * thread which calls \ref execute with a \c worker_id of zero.
+     */
+    virtual void work(const unsigned int worker_id) = 0;
+
+  private:
+    class Worker;
+
+    //! The name used for the worker threads
+    std::string name_;
+    //! The worker threads
+    std::vector<Worker*> workers_;
+  };
+}
+
+#endif // ifndef __CONMAN_EXECUTOR_H
@@ -0,0 +1,62 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_FEEDBACK_ARC_SET_H
+#define __CONMAN_FEEDBACK_ARC_SET_H
+
+#include <vector>
+#include <cstddef>
+
+namespace conman
+{
+  namespace graph
+  {
+    //! A weighted arc between two vertices identified by dense indices
+    struct WeightedArc
+    {
+      WeightedArc(
+          const unsigned int source_,
+          const unsigned int target_,
+          const double weight_) :
+        source(source_),
+        target(target_),
+        weight(weight_) { }
+
+      unsigned int source;
+      unsigned int target;
+      double weight;
+    };
+
+    /** \brief Compute a minimum-weight feedback arc set
+     *
+     * This finds a set of arcs whose removal makes the graph acyclic by
+     * choosing a linear ordering of the vertices: the arcs which point
+     * backwards in the ordering form the feedback arc set. Self-loops are
+     * always included.
+     *
+     * Graphs with at most \param max_exact_vertices vertices are solved
+     * exactly by dynamic programming over vertex subsets (O(2^n n^2)). Larger
+     * graphs use the weighted greedy heuristic of Eades, Lin, and Smyth ("A
+     * fast and effective heuristic for the feedback arc set problem", 1993),
+     * which runs in O(n^2 + m) here.
+     *
+     * The graph should be a single strongly connected component, since the
+     * problem decomposes over components.
+     *
+     * \param n_vertices The number of vertices
+     * \param arcs The arcs between vertices 0..n_vertices-1
+     * \param feedback_arcs The indices of the arcs in the feedback arc set
+     *
+     * Returns the total weight of the feedback arc set.
+     */
+    double FeedbackArcSet(
+        const size_t n_vertices,
+        const std::vector<WeightedArc> &arcs,
+        std::vector<size_t> &feedback_arcs,
+        const size_t max_exact_vertices = 16);
+  }
+}
+
+#endif // ifndef __CONMAN_FEEDBACK_ARC_SET_H
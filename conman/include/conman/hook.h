@@ -32,6 +32,10 @@ namespace conman {
       RTT::ServiceRequester("conman_hook", owner),
       setDesiredMinPeriod("setDesiredMinPeriod"),
       getDesiredMinPeriod("getDesiredMinPeriod"),
+      setCriticality("setCriticality"),
+      getCriticality("getCriticality"),
+      setInstrumentation("setInstrumentation"),
+      getInstrumentation("getInstrumentation"),
       setInputExclusivity("setInputExclusivity"),
       getInputExclusivity("getInputExclusivity"),
       getTime("getTime"),
@@ -50,6 +54,10 @@ namespace conman {
     { 
       this->addOperationCaller(setDesiredMinPeriod);
       this->addOperationCaller(getDesiredMinPeriod);
+      this->addOperationCaller(setCriticality);
+      this->addOperationCaller(getCriticality);
+      this->addOperationCaller(setInstrumentation);
+      this->addOperationCaller(getInstrumentation);
       this->addOperationCaller(setInputExclusivity);
       this->addOperationCaller(getInputExclusivity);
 
@@ -75,6 +83,14 @@ namespace conman {
       setDesiredMinPeriod;
     RTT::OperationCaller<RTT::Seconds(void)>
       getDesiredMinPeriod;
+    RTT::OperationCaller<bool(const Criticality::Level)>
+      setCriticality;
+    RTT::OperationCaller<conman::Criticality::Level(void)>
+      getCriticality;
+    RTT::OperationCaller<bool(const Instrumentation::Level, const unsigned int)>
+      setInstrumentation;
+    RTT::OperationCaller<conman::Instrumentation::Level(void)>
+      getInstrumentation;
     RTT::OperationCaller<bool(const std::string&, const Exclusivity::Mode)>
       setInputExclusivity;
     RTT::OperationCaller<conman::Exclusivity::Mode(const std::string&)>
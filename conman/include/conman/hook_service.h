@@ -15,6 +15,7 @@
 #include <rtt/plugin/PluginLoader.hpp>
 
 #include <conman/conman.h>
+#include <conman/timer.h>
 
 namespace conman {
   
@@ -33,11 +34,39 @@ namespace conman {
     /** \name Conman Scheduling Management */
     //\{
 
-    //! Set the desired minimum execution period
+    /** \brief Set the desired minimum execution period
+     *
+     * A running scheme only picks this up when it audits its execution plan
+     * (see Scheme::auditExecutionPlan).
+     */
     bool setDesiredMinPeriod(const RTT::Seconds period);
 
     //! Get the desired minimum execution period
     RTT::Seconds getDesiredMinPeriod();
+    //! Get the desired minimum execution period in nanoseconds
+    RTT::nsecs getDesiredMinPeriodNSecs() const;
+
+    /** \brief Set the criticality level (see Criticality)
+     *
+     * This takes effect the next time the scheme's execution plan is
+     * compiled, for example when the block is enabled.
+     */
+    bool setCriticality(const unsigned int level);
+
+    //! Get the criticality level
+    unsigned int getCriticality();
+
+    /** \brief Set the instrumentation level (see Instrumentation)
+     *
+     * When sampled, statistics are only computed every \c sample_period
+     * executions. The period is ignored for other levels.
+     */
+    bool setInstrumentation(
+        const unsigned int level,
+        const unsigned int sample_period);
+
+    //! Get the instrumentation level
+    unsigned int getInstrumentation();
 
     //\}
 
@@ -74,6 +103,19 @@ namespace conman {
     RTT::Seconds getDurationMin();
     RTT::Seconds getDurationMax();
     RTT::Seconds getDurationVar();
+
+    /** \brief Nanosecond time introspection
+     *
+     * These are exact, and are used by the scheme's real-time loop.
+     */
+    RTT::nsecs getTimeNSecs() const;
+    RTT::nsecs getPeriodNSecs() const;
+    RTT::nsecs getPeriodMinNSecs() const;
+    RTT::nsecs getPeriodMaxNSecs() const;
+    RTT::nsecs getDurationNSecs() const;
+    RTT::nsecs getDurationAvgNSecs() const;
+    RTT::nsecs getDurationMinNSecs() const;
+    RTT::nsecs getDurationMaxNSecs() const;
     //\}
 
     /** \name Execution */
@@ -83,33 +125,121 @@ namespace conman {
     bool init(const RTT::Seconds time);
     //! Execute the owner's update hook and compute execution time statistics
     bool update(const RTT::Seconds time);
+    /** \brief Execute the owner's update hook without checking the desired
+     * minimum execution period
+     *
+     * This is used by a Scheme which has already determined that the block is
+     * due based on a precomputed rate divisor.
+     */
+    bool execute(const RTT::Seconds time);
+
+    //! Same as \ref update with a time in nanoseconds
+    bool updateNSecs(const RTT::nsecs time);
+    //! Same as \ref execute with a time in nanoseconds
+    bool executeNSecs(const RTT::nsecs time);
+
+    /** \brief Same as \ref updateNSecs, measuring durations with a scheme's
+     * timer
+     *
+     * \param timestamp A reading of \c timer taken just before this call, or
+     * zero if there isn't one. If the block's duration is measured, this is
+     * set to the reading taken when the block finished, so consecutive blocks
+     * only read the clock once each. Otherwise it is set to zero once the
+     * block has executed.
+     */
+    bool timedUpdate(
+        const RTT::nsecs time,
+        const conman::Timer &timer,
+        RTT::nsecs &timestamp);
+    //! Same as \ref executeNSecs, measuring durations like \ref timedUpdate
+    bool timedExecute(
+        const RTT::nsecs time,
+        const conman::Timer &timer,
+        RTT::nsecs &timestamp);
 
     //\}
+
+    //! Get the conman hook service of a task, or NULL if it isn't loaded
+    static HookService* GetHookService(RTT::TaskContext *task);
     
   private:
 
+    //! Execute the owner and compute statistics (see \ref timedUpdate)
+    bool executeOwner(
+        const RTT::nsecs time,
+        const conman::Timer &timer,
+        RTT::nsecs &timestamp);
+
+    //! Reset the time state & statistics
+    void resetStatistics(const RTT::nsecs time);
+
+    //! Copy the time state & statistics into the introspection properties
+    void publishStatistics();
+
     //! Init flag used for statistics computation initialization
     bool init_;
 
+    //! Timer used when the hook isn't executed by a scheme
+    conman::Timer timer_;
+
     //! Minimum execution period for this component
     RTT::Seconds desired_min_exec_period_;
+    /** \brief Minimum execution period in nanoseconds
+     *
+     * This is updated by \ref setDesiredMinPeriod, and when the hook is
+     * initialized in case the property was set directly.
+     */
+    RTT::nsecs desired_min_exec_period_ns_;
+
+    //! Criticality level for cycle budget enforcement
+    Criticality::Level criticality_;
 
     //! Exponential smoothing factor for smoothing execution time
     double exec_duration_smoothing_factor_;
 
-    //! Time state
-    //TODO: use nsecs instead?
+    //! Instrumentation level for execution statistics
+    Instrumentation::Level instrumentation_;
+    //! Number of executions per sample when sampled
+    unsigned int instrumentation_sample_period_;
+    //! Number of executions until the next sample
+    unsigned int sample_countdown_;
+
+    //! Time state (ns)
+    RTT::nsecs
+      last_exec_time_ns_,
+      last_exec_period_ns_,
+      min_exec_period_ns_,
+      max_exec_period_ns_;
+
+    //! Execution statistics (ns)
+    RTT::nsecs
+      last_exec_duration_ns_,
+      min_exec_duration_ns_,
+      max_exec_duration_ns_;
+
+    /** \brief Smoothed statistics (ns and ns^2)
+     *
+     * These are filtered in floating point so that small changes aren't
+     * lost to rounding.
+     */
+    double
+      smooth_exec_period_ns_,
+      var_exec_period_ns_,
+      smooth_exec_duration_ns_,
+      var_exec_duration_ns_;
+
+    /** \brief Time state and execution statistics properties (s and s^2)
+     *
+     * These are copies of the nanosecond state above, which are only
+     * refreshed when statistics are computed (see \ref setInstrumentation).
+     */
     RTT::Seconds
       last_exec_time_,
       last_exec_period_,
       min_exec_period_,
       max_exec_period_,
       smooth_exec_period_,
-      var_exec_period_;
-
-    //! Execution statistics
-    //TODO: use nsecs instead?
-    RTT::Seconds
+      var_exec_period_,
       last_exec_duration_,
       min_exec_duration_,
       max_exec_duration_,
@@ -0,0 +1,82 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_PIPELINE_EXECUTOR_H
+#define __CONMAN_PIPELINE_EXECUTOR_H
+
+#include <vector>
+
+#include <conman/executor.h>
+#include <conman/port_relay.h>
+
+namespace conman
+{
+  /** \brief Executor which runs independent pipeline stages concurrently
+   *
+   * A pipeline stage is a set of blocks which are connected in the ESG, so
+   * different stages are only connected by latched connections. Each stage is
+   * assigned to one participating thread, and all threads execute their
+   * stages concurrently without synchronizing with each other.
+   *
+   * Latched connections between stages are replaced with PortRelay instances
+   * which are copied at the start of each cycle, so a stage always sees the
+   * data that the other stages produced in the previous cycle. This lets
+   * consecutive cycles of, for example, sensor processing and control
+   * overlap.
+   */
+  class PipelineExecutor : public Executor
+  {
+  public:
+    PipelineExecutor(const std::string &name, const conman::Timer &timer);
+    virtual ~PipelineExecutor();
+
+    //! Add a relay to be copied at the start of each cycle (takes ownership)
+    void addRelay(conman::PortRelay *relay);
+
+    virtual void prepare(const conman::ExecutionPlan &plan);
+    virtual void configure(conman::ExecutionPlan &plan);
+    virtual bool execute(const RTT::nsecs time);
+    virtual bool getUtilization(std::vector<double> &utilization) const;
+
+    /** \brief Get the fraction of time spent executing each stage
+     *
+     * This is measured since the executor was last configured.
+     */
+    void getStageLoads(std::vector<double> &loads) const;
+
+  protected:
+    virtual void work(const unsigned int worker_id);
+
+  private:
+    //! The plan being executed
+    conman::ExecutionPlan *plan_;
+    //! The time passed to each block in the current cycle
+    RTT::nsecs time_;
+    //! The number of cycles executed so far
+    volatile unsigned int cycle_;
+    //! Non-zero if any block failed to execute in the current cycle
+    volatile int failed_;
+    //! The number of times a participant has finished a cycle
+    volatile unsigned int finished_;
+    //! The steps executed by each participant, in execution order
+    std::vector<std::vector<unsigned int> > participant_steps_;
+    //! The time each participant has spent executing blocks
+    std::vector<RTT::nsecs> participant_busy_time_;
+    //! The time spent executing each stage
+    std::vector<RTT::nsecs> stage_busy_time_;
+    //! The time at which the executor was configured
+    RTT::nsecs start_time_;
+    //! The relays for connections between stages
+    std::vector<conman::PortRelay*> relays_;
+    //! True if the buffers below were prepared for the next plan
+    bool prepared_;
+    //! The steps of each participant for the next plan (see \ref prepare)
+    std::vector<std::vector<unsigned int> > prepared_participant_steps_;
+    //! The stage timers for the next plan (see \ref prepare)
+    std::vector<RTT::nsecs> prepared_stage_busy_time_;
+  };
+}
+
+#endif // ifndef __CONMAN_PIPELINE_EXECUTOR_H
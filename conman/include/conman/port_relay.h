@@ -0,0 +1,126 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_PORT_RELAY_H
+#define __CONMAN_PORT_RELAY_H
+
+#include <vector>
+
+#include <rtt/RTT.hpp>
+
+namespace conman
+{
+  /** \brief Relay which splices itself into an RTT data port connection
+   *
+   * When connected, the original connection from the source port to the sink
+   * port is replaced by a connection from the source port to a private input
+   * port, and a connection from a private output port to the sink port. Data
+   * is only passed from one to the other when \ref copy is called, so the
+   * sink sees a consistent snapshot of the source's data regardless of when
+   * the source and sink execute.
+   *
+   * Both new connections use the policy of the original connection, which is
+   * restored when the relay is disconnected or destroyed.
+   */
+  class PortRelay
+  {
+  public:
+    PortRelay(
+        RTT::base::OutputPortInterface *source,
+        RTT::base::InputPortInterface *sink);
+    ~PortRelay();
+
+    //! Replace the connection from the source to the sink with the relay
+    bool connect();
+
+    //! Restore the original connection from the source to the sink
+    void disconnect();
+
+    //! Check if the relay is spliced into the connection
+    bool isConnected() const;
+
+    /** \brief Pass all new samples from the source to the sink
+     *
+     * Returns the number of samples which were relayed.
+     */
+    unsigned int copy();
+
+    /** \brief Drop all new samples from the source
+     *
+     * Returns the number of samples which were dropped.
+     */
+    unsigned int discard();
+
+    RTT::base::OutputPortInterface* getSource() const { return source_; }
+    RTT::base::InputPortInterface* getSink() const { return sink_; }
+
+  private:
+    //! The original source port
+    RTT::base::OutputPortInterface *source_;
+    //! The original sink port
+    RTT::base::InputPortInterface *sink_;
+    //! The policy of the original connection
+    RTT::ConnPolicy policy_;
+    //! Private port connected to the source port
+    RTT::base::InputPortInterface *relay_in_;
+    //! Private port connected to the sink port
+    RTT::base::OutputPortInterface *relay_out_;
+    //! Storage for samples in transit
+    RTT::base::DataSourceBase::shared_ptr sample_;
+  };
+
+  /** \brief Gate which holds back all of a block's output connections
+   *
+   * Each output connection of the block is replaced with a \ref PortRelay.
+   * While the gate is closed, the block's samples are dropped by \ref update
+   * instead of reaching the sinks, so a block can be executed without
+   * affecting the rest of the scheme. Opening the gate only sets a flag.
+   *
+   * A gate without any relays is open and doesn't do anything.
+   */
+  class OutputGate
+  {
+  public:
+    OutputGate() : open_(true) { }
+    //! Restores the original connections
+    ~OutputGate();
+
+    //! Relay a connection from the block through the gate
+    bool addRelay(
+        RTT::base::OutputPortInterface *source,
+        RTT::base::InputPortInterface *sink);
+
+    //! Remove all of the relays, restoring the original connections
+    void clear();
+
+    //! Check if the gate has any relays
+    bool empty() const { return relays_.empty(); }
+
+    //! Let the block's samples through on the next \ref update
+    void open() { open_ = true; }
+    //! Hold back the block's samples on the next \ref update
+    void close() { open_ = false; }
+    //! Check if the block's samples are let through
+    bool isOpen() const { return open_; }
+
+    //! Pass or drop the samples which the block has written
+    void update()
+    {
+      if(open_) {
+        for(size_t i=0; i < relays_.size(); i++) { relays_[i]->copy(); }
+      } else {
+        for(size_t i=0; i < relays_.size(); i++) { relays_[i]->discard(); }
+      }
+    }
+
+  private:
+    //! Set from the scheme's thread at a cycle boundary
+    volatile bool open_;
+    //! The relays on the block's output connections
+    std::vector<conman::PortRelay*> relays_;
+  };
+}
+
+#endif // ifndef __CONMAN_PORT_RELAY_H
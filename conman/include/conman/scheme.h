@@ -6,7 +6,16 @@
 #ifndef __CONMAN_SCHEME_H
 #define __CONMAN_SCHEME_H
 
+#include <rtt/os/Mutex.hpp>
+#include <rtt/os/MutexLock.hpp>
+
 #include <conman/conman.h>
+#include <conman/compact_graph.h>
+#include <conman/dynamic_topological_order.h>
+#include <conman/execution_plan.h>
+#include <conman/executor.h>
+#include <conman/pipeline_executor.h>
+#include <conman/timer.h>
 
 namespace conman
 {
@@ -28,6 +37,7 @@ namespace conman
   public:
     /** \brief Construct a Scheme */
     Scheme(std::string name="Scheme");
+    virtual ~Scheme();
 
     ///////////////////////////////////////////////////////////////////////////
     /** \name Scheme Construction
@@ -67,6 +77,40 @@ namespace conman
     /** \brief Remove a block from the scheme */
     bool removeBlock(RTT::TaskContext *block);
 
+    /** \brief Add several blocks which are already peers of this scheme
+     *
+     * The blocks are added in a single transaction, so the model is only
+     * regenerated once. If any block can't be added, or the result can't be
+     * executed, none of the blocks are added.
+     */
+    bool addBlocks(const std::vector<std::string> &names);
+
+    //\}
+
+    ///////////////////////////////////////////////////////////////////////////
+    /** \name Scheme Transactions
+     *
+     * Adding and removing blocks and latching connections normally
+     * regenerates the execution ordering, the execution plan, and the
+     * conflicts after every single change. Inside of a transaction, these
+     * mutations only update the DFG and ESG, and the ordering, plan, and
+     * conflicts are computed once when the transaction is committed.
+     *
+     * If the committed scheme isn't executable, every mutation made since
+     * \ref beginTransaction is undone and the commit fails. Transactions
+     * can't be nested, and the scheme must be stopped.
+     */
+    //\{
+
+    //! Start deferring model regeneration and recording mutations
+    bool beginTransaction();
+    //! Regenerate the model, or roll back if the scheme isn't executable
+    bool commitTransaction();
+    //! Undo all of the mutations since the transaction was started
+    bool abortTransaction();
+    //! Check if a transaction is open
+    bool inTransaction() const;
+
     //\}
 
     ///////////////////////////////////////////////////////////////////////////
@@ -132,6 +176,62 @@ namespace conman
         const std::string &group_name) const;
 
     //\}
+
+    ///////////////////////////////////////////////////////////////////////////
+    /** \name Block Handles
+     *
+     * Blocks and groups can also be identified by dense integer handles, so
+     * that frequent operations like mode switches don't need to hash or copy
+     * names. Names should be resolved to handles once, and the handles can
+     * then be passed to the handle-based overloads of the runtime and latch
+     * functions.
+     *
+     * A block's handle is its index in the scheme, so block handles are
+     * renumbered when a block is removed. Similarly, group handles are
+     * renumbered when a group is removed. Lists of handles which were
+     * resolved from group names aren't updated when the group membership
+     * changes.
+     *
+     * The flattened membership of each group is cached as a \ref BlockSet,
+     * so group lookups by name or handle don't expand nested groups.
+     */
+    //\{
+
+    //! Get the handle of a block by name
+    bool getBlockHandle(
+        const std::string &block_name,
+        conman::BlockHandle &handle) const;
+
+    /** \brief Get the handles of several blocks (or groups) by name
+     *
+     * Groups are expanded into the handles of their members, and each block
+     * is only listed once.
+     */
+    bool getBlockHandles(
+        const std::vector<std::string> &block_names,
+        std::vector<conman::BlockHandle> &handles) const;
+
+    //! Get the name of a block by handle
+    bool getBlockName(
+        const conman::BlockHandle handle,
+        std::string &block_name) const;
+
+    //! Get the handle of a group by name
+    bool getGroupHandle(
+        const std::string &group_name,
+        conman::GroupHandle &handle) const;
+
+    //! Get the handles of the blocks in a given group
+    bool getGroupMembers(
+        const conman::GroupHandle handle,
+        std::vector<conman::BlockHandle> &members) const;
+
+    //! Get the set of blocks in a given group
+    bool getGroupMembers(
+        const conman::GroupHandle handle,
+        conman::BlockSet &members) const;
+
+    //\}
     
     ///////////////////////////////////////////////////////////////////////////
     /** \name Block conflict computation
@@ -192,6 +292,12 @@ namespace conman
       const std::vector<std::string> &sink_names,
       const bool latch);
 
+    //! Add/Remove a latch between two lists of blocks by handle
+    bool latchConnections(
+      const std::vector<conman::BlockHandle> &sources,
+      const std::vector<conman::BlockHandle> &sinks,
+      const bool latch);
+
     //! Add/Remove a latch between two blocks
     bool latchConnections(
       RTT::TaskContext *source,
@@ -207,6 +313,35 @@ namespace conman
     bool latchOutputs(const std::string &name, const bool latch);
     //! Set latching for all current and future input arcs to a given block
     bool latchOutputs(RTT::TaskContext *block, const bool latch);
+
+    /** \brief Set the cost of latching the connections between two blocks
+     *
+     * Latching a connection delays its data by one cycle, which matters more
+     * on some paths (like tight control loops) than others. The default cost
+     * is 1.
+     */
+    bool setLatchCost(
+      const std::string &source_name,
+      const std::string &sink_name,
+      const double cost);
+
+    /** \brief Compute the cheapest set of connections to latch so that the
+     * scheme can be executed
+     *
+     * This computes a minimum-cost feedback arc set of each strongly connected
+     * component of the ESG. Small components are solved exactly, and large
+     * components use a greedy heuristic (see graph::FeedbackArcSet). Existing
+     * latches are kept.
+     *
+     * The connections are returned as parallel lists of source and sink block
+     * names, which are empty if the scheme is already executable.
+     */
+    bool computeFeedbackLatches(
+      std::vector<std::string> &source_names,
+      std::vector<std::string> &sink_names) const;
+
+    //! Compute and apply the latches from \ref computeFeedbackLatches
+    bool latchFeedback();
     //\}
 
     ///////////////////////////////////////////////////////////////////////////
@@ -225,17 +360,38 @@ namespace conman
      * This uses Tiernan's Elementary Circuit Algorithm (implementation from the
      * Boost Graph Library) to find all cycles which do not include repeated
      * vertices. It returns the number of cycles found.
+     *
+     * The number of cycles can grow exponentially with the size of the graph,
+     * so the enumeration stops after \ref max_cycles_ cycles.
      */
     int getFlowCycles(std::vector<std::vector<std::string> > &cycles) const;
 
+    /** \brief Computes the strongly connected components of the DFG which
+     * contain cycles
+     *
+     * This uses Tarjan's algorithm (implementation from the Boost Graph
+     * Library), which runs in linear time. Every cycle in the DFG lies within
+     * one of these components. It returns the number of components found.
+     */
+    int getFlowCyclicComponents(std::vector<std::vector<std::string> > &components) const;
+
     /** \brief Get the number of latches in a given path through the DFG. */
     int latchCount(const std::vector<std::string> &path) const;
 
-    /** \brief Get the maximum number of latches in any cycle in the DFG. */
+    /** \brief Get the maximum number of latches in any cycle in the DFG.
+     *
+     * This is computed exactly by dynamic programming over the blocks in each
+     * strongly connected component with up to 16 blocks. Larger components
+     * fall back to cycle enumeration, which is bounded by \ref max_cycles_.
+     */
     int maxLatchCount() const;
 
     /** \brief Get the minimum number of latches in any cycle in the DFG. If the
-     * DFG has no cycles, this returns 0.*/
+     * DFG has no cycles, this returns 0.
+     *
+     * This is computed with a 0-1 breadth-first search from each block in
+     * each strongly connected component, without enumerating cycles.
+     */
     int minLatchCount() const;
 
     //\}
@@ -274,6 +430,17 @@ namespace conman
      */
     int getExecutionCycles(std::vector<std::vector<std::string> > &cycles) const;
 
+    /** \brief Computes the strongly connected components of the pending ESG
+     * which contain cycles
+     *
+     * This runs in linear time, like \ref getFlowCyclicComponents. The ESG is
+     * executable if and only if there are no such components.
+     */
+    int getExecutionCyclicComponents(std::vector<std::vector<std::string> > &components) const;
+
+    //! Get the names of all blocks which are on cycles in the pending ESG
+    std::vector<std::string> getCyclicBlocks() const;
+
     /** \brief Gets the execution order for the scheme or if it can't be
      * executed, returns false.
      */
@@ -316,6 +483,14 @@ namespace conman
     //! Check if a list of blocks (or groups) can be enabled
     template <class T>
     bool enableable(const T &block_names) const;
+    /** \brief Check if a list of blocks can be enabled by handle
+     *
+     * This only intersects the blocks' rows of the conflict matrix with the
+     * set of running blocks.
+     */
+    bool enableable(const std::vector<conman::BlockHandle> &handles) const;
+    //! Check if a set of blocks can be enabled
+    bool enableable(const conman::BlockSet &blocks) const;
 
     //! Enable a single conman Block
     bool enableBlock(RTT::TaskContext *block, const bool force);
@@ -378,16 +553,168 @@ namespace conman
         const std::vector<std::string> &enabled_block_names, 
         const bool strict);
 
+    /** \brief Enable multiple blocks by handle (see \ref enableBlocks)
+     *
+     * If \param force is set, all of the running blocks which conflict with
+     * the given blocks are found at once and disabled in reverse execution
+     * order before any blocks are enabled.
+     */
+    bool enableBlocks(
+        const std::vector<conman::BlockHandle> &handles,
+        const bool strict,
+        const bool force);
+    //! Disable multiple blocks by handle (see \ref disableBlocks)
+    bool disableBlocks(
+        const std::vector<conman::BlockHandle> &handles,
+        const bool strict,
+        const bool inverse=false);
+    //! Disable and enable blocks by handle (see \ref switchBlocks)
+    bool switchBlocks(
+        const std::vector<conman::BlockHandle> &disable_handles,
+        const std::vector<conman::BlockHandle> &enable_handles,
+        const bool strict,
+        const bool force);
+    //! Set the enabled blocks by handle (see \ref setEnabledBlocks)
+    bool setEnabledBlocks(
+        const std::vector<conman::BlockHandle> &enabled_handles,
+        const bool strict);
+
+    //\}
+
+    ///////////////////////////////////////////////////////////////////////////
+    /** \name Modes
+     *
+     * A mode is a named set of blocks (or groups) which run together, like
+     * "gravity_comp" or "impedance". Switching to a mode disables every
+     * running block which isn't in the mode in reverse execution order, and
+     * then enables the blocks in the mode which aren't running in execution
+     * order. This is equivalent to \ref setEnabledBlocks.
+     *
+     * The blocks in a mode must not conflict with each other. Each mode is
+     * validated and compiled into a \ref BlockSet and a list of blocks in
+     * execution order when it's defined, and it's recompiled whenever the
+     * blocks, groups, conflicts, or execution order change.
+     *
+     * A switch is compiled into the lists of blocks to stop and start and the
+     * execution plan which results from it before it's applied, so applying
+     * it only starts and stops blocks and swaps in the new plan. If a block
+     * can't be started or stopped, the blocks which were already switched are
+     * restored and the current plan is kept. The duration of each applied
+     * switch is measured with the scheme's \ref timer_.
+     */
+    //\{
+
+    //! Define (or redefine) a mode by the blocks and groups which run in it
+    bool defineMode(
+        const std::string &mode_name,
+        const std::vector<std::string> &block_names);
+    //! Remove a mode (this isn't allowed while a switch is pending)
+    bool removeMode(const std::string &mode_name);
+    //! Check if a mode exists
+    bool hasMode(const std::string &mode_name) const;
+    //! Get the names of all modes
+    std::vector<std::string> getModes() const;
+    //! Get the handle of a mode, which is renumbered when a mode is removed
+    bool getModeHandle(
+        const std::string &mode_name,
+        conman::ModeHandle &handle) const;
+    //! Switch to a mode by name
+    bool switchMode(const std::string &mode_name);
+    /** \brief Switch to a mode by handle
+     *
+     * This replaces any switch which has been requested but not applied yet.
+     */
+    bool switchMode(const conman::ModeHandle handle);
+
+    /** \brief Request a switch to a mode at the start of the next cycle
+     *
+     * The switch is validated and compiled in the calling thread (it's
+     * recompiled whenever the execution plan changes before it's applied),
+     * so this shouldn't be called from a real-time thread. The scheme applies
+     * the most recent request at the top of \ref updateHook, before any
+     * blocks are executed, so the switch never spans two cycles. When the
+     * switch succeeds, the time of that cycle is written to the "switch_time"
+     * port.
+     *
+     * Returns false if the mode can't be used. Requests are only applied
+     * while the scheme is running.
+     */
+    bool requestMode(const conman::ModeHandle handle);
+    //! Request a switch to a mode by name (see \ref requestMode)
+    bool requestMode(const std::string &mode_name);
+
+    //\}
+
+    ///////////////////////////////////////////////////////////////////////////
+    /** \name Hot Standby
+     *
+     * A block in standby is started and executed in every cycle like an
+     * enabled block, but its output connections go through an \ref
+     * OutputGate which drops its samples. This lets an expensive startHook()
+     * run, and the block's internal state settle, before it takes over.
+     * Since its outputs don't reach any other block, a block in standby
+     * doesn't conflict with the running blocks.
+     *
+     * Enabling a block in standby (with \ref enableBlock, \ref switchMode,
+     * etc.) checks for conflicts as usual, but then only opens its gate, so
+     * the block's outputs reach its sinks from the next cycle onwards without
+     * restarting it. The gate is kept until the block is disabled, which
+     * restores its original connections. When the block is stopped by a mode
+     * switch, its connections are restored the next time the execution plan
+     * is compiled instead, so that the switch doesn't rewire any ports.
+     *
+     * Since the gates and the relays between pipeline stages (see
+     * ExecutionMode::PIPELINE) would splice into the same connections, a
+     * block whose connections are relayed between stages can't be put into
+     * standby, and a pipeline can't be started while the connections of a
+     * block in standby would be relayed.
+     */
+    //\{
+
+    /** \brief Start a block with its outputs held back
+     *
+     * If the block is already enabled, this puts it back into standby
+     * without stopping it.
+     */
+    bool standbyBlock(const std::string &block_name);
+    //! Check if a block is in standby
+    bool inStandby(const std::string &block_name) const;
+
     //\}
 
     /** \brief (Re)generates an internal model of the RTT port connection graph
      *
      * This will populate the Data Flow Graph (DFG), the Execution Scheduling
      * Graph (ESG), and the Runtime Conflict Graph (RCG). The scheme must be 
+     * stopped.
      *
+     * Only the ports of blocks which have been added or marked dirty since
+     * the last call are rescanned. Use \ref refreshModel to pick up
+     * connections which were made between blocks already in the scheme.
      */
     bool regenerateModel();
 
+    /** \brief Rescan the ports of all blocks and regenerate the model
+     *
+     * This is done automatically when the scheme is started.
+     */
+    bool refreshModel();
+
+    /** \brief Mark a block whose port connections have changed
+     *
+     * The block and its current DFG neighbors are rescanned the next time the
+     * model is regenerated.
+     */
+    bool markBlockDirty(const std::string &block_name);
+
+    /** \brief Get the frozen snapshot of the model
+     *
+     * This is only populated while the scheme is running, and execution
+     * plans are compiled from it until the scheme is stopped. Latches can't
+     * be changed in the meantime.
+     */
+    const conman::graph::CompactModel& getCompactModel() const;
+
     ///////////////////////////////////////////////////////////////////////////
     //! \name Orocos RTT Hooks
     //\{
@@ -407,8 +734,72 @@ namespace conman
      */
     virtual void updateHook();
 
+    //! Stop and destroy the parallel executor, if any
+    virtual void stopHook();
+
     //\}
 
+    /** \brief Get the utilization of each parallel execution thread
+     *
+     * This is empty if the scheme is executing serially or if the executor
+     * doesn't measure utilization.
+     */
+    std::vector<double> getWorkerUtilization() const;
+
+    /** \brief Get the fraction of time spent executing each pipeline stage
+     *
+     * This is empty unless the scheme is running in the PIPELINE execution
+     * mode.
+     */
+    std::vector<double> getStageLoads() const;
+
+    /** \brief Get the latency added to the inputs of each pipeline stage
+     *
+     * This is the largest number of relayed connections which carried data
+     * that the stage would have seen in the same cycle if the scheme were
+     * executed serially, along any path leading to the stage.
+     */
+    std::vector<int> getStageLatencies() const;
+
+    /** \brief Get the phase of each block in the multi-rate schedule
+     *
+     * Each element is formatted as "name phase/divisor" in execution order,
+     * where a block is due on each cycle whose number modulo the divisor is
+     * equal to the phase.
+     */
+    std::vector<std::string> getBlockPhases() const;
+
+    //! Get the estimated execution duration of each cycle in the hyperperiod
+    std::vector<double> getSlotLoads() const;
+
+    /** \brief Recompile the execution plan if any blocks have been started or
+     * stopped outside of the scheme, or if any rates have changed
+     *
+     * Blocks which are stopped outside of the scheme are skipped by the
+     * execution plan, but blocks which are started outside of the scheme
+     * aren't executed until this is called. The same goes for changes to the
+     * scheme's period or a block's desired minimum execution period, since
+     * each block's rate divisor is compiled into the plan. This is never
+     * called from updateHook, since compiling the plan allocates memory.
+     *
+     * While the scheme is running, a low-priority thread checks the plan
+     * every "audit_period" seconds, and only calls this operation when the
+     * plan is stale, so the plan is recompiled in the scheme's thread
+     * between two cycles, like for any other change to the running blocks.
+     *
+     * Returns true if the plan was recompiled.
+     */
+    bool auditExecutionPlan();
+
+    /** \brief Set the instrumentation level of the scheme and all of its blocks
+     *
+     * See HookService::setInstrumentation. Blocks can be given their own
+     * levels afterwards through their hooks.
+     */
+    bool setInstrumentation(
+        const unsigned int level,
+        const unsigned int sample_period);
+
     void getConnectionDescriptions(std::vector<conman::ConnectionDescription> &connections);
     void getBlockDescriptions(std::vector<conman::BlockDescription> &blocks);
     
@@ -426,10 +817,68 @@ namespace conman
      * fast access)
      */
     boost::unordered_map<std::string,conman::graph::DataFlowVertex::Ptr> blocks_;
-    //! A list of blocks ordered by index (for linear re-indexing)
-    std::list<conman::graph::DataFlowVertex::Ptr> block_indices_;
+    //! The blocks ordered by index, which is also their handle
+    std::vector<conman::graph::DataFlowVertex::Ptr> block_indices_;
     //! A map of block group names to block names
     conman::GroupMap block_groups_;
+    //! The group names ordered by handle
+    std::vector<std::string> group_names_;
+    //! A map from group names onto group handles
+    boost::unordered_map<std::string, conman::GroupHandle> group_handles_;
+    //! The flattened members of each group, indexed by group handle
+    std::vector<conman::BlockSet> group_members_;
+    //! False for each group with members which aren't in the scheme
+    std::vector<bool> group_complete_;
+    //! Scratch set of the blocks passed to handle-based operations
+    conman::BlockSet marked_blocks_;
+
+    //! \name Modes
+    //\{
+    //! A mode and its compiled form
+    struct CompiledMode {
+      //! The name of the mode
+      std::string name;
+      //! The blocks and groups which define the mode
+      std::vector<std::string> block_names;
+      //! The blocks in the mode
+      conman::BlockSet blocks;
+      //! The blocks in the mode in execution order
+      std::vector<conman::graph::DataFlowVertex::Ptr> start_order;
+      //! True if all of the blocks are in the scheme and don't conflict
+      bool valid;
+    };
+    //! A switch to a mode which has been compiled before it's applied
+    struct ModeSwitch {
+      //! The handle of the mode
+      conman::ModeHandle handle;
+      //! The running blocks which aren't in the mode, in reverse execution order
+      std::vector<conman::graph::DataFlowVertex::Ptr> stop_order;
+      //! The blocks in the mode which aren't running, in execution order
+      std::vector<conman::graph::DataFlowVertex::Ptr> start_order;
+      //! The blocks in \ref start_order which are in standby
+      conman::BlockSet promoted;
+      //! The execution plan once the switch has been applied
+      conman::ExecutionPlan plan;
+    };
+    //! The modes, indexed by mode handle
+    std::vector<CompiledMode> modes_;
+    //! A map from mode names onto mode handles
+    boost::unordered_map<std::string, conman::ModeHandle> mode_handles_;
+    //! The duration of the last mode switch (ns)
+    RTT::nsecs last_switch_duration_;
+    //! The longest duration of any mode switch (ns)
+    RTT::nsecs max_switch_duration_;
+    //! The number of mode switches
+    unsigned int switch_count_;
+    //! The most recently requested switch, guarded by \ref plan_mutex_
+    ModeSwitch mode_switch_;
+    //! True if \ref mode_switch_ has been requested but not applied
+    volatile bool switch_pending_;
+    //! The time of the cycle in which the last requested switch was applied
+    RTT::nsecs last_switch_time_;
+    //! Output port for \ref last_switch_time_
+    RTT::OutputPort<RTT::nsecs> switch_time_out_;
+    //\}
 
     //! \name Data Flow Graph Structures
     //\{
@@ -437,6 +886,43 @@ namespace conman
     conman::graph::DataFlowGraph flow_graph_;
     //! Mappings from TaskContext pointers to boost vertex descriptors
     conman::graph::DataFlowVertexTaskMap flow_vertex_map_;
+    //! Blocks whose ports need to be rescanned by regenerateModel
+    boost::unordered_set<RTT::TaskContext*> dirty_blocks_;
+    //! All port connections which are modeled by DFG edges
+    boost::unordered_set<std::pair<RTT::base::PortInterface*, RTT::base::PortInterface*> > modeled_connections_;
+    //! True if the ESG has changed since the ordering was last computed
+    bool topology_dirty_;
+    //\}
+
+    //! \name Transaction State
+    //\{
+    //! A mutation made inside of a transaction, and how to undo it
+    struct UndoEntry {
+      enum Type {
+        ADD_BLOCK,
+        REMOVE_BLOCK,
+        LATCH_CONNECTIONS,
+        LATCH_INPUTS,
+        LATCH_OUTPUTS
+      };
+      Type type;
+      //! The block (or the source block for connection latches)
+      RTT::TaskContext *block;
+      //! The sink block for connection latches
+      RTT::TaskContext *sink;
+      //! The previous latch flag
+      bool latched;
+      //! The previous block-level latch flags of removed blocks
+      bool latched_input;
+      bool latched_output;
+    };
+    //! True while a transaction is open
+    bool in_transaction_;
+    //! The mutations made in the open transaction, in order
+    std::vector<UndoEntry> undo_log_;
+    //! Blocks added in the open transaction whose conflicts are deferred
+    std::vector<RTT::TaskContext*> deferred_conflicts_;
+    //\}
 
     //! \name Execution Sampling Graph Structures
     //\{
@@ -446,6 +932,75 @@ namespace conman
     conman::graph::DataFlowVertexTaskMap exec_vertex_map_;
     //! Topologically sorted ordering of each graph
     conman::graph::ExecutionOrdering exec_ordering_;
+    //! The blocks in \ref exec_ordering_, for fast iteration
+    std::vector<conman::graph::DataFlowVertex::Ptr> exec_blocks_;
+    //! Incrementally maintained topological order of the ESG
+    conman::graph::DynamicTopologicalOrder<conman::graph::DataFlowGraph> exec_topology_;
+    //! The maximum number of cycles to enumerate (zero for unlimited)
+    unsigned int max_cycles_;
+    /** \brief Flat execution plan compiled from the ESG and iterated by
+     * updateHook
+     *
+     * This only contains the blocks which are running, and it is only
+     * modified by updateHook at a cycle boundary (or by any thread when the
+     * scheme isn't running).
+     */
+    conman::ExecutionPlan execution_plan_;
+    //! A newly-compiled plan waiting to be published by updateHook
+    conman::ExecutionPlan pending_plan_;
+    //! True if \ref pending_plan_ hasn't been published yet
+    volatile bool plan_pending_;
+    //! Mutex guarding \ref pending_plan_
+    RTT::os::Mutex plan_mutex_;
+    //! The longest multi-rate schedule (in cycles) which will be precomputed
+    unsigned int max_hyperperiod_;
+    //! If true, the phases of low-rate blocks are chosen to balance the load
+    bool balance_phases_;
+
+    class Auditor;
+    //! The period of the background audit in seconds, or zero to disable it
+    RTT::Seconds audit_period_;
+    //! The thread which audits the plan while the scheme is running, or NULL
+    Auditor *auditor_;
+
+    /** \brief Check if the latest plan no longer matches the blocks
+     *
+     * This compares the most recently compiled plan with the states of the
+     * blocks, the scheme's period, and each block's desired minimum period.
+     * This must be called with \ref plan_mutex_ held.
+     */
+    bool isPlanStale() const;
+    //! Start the background audit if \ref audit_period_ is positive
+    bool startAuditor();
+    //! Stop and destroy the background audit
+    void stopAuditor();
+    //\}
+
+    //! \name Parallel Execution
+    //\{
+    //! The execution mode used when the scheme is started (see ExecutionMode)
+    conman::ExecutionMode::Mode execution_mode_;
+    //! The number of worker threads in addition to the scheme's thread
+    unsigned int n_workers_;
+    //! The CPU affinity mask for the worker threads
+    unsigned int worker_cpu_affinity_;
+    //! The parallel executor, or NULL if blocks are executed serially
+    conman::Executor *executor_;
+    //! The pipeline stage of each block, indexed by vertex index
+    std::vector<unsigned int> stage_of_index_;
+    //! The latency in cycles added to the inputs of each pipeline stage
+    std::vector<int> stage_latencies_;
+
+    //! Create and start the executor for the current execution mode
+    bool startExecutor();
+    //! Stop and destroy the executor
+    void stopExecutor();
+    /** \brief Partition the scheme into pipeline stages
+     *
+     * This relays all latched connections between different stages through
+     * the given executor.
+     */
+    bool startPipeline(conman::PipelineExecutor *executor);
     //\}
 
     //! \name Runtime Conflict Graph Structures
@@ -460,13 +1015,108 @@ namespace conman
      * conflict graph
      */
     conman::graph::ConflictVertexMap conflict_vertex_map_;
+    /** \brief Dense copy of the RCG, indexed by block handle
+     *
+     * Each row has a bit set for each block which conflicts with that block.
+     */
+    std::vector<conman::BlockSet> conflict_matrix_;
+    /** \brief The blocks which are running, indexed by block handle
+     *
+     * This is updated whenever the scheme enables or disables a block and
+     * whenever the execution plan is compiled, so blocks which are started or
+     * stopped outside of the scheme are picked up by the next audit (see
+     * \ref auditExecutionPlan). Conflict checks only read this set, so a
+     * block which was stopped outside of the scheme might still be treated
+     * as running until then. Disabling such a block clears its bit.
+     */
+    conman::BlockSet running_blocks_;
+    //! Scratch set of the blocks to disable when force-enabling blocks
+    conman::BlockSet disabled_blocks_;
+    //\}
+
+    //! \name Frozen Model
+    //\{
+    //! Flat copy of the ESG used while the scheme is running
+    conman::graph::CompactModel compact_model_;
+    //! True while \ref compact_model_ reflects the graphs
+    bool model_frozen_;
     //\}
     
     //! Get a block vertex by name
     const conman::graph::DataFlowVertex::Ptr getBlockVertex(const std::string &name) const;
+    //! Check that all of the handles refer to blocks in the scheme
+    bool validHandles(const std::vector<conman::BlockHandle> &handles) const;
+    //! Add a list of blocks to \ref marked_blocks_
+    void markHandles(const std::vector<conman::BlockHandle> &handles);
+    //! Add the blocks (or the members of the groups) to \ref marked_blocks_
+    void markBlocks(const std::vector<std::string> &names);
+    //! Enable the blocks in \ref marked_blocks_ in execution order and clear it
+    bool enableMarkedBlocks(const bool strict, const bool force);
+    //! Disable the blocks (or all other blocks) in \ref marked_blocks_ and clear it
+    bool disableMarkedBlocks(const bool strict, const bool inverse);
+    /** \brief Recompute the flattened members of every group
+     *
+     * This is done whenever a group or the set of blocks changes, so that
+     * group lookups don't need to expand nested groups.
+     */
+    void cacheGroupMembers();
+    //! Enable a block which is known to be in the scheme
+    bool enableVertex(const conman::graph::DataFlowVertex::Ptr &block_vertex, const bool force);
+    //! Disable a block which is known to be in the scheme
+    bool disableVertex(const conman::graph::DataFlowVertex::Ptr &block_vertex);
+    /** \brief Start a block without checking for conflicts or recompiling the
+     * execution plan
+     */
+    bool startVertex(const conman::graph::DataFlowVertex::Ptr &block_vertex);
+    /** \brief Stop a running block without recompiling the execution plan
+     *
+     * Unless \param clear_gate is false, the connections of a block which
+     * has been in standby are restored. Otherwise, they're restored the next
+     * time the execution plan is compiled.
+     */
+    bool stopVertex(
+        const conman::graph::DataFlowVertex::Ptr &block_vertex,
+        const bool clear_gate = true);
+    //! Check if a block is running with its outputs held back
+    bool isStandby(const conman::graph::DataFlowVertex::Ptr &block_vertex) const;
+    /** \brief Flatten a mode's blocks and order them for execution
+     *
+     * Returns false (and complains unless \param quiet is set) if the mode
+     * can't be used.
+     */
+    bool compileMode(CompiledMode &mode, const bool quiet);
+    //! Recompile all of the modes
+    void compileModes();
+    /** \brief Compile a switch to a mode into \ref mode_switch_
+     *
+     * This must be called with \ref plan_mutex_ held. Returns false (and
+     * complains unless \param quiet is set) without changing \ref
+     * mode_switch_ if the mode can't be used.
+     */
+    bool compileModeSwitch(const conman::ModeHandle handle, const bool quiet);
+    /** \brief Apply \ref mode_switch_ and publish its execution plan
+     *
+     * This must be called with \ref plan_mutex_ held. It doesn't allocate
+     * or change any connections, since the gates of blocks which have been
+     * in standby are left open when they're stopped. Returns false if the
+     * switch was rolled back.
+     */
+    bool applyModeSwitch();
     //! Get a conflict vertex by task
     const conman::graph::ConflictVertexDescriptor getConflictVertex(RTT::TaskContext* task) const;
 
+    /** \brief Get a running block which conflicts with a given block
+     *
+     * This only reads \ref running_blocks_. Returns NULL if no conflicting
+     * blocks are running.
+     */
+    RTT::TaskContext* getRunningConflict(const conman::BlockHandle handle) const;
+
+    //! Resize the block sets after a block was added, keeping their bits
+    void resizeBlockSets();
+    //! Recompute the block sets from the RCG and the blocks' states
+    void rebuildBlockSets();
+
     /** \brief Connect a block in the graph structures
      *
      * This will model a block in the Data Flow, Execution Scheduling, and
@@ -478,6 +1128,13 @@ namespace conman
      */
     bool removeBlockFromGraph(conman::graph::DataFlowVertex::Ptr vertex);
 
+    /** \brief Model the connections on all of the ports of a block
+     *
+     * This adds DFG and ESG edges for any connections to or from the block
+     * which aren't already modeled, and returns true if the ESG was modified.
+     */
+    bool scanBlockConnections(const conman::graph::DataFlowVertex::Ptr &block_vertex);
+
     /** \brief Recursively get a flattened list of all members in a group
      *
      * This is the internal function used by the public \ref getGroupMembers.
@@ -492,6 +1149,30 @@ namespace conman
         const conman::graph::DataFlowGraph &data_flow_graph,
         std::vector<conman::graph::DataFlowPath> &cycles) const;
 
+    //! Compute the strongly connected components with cycles in a flow graph
+    int computeCyclicComponents(
+        const conman::graph::DataFlowGraph &data_flow_graph,
+        std::vector<conman::graph::DataFlowPath> &components) const;
+
+    /** \brief Get the DFG arcs between the blocks in a component
+     *
+     * Blocks are identified by their position in \param component. For each
+     * block, \param arcs lists the blocks it feeds and whether or not those
+     * connections are latched (1 or 0).
+     */
+    void getComponentArcs(
+        const conman::graph::DataFlowPath &component,
+        std::vector<std::vector<std::pair<unsigned int, int> > > &arcs) const;
+
+    //! Get the number of latched edges on a cycle given by its vertices
+    int cycleLatchCount(const conman::graph::DataFlowPath &cycle) const;
+
+    //! Get the block names of each path
+    void getPathNames(
+        const conman::graph::DataFlowGraph &data_flow_graph,
+        const std::vector<conman::graph::DataFlowPath> &paths,
+        std::vector<std::vector<std::string> > &path_names) const;
+
     //! Compute the schedule without modifying the scheme
     bool computeSchedule(
         const conman::graph::DataFlowGraph &data_flow_graph,
@@ -501,22 +1182,124 @@ namespace conman
     //! Print out the current execution ordering
     void printExecutionOrdering() const;
 
-    //! Time state
-    //TODO: use nsecs instead?
+    /** \brief Open a transaction without any checks or logging
+     *
+     * This is used for the implicit transactions which batch the changes of
+     * a single call, after the caller has made sure that the scheme is
+     * stopped and no transaction is open.
+     */
+    void openTransaction();
+
+    //! Record a mutation if a transaction is open
+    void recordUndo(
+        const UndoEntry::Type type,
+        RTT::TaskContext *block,
+        RTT::TaskContext *sink = NULL,
+        const bool latched = false);
+
+    /** \brief Close the open transaction and regenerate the model once
+     *
+     * If \param atomic is set and the resulting scheme isn't executable, the
+     * transaction is rolled back and this returns false.
+     */
+    bool endTransaction(const bool atomic);
+
+    //! Undo the mutations in the open transaction in reverse order
+    void rollbackTransaction();
+
+    /** \brief Compile the execution ordering into a flat execution plan
+     *
+     * This resolves each block's HookService and computes its rate divisor
+     * from the scheme period and the block's desired minimum execution
+     * period. Blocks which are already running keep their current phase.
+     */
+    void compileExecutionPlan();
+
+    /** \brief Build an execution plan for a given set of active blocks
+     *
+     * \param active is indexed by block handle. This must be called with
+     * \ref plan_mutex_ held.
+     */
+    void buildExecutionPlan(
+        const std::vector<bool> &active,
+        conman::ExecutionPlan &plan);
+
+    //! Copy the execution order and ESG into \ref compact_model_
+    void freezeModel();
+    /** \brief Get the vertex indices of a block's ESG successors or predecessors
+     *
+     * This reads \ref compact_model_ while it's frozen, and the ESG otherwise.
+     */
+    void getExecNeighbors(
+        const conman::graph::DataFlowVertex::Ptr &block_vertex,
+        const bool successors,
+        std::vector<unsigned int> &neighbors) const;
+
+    //! Replace the execution plan with the pending plan
+    void publishExecutionPlan();
+
+    /** \brief Execute a step which is due, subject to the cycle budget
+     *
+     * If the cycle has exceeded its budget, non-critical blocks are handled
+     * according to the overrun policy. This sets \c overrun when the budget
+     * is first found to be exceeded. The start of the cycle and \c timestamp
+     * are readings of \ref timer_ (see HookService::timedUpdate), while
+     * \c time is passed to the block.
+     */
+    bool executeStep(
+        conman::ExecutionStep &step,
+        const RTT::os::TimeService::nsecs time,
+        const RTT::os::TimeService::nsecs cycle_start,
+        RTT::nsecs &timestamp,
+        bool &overrun);
+
+    //! Time state (ns)
+    RTT::nsecs
+      last_exec_time_ns_,
+      last_exec_period_ns_;
+
+    //! Period statistics properties (only refreshed when sampled)
     RTT::Seconds
-      last_exec_time_,
       last_exec_period_,
       min_exec_period_,
       max_exec_period_;
 
-    //! Execution statistics
-    //TODO: use nsecs instead?
-    RTT::Seconds
+    //! Execution statistics (ns)
+    RTT::nsecs
       last_exec_duration_,
       min_exec_duration_,
       max_exec_duration_,
       smooth_exec_duration_;
 
+    //! The clock used to measure durations, applied on start (see TimerSource)
+    conman::TimerSource::Mode timer_source_;
+    //! The timer used to measure durations in this scheme and its executor
+    conman::Timer timer_;
+
+    //! Instrumentation level for the scheme's own statistics
+    conman::Instrumentation::Level instrumentation_;
+    //! Number of cycles per statistics sample when sampled
+    unsigned int instrumentation_sample_period_;
+    //! Number of cycles until the next sample
+    unsigned int sample_countdown_;
+
+    //! \name Cycle Budget
+    //\{
+    //! The maximum duration of each cycle in nanoseconds (zero for no budget)
+    RTT::nsecs cycle_budget_;
+    //! The handling of non-critical blocks after an overrun (see OverrunPolicy), which must be EVENT unless the execution mode is SERIAL
+    conman::OverrunPolicy::Mode overrun_policy_;
+    //! The number of cycles which have exceeded the budget
+    unsigned int overrun_count_;
+    //! The longest amount of time by which a cycle exceeded the budget (ns)
+    RTT::nsecs worst_overrun_;
+    //! Port for announcing the amount of time by which a cycle overran (ns)
+    RTT::OutputPort<RTT::nsecs> overrun_out_;
+    //! The number of steps which have been deferred to the next cycle
+    size_t n_deferred_steps_;
+    //\}
+
+    //! The number of blocks in the published execution plan
     size_t n_running_blocks_;
   };
 
@@ -0,0 +1,137 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_TIMER_H
+#define __CONMAN_TIMER_H
+
+#include <time.h>
+
+#include <rtt/RTT.hpp>
+#include <rtt/os/TimeService.hpp>
+
+namespace conman
+{
+  //! Timer sources describe which clock is used to measure durations.
+  struct TimerSource {
+    typedef unsigned int Mode;
+    //! The RTT TimeService (which may be simulated).
+    static const Mode RTT = 0;
+    //! The raw monotonic system clock, which isn't slewed by NTP.
+    static const Mode MONOTONIC_RAW = 1;
+    //! The CPU timestamp counter, calibrated against MONOTONIC_RAW.
+    static const Mode TSC = 2;
+  };
+
+  /** \brief Clock for measuring block execution durations
+   *
+   * Conman measures how long every block takes to execute, so with hundreds
+   * of blocks the cost of reading the clock becomes significant. This timer
+   * can read the CPU timestamp counter directly, which is much cheaper than
+   * a system call or the RTT TimeService.
+   *
+   * The timer is only used to measure durations. The time which is passed to
+   * blocks always comes from the RTT TimeService, since it may be simulated.
+   * Each Scheme owns a timer, so schemes can use different sources, but
+   * readings taken with different sources can't be compared. The timestamp
+   * counter calibration is shared by all timers.
+   */
+  class Timer
+  {
+  public:
+    Timer() : source_(TimerSource::RTT) { }
+
+    /** \brief Select the clock used to measure durations
+     *
+     * If the TSC is requested but it isn't available or isn't invariant, this
+     * falls back to MONOTONIC_RAW. Returns false for unknown sources.
+     */
+    bool setSource(const TimerSource::Mode source);
+
+    //! Get the clock which is actually being used
+    TimerSource::Mode getSource() const { return source_; }
+
+    //! Get the current time in nanoseconds from the selected source
+    inline RTT::nsecs getNSecs() const
+    {
+      return ReadNSecs(source_);
+    }
+
+    //! Get the time elapsed since a previous reading
+    inline RTT::nsecs getNSecs(const RTT::nsecs since) const
+    {
+      return ReadNSecs(source_) - since;
+    }
+
+    //! Get the current time in nanoseconds from a given source
+    static inline RTT::nsecs ReadNSecs(const TimerSource::Mode source)
+    {
+      switch(source) {
+        case TimerSource::TSC:
+          return TSCToNSecs(ReadTSC());
+        case TimerSource::MONOTONIC_RAW:
+          return ReadMonotonicRaw();
+        default:
+          return RTT::os::TimeService::Instance()->getNSecs();
+      };
+    }
+
+    //! Read the raw monotonic system clock in nanoseconds
+    static inline RTT::nsecs ReadMonotonicRaw()
+    {
+      struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+      clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+      return RTT::nsecs(ts.tv_sec) * 1000000000LL + RTT::nsecs(ts.tv_nsec);
+    }
+
+    //! Read the CPU timestamp counter (zero if it isn't supported)
+    static inline unsigned long long ReadTSC()
+    {
+#if defined(__x86_64__)
+      unsigned int lo, hi;
+      __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+      return (static_cast<unsigned long long>(hi) << 32) | lo;
+#else
+      return 0;
+#endif
+    }
+
+    //! Convert a timestamp counter reading to MONOTONIC_RAW nanoseconds
+    static inline RTT::nsecs TSCToNSecs(const unsigned long long tsc)
+    {
+#if defined(__x86_64__)
+      const unsigned __int128 delta = tsc - tsc_base_;
+      return ns_base_ + static_cast<RTT::nsecs>((delta * tsc_mult_) >> 32);
+#else
+      return ns_base_;
+#endif
+    }
+
+    /** \brief Calibrate the timestamp counter against MONOTONIC_RAW
+     *
+     * This busy-waits for the given duration. Returns false if the timestamp
+     * counter isn't available or isn't invariant across power states.
+     */
+    static bool CalibrateTSC(const RTT::nsecs duration = 20000000);
+
+    //! Get the calibrated timestamp counter frequency in Hz (zero if none)
+    static double GetTSCFrequency();
+
+  private:
+    //! The selected source
+    volatile TimerSource::Mode source_;
+    //! The timestamp counter reading at calibration
+    static unsigned long long tsc_base_;
+    //! The MONOTONIC_RAW time at calibration
+    static RTT::nsecs ns_base_;
+    //! Nanoseconds per timestamp counter tick in 32.32 fixed point
+    static unsigned long long tsc_mult_;
+  };
+}
+
+#endif // ifndef __CONMAN_TIMER_H
@@ -0,0 +1,63 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_WAVEFRONT_EXECUTOR_H
+#define __CONMAN_WAVEFRONT_EXECUTOR_H
+
+#include <vector>
+
+#include <conman/executor.h>
+
+namespace conman
+{
+  /** \brief Executor which runs each level of an ExecutionPlan concurrently
+   *
+   * All participating threads cooperatively claim the steps of a level with an
+   * atomic counter, and then wait at a barrier for the rest of the level to
+   * finish before moving on to the next level. Since blocks in the same level
+   * have no ESG paths between them, this preserves the ordering guarantees of
+   * serial execution.
+   *
+   * The barriers are spin-waits, so the scheme pins each worker to its own
+   * CPU, and those CPUs should otherwise be idle.
+   */
+  class WavefrontExecutor : public Executor
+  {
+  public:
+    WavefrontExecutor(const std::string &name, const conman::Timer &timer);
+
+    virtual void prepare(const conman::ExecutionPlan &plan);
+    virtual void configure(conman::ExecutionPlan &plan);
+    virtual bool execute(const RTT::nsecs time);
+
+  protected:
+    virtual void work(const unsigned int worker_id);
+
+  private:
+    //! Wait until all participants have finished a given level
+    void waitForLevel(const unsigned int level, const unsigned int target);
+
+    //! The plan being executed
+    conman::ExecutionPlan *plan_;
+    //! The time passed to each block in the current cycle
+    RTT::nsecs time_;
+    //! The number of cycles executed so far
+    volatile unsigned int cycle_;
+    //! Non-zero if any block failed to execute in the current cycle
+    volatile int failed_;
+    //! The number of times a participant has finished a cycle
+    volatile unsigned int finished_;
+    //! The next unclaimed step index in each level
+    std::vector<unsigned int> next_;
+    //! The number of times a participant has finished each level
+    std::vector<unsigned int> arrived_;
+    //! The claim counters for the next plan (see \ref prepare)
+    std::vector<unsigned int> prepared_next_;
+    //! The barrier counters for the next plan (see \ref prepare)
+    std::vector<unsigned int> prepared_arrived_;
+  };
+}
+
+#endif // ifndef __CONMAN_WAVEFRONT_EXECUTOR_H
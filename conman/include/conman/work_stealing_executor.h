@@ -0,0 +1,105 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#ifndef __CONMAN_WORK_STEALING_EXECUTOR_H
+#define __CONMAN_WORK_STEALING_EXECUTOR_H
+
+#include <vector>
+
+#include <conman/executor.h>
+
+namespace conman
+{
+  /** \brief Executor which schedules blocks as soon as their inputs are ready
+   *
+   * Each step in the plan has an atomic counter of unfinished ESG
+   * predecessors. When a participant finishes a step, it decrements the
+   * counters of the step's successors and pushes any which become ready onto
+   * its own deque. Idle participants steal from the other participants'
+   * deques, so long chains of blocks don't hold up independent branches the
+   * way that the level barriers of the WavefrontExecutor can.
+   *
+   * All of the per-cycle state is reset without allocation, since each deque
+   * is sized to hold every step in the plan.
+   *
+   * Idle participants spin while they look for work, so the scheme pins each
+   * worker to its own CPU, and those CPUs should otherwise be idle.
+   */
+  class WorkStealingExecutor : public Executor
+  {
+  public:
+    WorkStealingExecutor(const std::string &name, const conman::Timer &timer);
+
+    virtual void prepare(const conman::ExecutionPlan &plan);
+    virtual void configure(conman::ExecutionPlan &plan);
+    virtual bool execute(const RTT::nsecs time);
+    virtual bool getUtilization(std::vector<double> &utilization) const;
+
+  protected:
+    virtual void work(const unsigned int worker_id);
+
+  private:
+    /** \brief Bounded work-stealing deque of step indices
+     *
+     * The owner pushes and pops at the bottom, and thieves steal from the
+     * top (Chase and Lev, 2005). The buffer is never grown, since each step
+     * is pushed at most once per cycle.
+     */
+    struct Deque
+    {
+      std::vector<unsigned int> buffer;
+      volatile long top;
+      volatile long bottom;
+
+      Deque() : top(0), bottom(0) { }
+
+      //! Push a step (only called by the owner)
+      void push(const unsigned int step);
+      //! Pop the most recently pushed step (only called by the owner)
+      bool pop(unsigned int &step);
+      //! Steal the least recently pushed step (called by any participant)
+      bool steal(unsigned int &step);
+    };
+
+    //! Per-participant state, padded to avoid false sharing
+    struct Participant
+    {
+      Deque deque;
+      //! Time spent executing blocks since the executor was configured
+      RTT::nsecs busy_time;
+      char padding[64];
+
+      Participant() : busy_time(0) { }
+    };
+
+    //! Execute a step and release its successors
+    void executeStep(const unsigned int worker_id, const unsigned int step);
+
+    //! The plan being executed
+    conman::ExecutionPlan *plan_;
+    //! The time passed to each block in the current cycle
+    RTT::nsecs time_;
+    //! The number of cycles executed so far
+    volatile unsigned int cycle_;
+    //! Non-zero if any block failed to execute in the current cycle
+    volatile int failed_;
+    //! The number of steps which haven't finished in the current cycle
+    volatile unsigned int remaining_;
+    //! The number of times a participant has finished a cycle
+    volatile unsigned int finished_;
+    //! The number of unfinished predecessors of each step
+    std::vector<unsigned int> pending_;
+    //! The state of each participant (index 0 is the calling thread)
+    std::vector<Participant> participants_;
+    //! The predecessor counters for the next plan (see \ref prepare)
+    std::vector<unsigned int> prepared_pending_;
+    //! The deque buffers of each participant for the next plan
+    std::vector<std::vector<unsigned int> > prepared_buffers_;
+    //! The time at which the executor was configured
+    RTT::nsecs start_time_;
+  };
+}
+
+#endif // ifndef __CONMAN_WORK_STEALING_EXECUTOR_H
@@ -0,0 +1,60 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <algorithm>
+
+#include <conman/compact_graph.h>
+
+using namespace conman::graph;
+
+void CompactAdjacency::build(
+    const size_t n_vertices,
+    std::vector<std::pair<BlockId, BlockId> > edges)
+{
+  // Sorting the edges groups them by source and sorts each row by target
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  offsets.assign(n_vertices + 1, 0);
+  targets.resize(edges.size());
+
+  // Count the out-degree of each vertex
+  for(size_t i=0; i < edges.size(); i++) {
+    offsets[edges[i].first + 1]++;
+    targets[i] = edges[i].second;
+  }
+
+  // Accumulate the degrees into offsets
+  for(size_t v=0; v < n_vertices; v++) {
+    offsets[v+1] += offsets[v];
+  }
+}
+
+void CompactAdjacency::clear()
+{
+  offsets.assign(1, 0);
+  targets.clear();
+}
+
+bool CompactModel::getId(RTT::TaskContext *block, BlockId &id) const
+{
+  boost::unordered_map<RTT::TaskContext*, BlockId>::const_iterator it = ids.find(block);
+
+  if(it == ids.end()) {
+    return false;
+  }
+
+  id = it->second;
+  return true;
+}
+
+void CompactModel::clear()
+{
+  blocks.clear();
+  indices.clear();
+  ids.clear();
+  exec_out.clear();
+  exec_in.clear();
+}
@@ -8,3 +8,14 @@
 const conman::Exclusivity::Mode conman::Exclusivity::UNRESTRICTED;
 const conman::Exclusivity::Mode conman::Exclusivity::EXCLUSIVE;
 
+const conman::Criticality::Level conman::Criticality::BEST_EFFORT;
+const conman::Criticality::Level conman::Criticality::CRITICAL;
+
+const conman::OverrunPolicy::Mode conman::OverrunPolicy::EVENT;
+const conman::OverrunPolicy::Mode conman::OverrunPolicy::SKIP;
+const conman::OverrunPolicy::Mode conman::OverrunPolicy::DEFER;
+
+const conman::Instrumentation::Level conman::Instrumentation::OFF;
+const conman::Instrumentation::Level conman::Instrumentation::SAMPLED;
+const conman::Instrumentation::Level conman::Instrumentation::FULL;
+
@@ -0,0 +1,226 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <conman/execution_plan.h>
+
+using namespace conman;
+
+//! Greatest common divisor of two positive integers
+static unsigned long long GreatestCommonDivisor(
+    unsigned long long a,
+    unsigned long long b)
+{
+  while(b != 0) {
+    const unsigned long long r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+//! Find the representative of a set of steps with path compression
+static unsigned int FindCluster(
+    std::vector<unsigned int> &parents,
+    unsigned int i)
+{
+  while(parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+namespace {
+  //! A set of same-rate steps which must share a phase
+  struct PhaseCluster
+  {
+    unsigned int root;
+    unsigned int rate_divisor;
+    RTT::nsecs load;
+    bool pinned;
+    unsigned int phase;
+
+    PhaseCluster() : root(0), rate_divisor(0), load(0), pinned(false), phase(0) { }
+
+    //! Order clusters by decreasing load
+    bool operator<(const PhaseCluster &other) const
+    {
+      return load > other.load;
+    }
+  };
+}
+
+unsigned int ExecutionPlan::computeHyperperiod(const unsigned int max_hyperperiod) const
+{
+  unsigned long long lcm = 1;
+
+  for(std::vector<ExecutionStep>::const_iterator it = steps.begin();
+      it != steps.end();
+      ++it)
+  {
+    if(it->rate_divisor == 0) {
+      // The hooks decide when to run, so there's no static schedule
+      return 0;
+    }
+
+    lcm = lcm / GreatestCommonDivisor(lcm, it->rate_divisor) * it->rate_divisor;
+
+    if(lcm > max_hyperperiod) {
+      return 0;
+    }
+  }
+
+  return lcm;
+}
+
+bool ExecutionPlan::computeSlots(const unsigned int max_hyperperiod)
+{
+  slot_steps.clear();
+  slot_offsets.clear();
+
+  hyperperiod = this->computeHyperperiod(max_hyperperiod);
+
+  if(hyperperiod == 0) {
+    // This is only a failure if the scheme has a fixed period
+    for(std::vector<ExecutionStep>::const_iterator it = steps.begin();
+        it != steps.end();
+        ++it)
+    {
+      if(it->rate_divisor == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Build the list of due steps for each slot, preserving execution order
+  for(unsigned int slot=0; slot < hyperperiod; slot++) {
+    slot_offsets.push_back(slot_steps.size());
+
+    for(unsigned int i=0; i < steps.size(); i++) {
+      if(slot % steps[i].rate_divisor == steps[i].phase) {
+        slot_steps.push_back(i);
+      }
+    }
+  }
+  slot_offsets.push_back(slot_steps.size());
+
+  return true;
+}
+
+bool ExecutionPlan::balancePhases(
+    const std::vector<bool> &pinned,
+    const unsigned int max_hyperperiod)
+{
+  const unsigned int period = this->computeHyperperiod(max_hyperperiod);
+
+  if(period == 0) {
+    return false;
+  }
+
+  // Group same-rate steps which are directly connected in the ESG
+  std::vector<unsigned int> parents(steps.size());
+  for(unsigned int i=0; i < steps.size(); i++) {
+    parents[i] = i;
+  }
+
+  for(unsigned int i=0; i < steps.size(); i++) {
+    for(unsigned int s = successor_offsets[i]; s < successor_offsets[i+1]; s++) {
+      const unsigned int j = successors[s];
+      if(steps[i].rate_divisor == steps[j].rate_divisor) {
+        parents[FindCluster(parents, j)] = FindCluster(parents, i);
+      }
+    }
+  }
+
+  // Accumulate the load of each group, and keep the phases of pinned steps
+  std::vector<PhaseCluster> clusters(steps.size());
+  for(unsigned int i=0; i < steps.size(); i++) {
+    PhaseCluster &cluster = clusters[FindCluster(parents, i)];
+    cluster.rate_divisor = steps[i].rate_divisor;
+    cluster.load += steps[i].load;
+
+    if(i < pinned.size() && pinned[i] && !cluster.pinned) {
+      cluster.pinned = true;
+      cluster.phase = steps[i].phase;
+    }
+  }
+
+  for(unsigned int i=0; i < clusters.size(); i++) {
+    clusters[i].root = i;
+  }
+
+  // The load of each slot from the blocks which can't be moved
+  std::vector<RTT::nsecs> loads(period, 0);
+
+  for(unsigned int i=0; i < steps.size(); i++) {
+    const PhaseCluster &cluster = clusters[FindCluster(parents, i)];
+    if(cluster.pinned || cluster.rate_divisor == 1) {
+      const unsigned int phase = (i < pinned.size() && pinned[i]) ? steps[i].phase : cluster.phase;
+      for(unsigned int slot = phase; slot < period; slot += cluster.rate_divisor) {
+        loads[slot] += steps[i].load;
+      }
+    }
+  }
+
+  // Place the heaviest groups first (they're sorted into a copy so that the
+  // steps can still find their group by index)
+  std::vector<PhaseCluster> order(clusters);
+  std::stable_sort(order.begin(), order.end());
+
+  for(std::vector<PhaseCluster>::iterator it = order.begin();
+      it != order.end();
+      ++it)
+  {
+    // Skip entries which don't represent a group, groups which can't be
+    // moved, and groups which run every cycle
+    if(it->pinned || it->rate_divisor <= 1) {
+      continue;
+    }
+
+    // Choose the phase whose busiest slot is the least busy
+    unsigned int best_phase = 0;
+    RTT::nsecs best_peak = 0;
+
+    for(unsigned int phase=0; phase < it->rate_divisor; phase++) {
+      RTT::nsecs peak = 0;
+      for(unsigned int slot = phase; slot < period; slot += it->rate_divisor) {
+        peak = std::max(peak, loads[slot]);
+      }
+
+      if(phase == 0 || peak < best_peak) {
+        best_phase = phase;
+        best_peak = peak;
+      }
+    }
+
+    for(unsigned int slot = best_phase; slot < period; slot += it->rate_divisor) {
+      loads[slot] += it->load;
+    }
+
+    clusters[it->root].phase = best_phase;
+  }
+
+  // Assign each step the phase of its group
+  for(unsigned int i=0; i < steps.size(); i++) {
+    const PhaseCluster &cluster = clusters[FindCluster(parents, i)];
+    if(steps[i].rate_divisor > 0 && !(i < pinned.size() && pinned[i])) {
+      steps[i].phase = cluster.phase % steps[i].rate_divisor;
+    }
+  }
+
+  return true;
+}
+
+void ExecutionPlan::getSlotLoads(std::vector<RTT::nsecs> &loads) const
+{
+  loads.assign(hyperperiod, 0);
+
+  for(unsigned int slot=0; slot < hyperperiod; slot++) {
+    for(unsigned int i = slot_offsets[slot]; i < slot_offsets[slot+1]; i++) {
+      loads[slot] += steps[slot_steps[i]].load;
+    }
+  }
+}
@@ -0,0 +1,165 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <rtt/os/Thread.hpp>
+#include <rtt/os/Semaphore.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <conman/executor.h>
+
+using namespace conman;
+
+const ExecutionMode::Mode ExecutionMode::SERIAL;
+const ExecutionMode::Mode ExecutionMode::WAVEFRONT;
+const ExecutionMode::Mode ExecutionMode::WORK_STEALING;
+const ExecutionMode::Mode ExecutionMode::PIPELINE;
+
+/** \brief Non-periodic worker thread
+ *
+ * The worker's loop blocks on a semaphore, and calls Executor::work once each
+ * time it is signaled.
+ */
+class Executor::Worker : public RTT::os::Thread
+{
+public:
+  Worker(
+      Executor *executor,
+      const unsigned int id,
+      const int scheduler,
+      const int priority,
+      const unsigned int cpu_affinity,
+      const std::string &name) :
+    RTT::os::Thread(scheduler, priority, 0.0, cpu_affinity, name),
+    executor_(executor),
+    id_(id),
+    wakeup_(0),
+    quit_(false)
+  { }
+
+  //! Wake the worker up to execute its share of a cycle
+  void signal()
+  {
+    wakeup_.signal();
+  }
+
+protected:
+  virtual void loop()
+  {
+    while(true) {
+      wakeup_.wait();
+
+      if(quit_) {
+        break;
+      }
+
+      executor_->work(id_);
+    }
+  }
+
+  virtual bool breakLoop()
+  {
+    quit_ = true;
+    wakeup_.signal();
+    return true;
+  }
+
+private:
+  Executor *executor_;
+  const unsigned int id_;
+  RTT::os::Semaphore wakeup_;
+  volatile bool quit_;
+};
+
+Executor::Executor(const std::string &name, const conman::Timer &timer) :
+  timer_(timer),
+  name_(name)
+{
+}
+
+Executor::~Executor()
+{
+  this->stopWorkers();
+}
+
+bool Executor::startWorkers(
+    const unsigned int n_workers,
+    const int scheduler,
+    const int priority,
+    const unsigned int cpu_affinity,
+    const bool pin)
+{
+  RTT::Logger::In in("Executor::startWorkers");
+
+  this->stopWorkers();
+
+  // Get the CPUs in the affinity mask
+  std::vector<unsigned int> cpus;
+  for(unsigned int cpu=0; cpu < 8*sizeof(cpu_affinity); cpu++) {
+    if(cpu_affinity & (1U << cpu)) {
+      cpus.push_back(cpu);
+    }
+  }
+
+  for(unsigned int i=1; i <= n_workers; i++) {
+    const unsigned int worker_affinity = (pin && !cpus.empty())
+      ? (1U << cpus[(i-1) % cpus.size()])
+      : cpu_affinity;
+
+    Worker *worker = new Worker(
+        this, i,
+        scheduler, priority, worker_affinity,
+        name_ + "_worker_" + boost::lexical_cast<std::string>(i));
+
+    workers_.push_back(worker);
+
+    if(!worker->start()) {
+      RTT::log(RTT::Error) << "Could not start worker thread " << i <<
+        " for \"" << name_ << "\"." << RTT::endlog();
+      this->stopWorkers();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Executor::stopWorkers()
+{
+  for(std::vector<Worker*>::iterator it = workers_.begin();
+      it != workers_.end();
+      ++it)
+  {
+    (*it)->stop();
+    delete *it;
+  }
+
+  workers_.clear();
+}
+
+unsigned int Executor::getNumWorkers() const
+{
+  return workers_.size();
+}
+
+void Executor::prepare(const conman::ExecutionPlan &plan)
+{
+}
+
+bool Executor::getUtilization(std::vector<double> &utilization) const
+{
+  utilization.clear();
+  return false;
+}
+
+void Executor::dispatch()
+{
+  for(std::vector<Worker*>::iterator it = workers_.begin();
+      it != workers_.end();
+      ++it)
+  {
+    (*it)->signal();
+  }
+}
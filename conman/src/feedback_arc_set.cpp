@@ -0,0 +1,202 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <limits>
+#include <algorithm>
+
+#include <conman/feedback_arc_set.h>
+
+using namespace conman::graph;
+
+//! Find the ordering with the lightest backward arcs by dynamic programming
+static void ExactOrdering(
+    const size_t n_vertices,
+    const std::vector<WeightedArc> &arcs,
+    std::vector<size_t> &position)
+{
+  const size_t n_sets = size_t(1) << n_vertices;
+
+  // The weight of the arcs from v to u
+  std::vector<double> weight(n_vertices * n_vertices, 0.0);
+  std::vector<size_t> successors(n_vertices, 0);
+
+  for(std::vector<WeightedArc>::const_iterator it = arcs.begin();
+      it != arcs.end();
+      ++it)
+  {
+    if(it->source != it->target) {
+      weight[it->source * n_vertices + it->target] += it->weight;
+      successors[it->source] |= size_t(1) << it->target;
+    }
+  }
+
+  // cost[S] is the lightest backward weight of any ordering of the vertices
+  // in S which places them before all of the others, and last[S] is the last
+  // vertex in that ordering
+  std::vector<double> cost(n_sets, std::numeric_limits<double>::infinity());
+  std::vector<unsigned char> last(n_sets, 0);
+  cost[0] = 0.0;
+
+  for(size_t set = 0; set < n_sets; set++) {
+    for(size_t v = 0; v < n_vertices; v++) {
+      const size_t bit = size_t(1) << v;
+      if(set & bit) {
+        continue;
+      }
+
+      // Placing v after the vertices in S makes its arcs into S backwards
+      double set_cost = cost[set];
+      for(size_t backward = successors[v] & set; backward != 0; backward &= backward - 1) {
+        size_t u = 0;
+        while(!(backward & (size_t(1) << u))) { u++; }
+        set_cost += weight[v * n_vertices + u];
+      }
+
+      if(set_cost < cost[set | bit]) {
+        cost[set | bit] = set_cost;
+        last[set | bit] = v;
+      }
+    }
+  }
+
+  // Recover the ordering from the back
+  size_t set = n_sets - 1;
+  for(size_t i = n_vertices; i > 0; i--) {
+    const size_t v = last[set];
+    position[v] = i - 1;
+    set &= ~(size_t(1) << v);
+  }
+}
+
+//! Order the vertices with the weighted Eades-Lin-Smyth heuristic
+static void GreedyOrdering(
+    const size_t n_vertices,
+    const std::vector<WeightedArc> &arcs,
+    std::vector<size_t> &position)
+{
+  std::vector<std::vector<size_t> > out_arcs(n_vertices), in_arcs(n_vertices);
+  std::vector<size_t> out_count(n_vertices, 0), in_count(n_vertices, 0);
+  std::vector<double> out_weight(n_vertices, 0.0), in_weight(n_vertices, 0.0);
+
+  for(size_t a = 0; a < arcs.size(); a++) {
+    const WeightedArc &arc = arcs[a];
+    if(arc.source != arc.target) {
+      out_arcs[arc.source].push_back(a);
+      in_arcs[arc.target].push_back(a);
+      out_count[arc.source]++;
+      in_count[arc.target]++;
+      out_weight[arc.source] += arc.weight;
+      in_weight[arc.target] += arc.weight;
+    }
+  }
+
+  std::vector<bool> removed(n_vertices, false);
+  std::vector<size_t> head, tail;
+  size_t n_remaining = n_vertices;
+
+  for(;;) {
+    // Sinks go at the end and sources go at the front
+    bool changed = true;
+    while(changed) {
+      changed = false;
+      for(size_t v = 0; v < n_vertices; v++) {
+        if(removed[v]) {
+          continue;
+        }
+
+        if(out_count[v] == 0) {
+          tail.push_back(v);
+        } else if(in_count[v] == 0) {
+          head.push_back(v);
+        } else {
+          continue;
+        }
+
+        // Remove the vertex
+        removed[v] = true;
+        n_remaining--;
+        changed = true;
+
+        for(size_t i = 0; i < out_arcs[v].size(); i++) {
+          const WeightedArc &arc = arcs[out_arcs[v][i]];
+          in_count[arc.target]--;
+          in_weight[arc.target] -= arc.weight;
+        }
+        for(size_t i = 0; i < in_arcs[v].size(); i++) {
+          const WeightedArc &arc = arcs[in_arcs[v][i]];
+          out_count[arc.source]--;
+          out_weight[arc.source] -= arc.weight;
+        }
+      }
+    }
+
+    if(n_remaining == 0) {
+      break;
+    }
+
+    // Otherwise, move the vertex with the heaviest net outflow to the front
+    size_t best = n_vertices;
+    for(size_t v = 0; v < n_vertices; v++) {
+      if(!removed[v] && (best == n_vertices ||
+            out_weight[v] - in_weight[v] > out_weight[best] - in_weight[best]))
+      {
+        best = v;
+      }
+    }
+
+    // Pretend that it's a source, so that it's removed on the next pass
+    in_count[best] = 0;
+    for(size_t i = 0; i < in_arcs[best].size(); i++) {
+      const WeightedArc &arc = arcs[in_arcs[best][i]];
+      if(!removed[arc.source]) {
+        out_count[arc.source]--;
+        out_weight[arc.source] -= arc.weight;
+      }
+    }
+    in_arcs[best].clear();
+  }
+
+  // The sinks were collected from the back
+  size_t i = 0;
+  for(std::vector<size_t>::const_iterator it = head.begin(); it != head.end(); ++it) {
+    position[*it] = i++;
+  }
+  for(std::vector<size_t>::const_reverse_iterator it = tail.rbegin(); it != tail.rend(); ++it) {
+    position[*it] = i++;
+  }
+}
+
+double conman::graph::FeedbackArcSet(
+    const size_t n_vertices,
+    const std::vector<WeightedArc> &arcs,
+    std::vector<size_t> &feedback_arcs,
+    const size_t max_exact_vertices)
+{
+  feedback_arcs.clear();
+
+  if(n_vertices == 0) {
+    return 0.0;
+  }
+
+  // Compute a linear ordering of the vertices
+  std::vector<size_t> position(n_vertices, 0);
+
+  if(n_vertices <= std::min(max_exact_vertices, size_t(20))) {
+    ExactOrdering(n_vertices, arcs, position);
+  } else {
+    GreedyOrdering(n_vertices, arcs, position);
+  }
+
+  // Collect the arcs which point backwards
+  double total_weight = 0.0;
+  for(size_t a = 0; a < arcs.size(); a++) {
+    if(position[arcs[a].source] >= position[arcs[a].target]) {
+      feedback_arcs.push_back(a);
+      total_weight += arcs[a].weight;
+    }
+  }
+
+  return total_weight;
+}
@@ -0,0 +1,134 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <rtt/os/main.h>
+#include <rtt/Logger.hpp>
+#include <rtt/deployment/ComponentLoader.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <conman/conman.h>
+#include <conman/scheme.h>
+#include <conman/hook.h>
+#include <conman/hook_service.h>
+
+/** \brief Microbenchmark for the per-block cost of executing a conman block
+ *
+ * This compares calling each block's hook through the conman::Hook
+ * OperationCaller (the path used by the scheme before it cached direct
+ * HookService pointers) against calling the HookService directly, and
+ * reports the cost of a full scheme cycle.
+ *
+ * Usage: hook_benchmark [n_blocks] [n_cycles]
+ */
+
+//! A block which does nothing, so that only the execution overhead is measured
+class NullBlock : public RTT::TaskContext
+{
+public:
+  NullBlock(const std::string &name) : RTT::TaskContext(name) { }
+  void updateHook() { }
+};
+
+static void Report(
+    const std::string &name,
+    const RTT::nsecs elapsed,
+    const size_t n_blocks,
+    const size_t n_cycles)
+{
+  std::printf("  %-28s %10.1f ns/block %12.1f us/cycle\n",
+      name.c_str(),
+      double(elapsed) / double(n_blocks * n_cycles),
+      double(elapsed) / double(n_cycles) / 1E3);
+}
+
+int ORO_main(int argc, char** argv)
+{
+  RTT::Logger::log().setLogLevel(RTT::Logger::Warning);
+
+  const size_t n_blocks = (argc > 1) ? boost::lexical_cast<size_t>(argv[1]) : 150;
+  const size_t n_cycles = (argc > 2) ? boost::lexical_cast<size_t>(argv[2]) : 10000;
+
+  // Import the conman hook plugin
+  RTT::ComponentLoader::Instance()->import("conman", "");
+
+  conman::Scheme scheme("Scheme");
+
+  // Create and enable the blocks
+  std::vector<NullBlock*> blocks;
+  std::vector<boost::shared_ptr<conman::Hook> > hooks;
+  std::vector<conman::HookService*> hook_services;
+
+  for(size_t i=0; i < n_blocks; i++) {
+    NullBlock *block = new NullBlock("block_" + boost::lexical_cast<std::string>(i));
+
+    if(!scheme.addBlock(block) || !block->configure() || !scheme.enableBlock(block, false)) {
+      std::fprintf(stderr, "Could not add block %lu to the scheme.\n", (unsigned long)i);
+      return -1;
+    }
+
+    blocks.push_back(block);
+    hooks.push_back(conman::Hook::GetHook(block));
+    hook_services.push_back(conman::HookService::GetHookService(block));
+  }
+
+  std::printf("Executing %lu blocks for %lu cycles:\n",
+      (unsigned long)n_blocks, (unsigned long)n_cycles);
+
+  RTT::os::TimeService *time_service = RTT::os::TimeService::Instance();
+  RTT::Seconds time = 1.0;
+  RTT::nsecs start;
+
+  // Each hook call through the RTT OperationCaller
+  start = time_service->getNSecs();
+  for(size_t c=0; c < n_cycles; c++) {
+    time += 0.001;
+    for(size_t i=0; i < n_blocks; i++) {
+      hooks[i]->update(time);
+    }
+  }
+  Report("Hook::update (caller)", time_service->getNSecs(start), n_blocks, n_cycles);
+
+  // Each hook call directly on the service
+  start = time_service->getNSecs();
+  for(size_t c=0; c < n_cycles; c++) {
+    time += 0.001;
+    for(size_t i=0; i < n_blocks; i++) {
+      hook_services[i]->update(time);
+    }
+  }
+  Report("HookService::update (direct)", time_service->getNSecs(start), n_blocks, n_cycles);
+
+  // Each hook call directly on the service, without the period check
+  start = time_service->getNSecs();
+  for(size_t c=0; c < n_cycles; c++) {
+    time += 0.001;
+    for(size_t i=0; i < n_blocks; i++) {
+      hook_services[i]->execute(time);
+    }
+  }
+  Report("HookService::execute (direct)", time_service->getNSecs(start), n_blocks, n_cycles);
+
+  // Full scheme cycles
+  start = time_service->getNSecs();
+  for(size_t c=0; c < n_cycles; c++) {
+    scheme.updateHook();
+  }
+  Report("Scheme::updateHook", time_service->getNSecs(start), n_blocks, n_cycles);
+
+  // Clean up
+  scheme.disableBlocks(false);
+  for(size_t i=0; i < n_blocks; i++) {
+    scheme.removeBlock(blocks[i]);
+    delete blocks[i];
+  }
+
+  return 0;
+}
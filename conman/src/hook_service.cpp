@@ -3,40 +3,72 @@
  * this license, please see LICENSE.txt at the root of this repository. 
  */
 
-#include <rtt/plugin/ServicePlugin.hpp>
-
 #include <conman/hook_service.h>
+#include <conman/timer.h>
+
+#include <limits>
 
 #include <boost/algorithm/string.hpp>
 
 using namespace conman;
 
-ORO_SERVICE_NAMED_PLUGIN(conman::HookService, "conman_hook");
-
 HookService::HookService(RTT::TaskContext* owner) :
   RTT::Service("conman_hook",owner),
   // Property Initialization
+  init_(true),
   desired_min_exec_period_(0.0),
+  desired_min_exec_period_ns_(0),
+  criticality_(Criticality::BEST_EFFORT),
   exec_duration_smoothing_factor_(0.99),
-  smooth_exec_period_(0.0),
-  min_exec_period_(1E9),
+  instrumentation_(Instrumentation::FULL),
+  instrumentation_sample_period_(10),
+  sample_countdown_(1),
+  last_exec_time_ns_(0),
+  last_exec_period_ns_(0),
+  min_exec_period_ns_(std::numeric_limits<RTT::nsecs>::max()),
+  max_exec_period_ns_(0),
+  last_exec_duration_ns_(0),
+  min_exec_duration_ns_(std::numeric_limits<RTT::nsecs>::max()),
+  max_exec_duration_ns_(0),
+  smooth_exec_period_ns_(0.0),
+  var_exec_period_ns_(0.0),
+  smooth_exec_duration_ns_(0.0),
+  var_exec_duration_ns_(0.0),
+  last_exec_time_(0.0),
+  last_exec_period_(0.0),
+  min_exec_period_(0.0),
   max_exec_period_(0.0),
+  smooth_exec_period_(0.0),
   var_exec_period_(0.0),
-  smooth_exec_duration_(0.0),
-  min_exec_duration_(1E9),
+  last_exec_duration_(0.0),
+  min_exec_duration_(0.0),
   max_exec_duration_(0.0),
+  smooth_exec_duration_(0.0),
   var_exec_duration_(0.0)
 { 
   // Constants 
   this->provides("exclusivity")->addConstant("UNRESTRICTED",Exclusivity::UNRESTRICTED);
   this->provides("exclusivity")->addConstant("EXCLUSIVE",Exclusivity::EXCLUSIVE);
+  this->provides("criticality")->addConstant("BEST_EFFORT",Criticality::BEST_EFFORT);
+  this->provides("criticality")->addConstant("CRITICAL",Criticality::CRITICAL);
+  this->provides("instrumentation")->addConstant("OFF",Instrumentation::OFF);
+  this->provides("instrumentation")->addConstant("SAMPLED",Instrumentation::SAMPLED);
+  this->provides("instrumentation")->addConstant("FULL",Instrumentation::FULL);
 
   // Conman Properties
   this->addProperty("desired_min_exec_period",desired_min_exec_period_)
     .doc("The desired (minimum) execution period for this block, in seconds. By default, "
-        "this is 0 and it will run as fast as the scheme period.");
+        "this is 0 and it will run as fast as the scheme period. A running scheme only "
+        "applies a change once it audits its execution plan.");
+  this->addProperty("criticality",criticality_)
+    .doc("The criticality of this block. Critical blocks are executed even when "
+        "the scheme's cycle budget has been exceeded.");
   this->addProperty("exec_duration_smoothing_factor",exec_duration_smoothing_factor_)
     .doc("The exponential smoothing factor (between 0.0 and 1.0) used for measuring execution duration.");
+  this->addProperty("instrumentation",instrumentation_)
+    .doc("How often execution statistics are computed (see the instrumentation service).");
+  this->addProperty("instrumentation_sample_period",instrumentation_sample_period_)
+    .doc("The number of executions per statistics sample when the instrumentation is SAMPLED.");
 
   // Introspection Properties
   this->addProperty("last_exec_time",last_exec_time_)
@@ -67,6 +99,10 @@ HookService::HookService(RTT::TaskContext* owner) :
   // Conman Configuration Interface
   this->addOperation("setDesiredMinPeriod",&HookService::setDesiredMinPeriod,this,RTT::ClientThread);
   this->addOperation("getDesiredMinPeriod",&HookService::getDesiredMinPeriod,this,RTT::ClientThread);
+  this->addOperation("setCriticality",&HookService::setCriticality,this,RTT::ClientThread);
+  this->addOperation("getCriticality",&HookService::getCriticality,this,RTT::ClientThread);
+  this->addOperation("setInstrumentation",&HookService::setInstrumentation,this,RTT::ClientThread);
+  this->addOperation("getInstrumentation",&HookService::getInstrumentation,this,RTT::ClientThread);
   this->addOperation("setInputExclusivity",&HookService::setInputExclusivity,this,RTT::ClientThread);
   this->addOperation("getInputExclusivity",&HookService::getInputExclusivity,this,RTT::ClientThread);
   this->addOperation("getRegisteredInputPorts",&HookService::getRegisteredInputPorts,this,RTT::ClientThread);
@@ -85,6 +121,14 @@ HookService::HookService(RTT::TaskContext* owner) :
   this->addOperation("getDurationMin",&HookService::getDurationMin,this,RTT::ClientThread);
   this->addOperation("getDurationMax",&HookService::getDurationMax,this,RTT::ClientThread);
   this->addOperation("getDurationVar",&HookService::getDurationVar,this,RTT::ClientThread);
+  this->addOperation("getTimeNSecs",&HookService::getTimeNSecs,this,RTT::ClientThread);
+  this->addOperation("getPeriodNSecs",&HookService::getPeriodNSecs,this,RTT::ClientThread);
+  this->addOperation("getPeriodMinNSecs",&HookService::getPeriodMinNSecs,this,RTT::ClientThread);
+  this->addOperation("getPeriodMaxNSecs",&HookService::getPeriodMaxNSecs,this,RTT::ClientThread);
+  this->addOperation("getDurationNSecs",&HookService::getDurationNSecs,this,RTT::ClientThread);
+  this->addOperation("getDurationAvgNSecs",&HookService::getDurationAvgNSecs,this,RTT::ClientThread);
+  this->addOperation("getDurationMinNSecs",&HookService::getDurationMinNSecs,this,RTT::ClientThread);
+  this->addOperation("getDurationMaxNSecs",&HookService::getDurationMaxNSecs,this,RTT::ClientThread);
 
   // Conman Execution Interface
   // Note: These must be client-thread-based because they are called from the master activity
@@ -92,6 +136,13 @@ HookService::HookService(RTT::TaskContext* owner) :
     .doc("Initialize period computation and execution statistics.");
   this->addOperation("update",&HookService::update,this,RTT::ClientThread)
     .doc("Execute the owner's updateHook and compute execution statistics");
+  this->addOperation("execute",&HookService::execute,this,RTT::ClientThread)
+    .doc("Execute the owner's updateHook regardless of the desired minimum "
+        "execution period and compute execution statistics");
+  this->addOperation("updateNSecs",&HookService::updateNSecs,this,RTT::ClientThread)
+    .doc("Same as update, with the time in nanoseconds.");
+  this->addOperation("executeNSecs",&HookService::executeNSecs,this,RTT::ClientThread)
+    .doc("Same as execute, with the time in nanoseconds.");
 }
 
 bool HookService::setDesiredMinPeriod(const RTT::Seconds period) 
@@ -103,6 +154,7 @@ bool HookService::setDesiredMinPeriod(const RTT::Seconds period)
 
   // Store the period
   desired_min_exec_period_ = period;
+  desired_min_exec_period_ns_ = SecondsToNSecs(period);
   // Reset init flag
   this->init(0.0);
     
@@ -114,6 +166,42 @@ RTT::Seconds HookService::getDesiredMinPeriod()
   return desired_min_exec_period_;
 }
 
+RTT::nsecs HookService::getDesiredMinPeriodNSecs() const
+{
+  return SecondsToNSecs(desired_min_exec_period_);
+}
+
+bool HookService::setCriticality(const unsigned int level)
+{
+  criticality_ = level;
+  return true;
+}
+
+unsigned int HookService::getCriticality()
+{
+  return criticality_;
+}
+
+bool HookService::setInstrumentation(
+    const unsigned int level,
+    const unsigned int sample_period)
+{
+  if(level > Instrumentation::FULL || sample_period == 0) {
+    return false;
+  }
+
+  instrumentation_ = level;
+  instrumentation_sample_period_ = sample_period;
+  sample_countdown_ = 1;
+
+  return true;
+}
+
+unsigned int HookService::getInstrumentation()
+{
+  return instrumentation_;
+}
+
 bool HookService::setInputExclusivity(
     const std::string &port_name,
     const unsigned int mode)
@@ -172,49 +260,82 @@ std::vector<std::string> HookService::getRegisteredInputPorts() const {
 
 RTT::Seconds HookService::getTime() 
 {
-  return last_exec_time_;
+  return RTT::nsecs_to_Seconds(last_exec_time_ns_);
 }
 
 RTT::Seconds HookService::getPeriod() 
 {
-  return last_exec_period_;
+  return RTT::nsecs_to_Seconds(last_exec_period_ns_);
 }
 RTT::Seconds HookService::getPeriodAvg() 
 {
-  return smooth_exec_period_;
+  return smooth_exec_period_ns_ * 1E-9;
 }
 RTT::Seconds HookService::getPeriodMin() 
 {
-  return min_exec_period_;
+  return RTT::nsecs_to_Seconds(min_exec_period_ns_);
 }
 RTT::Seconds HookService::getPeriodMax() 
 {
-  return max_exec_period_;
+  return RTT::nsecs_to_Seconds(max_exec_period_ns_);
 }
 RTT::Seconds HookService::getPeriodVar() 
 {
-  return var_exec_period_;
+  return var_exec_period_ns_ * 1E-18;
 }
 
 RTT::Seconds HookService::getDuration() 
 {
-  return last_exec_duration_;
+  return RTT::nsecs_to_Seconds(last_exec_duration_ns_);
 }
 RTT::Seconds HookService::getDurationAvg() 
 {
-  return smooth_exec_duration_;
+  return smooth_exec_duration_ns_ * 1E-9;
 }
 RTT::Seconds HookService::getDurationMin() 
 {
-  return min_exec_duration_;
+  return RTT::nsecs_to_Seconds(min_exec_duration_ns_);
 }
 RTT::Seconds HookService::getDurationMax() 
 {
-  return max_exec_duration_;
+  return RTT::nsecs_to_Seconds(max_exec_duration_ns_);
 }
 RTT::Seconds HookService::getDurationVar() 
 {
-  return var_exec_duration_;
+  return var_exec_duration_ns_ * 1E-18;
+}
+
+RTT::nsecs HookService::getTimeNSecs() const
+{
+  return last_exec_time_ns_;
+}
+RTT::nsecs HookService::getPeriodNSecs() const
+{
+  return last_exec_period_ns_;
+}
+RTT::nsecs HookService::getPeriodMinNSecs() const
+{
+  return min_exec_period_ns_;
+}
+RTT::nsecs HookService::getPeriodMaxNSecs() const
+{
+  return max_exec_period_ns_;
+}
+RTT::nsecs HookService::getDurationNSecs() const
+{
+  return last_exec_duration_ns_;
+}
+RTT::nsecs HookService::getDurationAvgNSecs() const
+{
+  return static_cast<RTT::nsecs>(smooth_exec_duration_ns_ + 0.5);
+}
+RTT::nsecs HookService::getDurationMinNSecs() const
+{
+  return min_exec_duration_ns_;
+}
+RTT::nsecs HookService::getDurationMaxNSecs() const
+{
+  return max_exec_duration_ns_;
 }
 
 
@@ -226,60 +347,158 @@ bool HookService::init(const RTT::Seconds time)
 
 bool HookService::update(const RTT::Seconds time) 
 {
-  // Handle initialization explicitly or if time resets (like in simulation)
-  if(init_ || time <= last_exec_time_) {
-    last_exec_time_ = time - desired_min_exec_period_;
+  return this->updateNSecs(SecondsToNSecs(time));
+}
 
-    min_exec_period_ = 1E9;
-    max_exec_period_ = 0.0;
-    var_exec_period_ = 0.0;
+bool HookService::execute(const RTT::Seconds time) 
+{
+  return this->executeNSecs(SecondsToNSecs(time));
+}
 
-    min_exec_duration_ = 1E9;
-    max_exec_duration_ = 0.0;
-    var_exec_duration_ = 0.0;
+bool HookService::updateNSecs(const RTT::nsecs time) 
+{
+  RTT::nsecs timestamp = 0;
+  return this->timedUpdate(time, timer_, timestamp);
+}
 
-    init_ = false;
-  }
+bool HookService::executeNSecs(const RTT::nsecs time) 
+{
+  RTT::nsecs timestamp = 0;
+  return this->timedExecute(time, timer_, timestamp);
+}
 
-  RTT::Seconds time_since_last_exec = time - last_exec_time_;
+bool HookService::timedUpdate(
+    const RTT::nsecs time,
+    const conman::Timer &timer,
+    RTT::nsecs &timestamp)
+{
+  // Handle initialization explicitly or if time resets (like in simulation)
+  if(init_ || time <= last_exec_time_ns_) {
+    this->resetStatistics(time);
+  }
 
   // Return true if we haven't met the desired minimum execution period
   // TODO: Subtract half the scheme period here for better timing?
-  if(time_since_last_exec < desired_min_exec_period_) {
+  if(time - last_exec_time_ns_ < desired_min_exec_period_ns_) {
     return true;
   }
-  
-  // Compute statistics describing how often update is being called
-  last_exec_period_ = time_since_last_exec;
-  last_exec_time_ = time;
 
-  min_exec_period_ = std::min(min_exec_period_,last_exec_period_);
-  max_exec_period_ = std::max(max_exec_period_,last_exec_period_);
+  return this->executeOwner(time, timer, timestamp);
+}
+
+bool HookService::timedExecute(
+    const RTT::nsecs time,
+    const conman::Timer &timer,
+    RTT::nsecs &timestamp)
+{
+  // Handle initialization explicitly or if time resets (like in simulation)
+  if(init_ || time <= last_exec_time_ns_) {
+    this->resetStatistics(time);
+  }
+
+  return this->executeOwner(time, timer, timestamp);
+}
+
+void HookService::resetStatistics(const RTT::nsecs time) 
+{
+  // Pick up any change to the desired period property
+  desired_min_exec_period_ns_ = SecondsToNSecs(desired_min_exec_period_);
+
+  last_exec_time_ns_ = time - desired_min_exec_period_ns_;
+
+  min_exec_period_ns_ = std::numeric_limits<RTT::nsecs>::max();
+  max_exec_period_ns_ = 0;
+  var_exec_period_ns_ = 0.0;
+
+  min_exec_duration_ns_ = std::numeric_limits<RTT::nsecs>::max();
+  max_exec_duration_ns_ = 0;
+  var_exec_duration_ns_ = 0.0;
+
+  init_ = false;
+}
+
+bool HookService::executeOwner(
+    const RTT::nsecs time,
+    const conman::Timer &timer,
+    RTT::nsecs &timestamp)
+{
+  // The period is always needed for scheduling
+  last_exec_period_ns_ = time - last_exec_time_ns_;
+  last_exec_time_ns_ = time;
+
+  // Decide whether or not to compute statistics for this execution
+  bool sample = (instrumentation_ == Instrumentation::FULL);
+  if(instrumentation_ == Instrumentation::SAMPLED && --sample_countdown_ == 0) {
+    sample_countdown_ = std::max(instrumentation_sample_period_, 1U);
+    sample = true;
+  }
+
+  if(!sample) {
+    timestamp = 0;
+    return this->getOwner()->update();
+  }
 
-  // Track how long it takes to execute the component's update hook
-  RTT::nsecs exec_start = RTT::os::TimeService::Instance()->getNSecs();
+  // Compute statistics describing how often update is being called
+  min_exec_period_ns_ = std::min(min_exec_period_ns_,last_exec_period_ns_);
+  max_exec_period_ns_ = std::max(max_exec_period_ns_,last_exec_period_ns_);
+
+  // Track how long it takes to execute the component's update hook, starting
+  // from the caller's reading if it has one
+  const RTT::nsecs exec_start = (timestamp != 0) ? timestamp : timer.getNSecs();
 
   // Execute the component's update hook
   bool success = this->getOwner()->update();
 
   // Compute statistics describing how long it actually took to update
-  last_exec_duration_ = 
-    RTT::nsecs_to_Seconds(RTT::os::TimeService::Instance()->getNSecs(exec_start));
+  timestamp = timer.getNSecs();
+  last_exec_duration_ns_ = timestamp - exec_start;
   
-  min_exec_duration_ = std::min(min_exec_duration_,last_exec_duration_);
-  max_exec_duration_ = std::max(max_exec_duration_,last_exec_duration_);
+  min_exec_duration_ns_ = std::min(min_exec_duration_ns_,last_exec_duration_ns_);
+  max_exec_duration_ns_ = std::max(max_exec_duration_ns_,last_exec_duration_ns_);
 
   const double &a = exec_duration_smoothing_factor_;
-  var_exec_duration_ = (1.0-a)*(var_exec_duration_ + a*pow(last_exec_duration_ - smooth_exec_duration_,2));
-  var_exec_period_ = (1.0-a)*(var_exec_period_ + a*pow(last_exec_period_ - smooth_exec_period_,2));
+  const double
+    duration_error = double(last_exec_duration_ns_) - smooth_exec_duration_ns_,
+    period_error = double(last_exec_period_ns_) - smooth_exec_period_ns_;
+
+  var_exec_duration_ns_ = (1.0-a)*(var_exec_duration_ns_ + a*duration_error*duration_error);
+  var_exec_period_ns_ = (1.0-a)*(var_exec_period_ns_ + a*period_error*period_error);
 
-  smooth_exec_duration_ = a*smooth_exec_duration_ + (1.0-a)*last_exec_duration_;
-  smooth_exec_period_ = a*smooth_exec_period_ + (1.0-a)*last_exec_period_;
+  smooth_exec_duration_ns_ = a*smooth_exec_duration_ns_ + (1.0-a)*double(last_exec_duration_ns_);
+  smooth_exec_period_ns_ = a*smooth_exec_period_ns_ + (1.0-a)*double(last_exec_period_ns_);
 
+  this->publishStatistics();
 
   return success;
 }
 
+void HookService::publishStatistics()
+{
+  last_exec_time_ = RTT::nsecs_to_Seconds(last_exec_time_ns_);
+
+  last_exec_period_ = RTT::nsecs_to_Seconds(last_exec_period_ns_);
+  min_exec_period_ = RTT::nsecs_to_Seconds(min_exec_period_ns_);
+  max_exec_period_ = RTT::nsecs_to_Seconds(max_exec_period_ns_);
+  smooth_exec_period_ = smooth_exec_period_ns_ * 1E-9;
+  var_exec_period_ = var_exec_period_ns_ * 1E-18;
+
+  last_exec_duration_ = RTT::nsecs_to_Seconds(last_exec_duration_ns_);
+  min_exec_duration_ = RTT::nsecs_to_Seconds(min_exec_duration_ns_);
+  max_exec_duration_ = RTT::nsecs_to_Seconds(max_exec_duration_ns_);
+  smooth_exec_duration_ = smooth_exec_duration_ns_ * 1E-9;
+  var_exec_duration_ = var_exec_duration_ns_ * 1E-18;
+}
+
+HookService* HookService::GetHookService(RTT::TaskContext *task)
+{
+  if(task == NULL || !task->provides()->hasService("conman_hook")) {
+    return NULL;
+  }
+
+  // The Scheme calls the service directly, so it has to be a HookService
+  return dynamic_cast<HookService*>(task->provides()->getService("conman_hook").get());
+}
+
 RTT::base::PortInterface* HookService::getOwnerPort(const std::string &name) {
   std::vector<std::string> tokens;
   boost::split(tokens, name, boost::is_any_of("."));
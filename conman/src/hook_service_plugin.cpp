@@ -0,0 +1,12 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved. 
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository. 
+ */
+
+#include <rtt/plugin/ServicePlugin.hpp>
+
+#include <conman/hook_service.h>
+
+// The HookService itself lives in the conman library so that a Scheme can
+// call it directly, this plugin just makes it loadable by name.
+ORO_SERVICE_NAMED_PLUGIN(conman::HookService, "conman_hook");
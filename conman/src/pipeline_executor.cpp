@@ -0,0 +1,218 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <algorithm>
+
+#include <conman/pipeline_executor.h>
+
+using namespace conman;
+
+namespace {
+  //! Ordering of stages by decreasing estimated load
+  struct StageLoadGreater
+  {
+    const std::vector<RTT::nsecs> &loads;
+    StageLoadGreater(const std::vector<RTT::nsecs> &loads_) : loads(loads_) { }
+    bool operator()(const unsigned int a, const unsigned int b) const
+    {
+      return loads[a] > loads[b];
+    }
+  };
+}
+
+PipelineExecutor::PipelineExecutor(const std::string &name, const conman::Timer &timer) :
+  Executor(name, timer),
+  plan_(NULL),
+  time_(0),
+  cycle_(0),
+  failed_(0),
+  finished_(0),
+  start_time_(0),
+  prepared_(false)
+{
+}
+
+PipelineExecutor::~PipelineExecutor()
+{
+  // Stop the workers before restoring the original connections
+  this->stopWorkers();
+
+  for(std::vector<PortRelay*>::iterator it = relays_.begin();
+      it != relays_.end();
+      ++it)
+  {
+    delete *it;
+  }
+}
+
+void PipelineExecutor::addRelay(conman::PortRelay *relay)
+{
+  relays_.push_back(relay);
+}
+
+void PipelineExecutor::prepare(const conman::ExecutionPlan &plan)
+{
+  const unsigned int n_participants = this->getNumWorkers() + 1;
+
+  // The number of participants only changes when the workers are started,
+  // which happens before the first plan is prepared
+  if(participant_busy_time_.size() != n_participants) {
+    participant_busy_time_.assign(n_participants, 0);
+  }
+
+  // Estimate the load of each stage
+  unsigned int n_stages = 0;
+  for(std::vector<ExecutionStep>::const_iterator it = plan.steps.begin();
+      it != plan.steps.end();
+      ++it)
+  {
+    n_stages = std::max(n_stages, it->stage + 1);
+  }
+
+  std::vector<RTT::nsecs> stage_loads(n_stages, 0);
+  for(std::vector<ExecutionStep>::const_iterator it = plan.steps.begin();
+      it != plan.steps.end();
+      ++it)
+  {
+    stage_loads[it->stage] += it->load;
+  }
+
+  // Assign the heaviest stages first, each to the least-loaded participant
+  std::vector<unsigned int> stages(n_stages);
+  for(unsigned int i=0; i < n_stages; i++) {
+    stages[i] = i;
+  }
+  std::stable_sort(stages.begin(), stages.end(), StageLoadGreater(stage_loads));
+
+  std::vector<unsigned int> stage_participants(n_stages, 0);
+  std::vector<RTT::nsecs> participant_loads(n_participants, 0);
+
+  for(std::vector<unsigned int>::const_iterator it = stages.begin();
+      it != stages.end();
+      ++it)
+  {
+    const unsigned int participant =
+      std::min_element(participant_loads.begin(), participant_loads.end()) - participant_loads.begin();
+    stage_participants[*it] = participant;
+    participant_loads[participant] += stage_loads[*it];
+  }
+
+  // Build the list of steps for each participant in execution order
+  prepared_participant_steps_.assign(n_participants, std::vector<unsigned int>());
+  for(unsigned int i=0; i < plan.steps.size(); i++) {
+    prepared_participant_steps_[stage_participants[plan.steps[i].stage]].push_back(i);
+  }
+
+  prepared_stage_busy_time_.assign(n_stages, 0);
+  prepared_ = true;
+}
+
+void PipelineExecutor::configure(conman::ExecutionPlan &plan)
+{
+  plan_ = &plan;
+
+  // Only allocate here if the plan wasn't prepared
+  if(!prepared_) {
+    this->prepare(plan);
+  }
+
+  // The completion counter is compared against the cycle count, so they are
+  // restarted together
+  cycle_ = 0;
+  finished_ = 0;
+
+  participant_steps_.swap(prepared_participant_steps_);
+  stage_busy_time_.swap(prepared_stage_busy_time_);
+  std::fill(participant_busy_time_.begin(), participant_busy_time_.end(), 0);
+  prepared_ = false;
+
+  start_time_ = timer_.getNSecs();
+}
+
+bool PipelineExecutor::execute(const RTT::nsecs time)
+{
+  if(plan_ == NULL) {
+    return true;
+  }
+
+  // Hand off the data produced by each stage in the previous cycle
+  for(std::vector<PortRelay*>::iterator it = relays_.begin();
+      it != relays_.end();
+      ++it)
+  {
+    (*it)->copy();
+  }
+
+  time_ = time;
+  failed_ = 0;
+  cycle_++;
+  __sync_synchronize();
+
+  // Wake up the workers and execute this thread's stages
+  this->dispatch();
+  this->work(0);
+
+  // Wait for the other stages to finish
+  const unsigned int target = cycle_ * participant_steps_.size();
+  while(static_cast<int>(target - finished_) > 0) { }
+
+  __sync_synchronize();
+
+  return failed_ == 0;
+}
+
+bool PipelineExecutor::getUtilization(std::vector<double> &utilization) const
+{
+  const RTT::nsecs elapsed = timer_.getNSecs(start_time_);
+
+  utilization.resize(participant_busy_time_.size());
+
+  for(size_t i=0; i < participant_busy_time_.size(); i++) {
+    utilization[i] = (elapsed > 0) ? double(participant_busy_time_[i]) / double(elapsed) : 0.0;
+  }
+
+  return true;
+}
+
+void PipelineExecutor::getStageLoads(std::vector<double> &loads) const
+{
+  const RTT::nsecs elapsed = timer_.getNSecs(start_time_);
+
+  loads.resize(stage_busy_time_.size());
+
+  for(size_t i=0; i < stage_busy_time_.size(); i++) {
+    loads[i] = (elapsed > 0) ? double(stage_busy_time_[i]) / double(elapsed) : 0.0;
+  }
+}
+
+void PipelineExecutor::work(const unsigned int worker_id)
+{
+  const std::vector<unsigned int> &steps = participant_steps_[worker_id];
+  const RTT::nsecs start = timer_.getNSecs();
+  RTT::nsecs last = start;
+
+  for(std::vector<unsigned int>::const_iterator it = steps.begin();
+      it != steps.end();
+      ++it)
+  {
+    ExecutionStep &step = plan_->steps[*it];
+
+    // The hook passes back its own reading of when the block finished, if it
+    // took one
+    RTT::nsecs timestamp = last;
+    if(!step.execute(time_, plan_->cycle, timer_, timestamp)) {
+      failed_ = 1;
+    }
+
+    // Each stage is only executed by one participant
+    const RTT::nsecs now = (timestamp != 0) ? timestamp : timer_.getNSecs();
+    stage_busy_time_[step.stage] += now - last;
+    last = now;
+  }
+
+  participant_busy_time_[worker_id] += last - start;
+
+  __sync_fetch_and_add(&finished_, 1);
+}
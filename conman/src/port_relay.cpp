@@ -0,0 +1,178 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <list>
+
+#include <conman/port_relay.h>
+
+using namespace conman;
+
+PortRelay::PortRelay(
+    RTT::base::OutputPortInterface *source,
+    RTT::base::InputPortInterface *sink) :
+  source_(source),
+  sink_(sink),
+  relay_in_(NULL),
+  relay_out_(NULL)
+{
+}
+
+PortRelay::~PortRelay()
+{
+  this->disconnect();
+}
+
+bool PortRelay::connect()
+{
+  RTT::Logger::In in("PortRelay::connect");
+
+  if(this->isConnected()) {
+    return true;
+  }
+
+  // Find the policy of the original connection
+  bool found = false;
+  std::list<RTT::internal::ConnectionManager::ChannelDescriptor> channels = source_->getManager()->getChannels();
+  std::list<RTT::internal::ConnectionManager::ChannelDescriptor>::iterator channel_it;
+
+  for(channel_it = channels.begin(); channel_it != channels.end(); ++channel_it) {
+    if(channel_it->get<1>()->getOutputEndPoint()->getPort() == sink_) {
+      policy_ = channel_it->get<2>();
+      found = true;
+      break;
+    }
+  }
+
+  if(!found) {
+    RTT::log(RTT::Error) << "Could not relay \"" << source_->getName() <<
+      "\" to \"" << sink_->getName() << "\" because they aren't connected." <<
+      RTT::endlog();
+    return false;
+  }
+
+  // Create private ports of the same type
+  relay_in_ = dynamic_cast<RTT::base::InputPortInterface*>(source_->antiClone());
+  relay_out_ = dynamic_cast<RTT::base::OutputPortInterface*>(sink_->antiClone());
+  sample_ = source_->getTypeInfo()->buildValue();
+
+  if(relay_in_ == NULL || relay_out_ == NULL || !sample_) {
+    RTT::log(RTT::Error) << "Could not create relay ports for \"" <<
+      source_->getName() << "\"." << RTT::endlog();
+    delete relay_in_;
+    delete relay_out_;
+    relay_in_ = NULL;
+    relay_out_ = NULL;
+    return false;
+  }
+
+  // Splice the relay into the connection
+  source_->disconnect(sink_);
+
+  if(!source_->connectTo(relay_in_, policy_) || !relay_out_->connectTo(sink_, policy_)) {
+    RTT::log(RTT::Error) << "Could not connect relay ports for \"" <<
+      source_->getName() << "\"." << RTT::endlog();
+    this->disconnect();
+    return false;
+  }
+
+  return true;
+}
+
+void PortRelay::disconnect()
+{
+  if(relay_in_ == NULL && relay_out_ == NULL) {
+    return;
+  }
+
+  relay_in_->disconnect();
+  relay_out_->disconnect();
+
+  delete relay_in_;
+  delete relay_out_;
+  relay_in_ = NULL;
+  relay_out_ = NULL;
+
+  // Restore the original connection
+  if(!source_->connectTo(sink_, policy_)) {
+    RTT::log(RTT::Error) << "Could not restore the connection from \"" <<
+      source_->getName() << "\" to \"" << sink_->getName() << "\"." <<
+      RTT::endlog();
+  }
+}
+
+bool PortRelay::isConnected() const
+{
+  return relay_in_ != NULL;
+}
+
+unsigned int PortRelay::copy()
+{
+  if(relay_in_ == NULL) {
+    return 0;
+  }
+
+  // Buffered connections might have several new samples
+  unsigned int n_samples = 0;
+  while(relay_in_->read(sample_, false) == RTT::NewData) {
+    relay_out_->write(sample_);
+    n_samples++;
+  }
+
+  return n_samples;
+}
+
+unsigned int PortRelay::discard()
+{
+  if(relay_in_ == NULL) {
+    return 0;
+  }
+
+  unsigned int n_samples = 0;
+  while(relay_in_->read(sample_, false) == RTT::NewData) {
+    n_samples++;
+  }
+
+  return n_samples;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+OutputGate::~OutputGate()
+{
+  this->clear();
+}
+
+void OutputGate::clear()
+{
+  for(std::vector<PortRelay*>::iterator it = relays_.begin();
+      it != relays_.end();
+      ++it)
+  {
+    delete *it;
+  }
+
+  relays_.clear();
+  open_ = true;
+}
+
+bool OutputGate::addRelay(
+    RTT::base::OutputPortInterface *source,
+    RTT::base::InputPortInterface *sink)
+{
+  if(source == NULL || sink == NULL) {
+    return false;
+  }
+
+  PortRelay *relay = new PortRelay(source, sink);
+
+  if(!relay->connect()) {
+    delete relay;
+    return false;
+  }
+
+  relays_.push_back(relay);
+
+  return true;
+}
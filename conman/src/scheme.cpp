@@ -1,10 +1,21 @@
+#include <deque>
+
 #include <boost/bind.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/next_prior.hpp>
 
 #include <rtt/extras/SlaveActivity.hpp>
+#include <rtt/os/Thread.hpp>
+#include <rtt/os/threads.hpp>
 
 #include <conman/scheme.h>
 #include <conman/hook.h>
+#include <conman/hook_service.h>
+#include <conman/wavefront_executor.h>
+#include <conman/work_stealing_executor.h>
+#include <conman/pipeline_executor.h>
+#include <conman/feedback_arc_set.h>
 
 // function_property_map isn't available until version 1.51
 #include <boost/version.hpp>
@@ -24,11 +35,48 @@
 #include <boost/graph/tiernan_all_cycles.hpp>
 #endif
 
+#include <boost/graph/strong_components.hpp>
+#include <boost/property_map/property_map.hpp>
+
 
 using namespace conman;
 
+//! Ordering of execution steps by dependency level
+static bool StepLevelLess(const ExecutionStep &a, const ExecutionStep &b)
+{
+  return a.level < b.level;
+}
+
 Scheme::Scheme(std::string name)
- : RTT::TaskContext(name), scheme_name_("")
+ : RTT::TaskContext(name), scheme_name_(""),
+   last_switch_duration_(0),
+   max_switch_duration_(0),
+   switch_count_(0),
+   switch_pending_(false),
+   last_switch_time_(0),
+   topology_dirty_(false),
+   in_transaction_(false),
+   max_cycles_(10000),
+   plan_pending_(false),
+   max_hyperperiod_(1000),
+   balance_phases_(false),
+   audit_period_(1.0),
+   auditor_(NULL),
+   execution_mode_(ExecutionMode::SERIAL),
+   n_workers_(0),
+   worker_cpu_affinity_(~0),
+   executor_(NULL),
+   model_frozen_(false),
+   timer_source_(TimerSource::RTT),
+   instrumentation_(Instrumentation::FULL),
+   instrumentation_sample_period_(10),
+   sample_countdown_(1),
+   cycle_budget_(0),
+   overrun_policy_(OverrunPolicy::EVENT),
+   overrun_count_(0),
+   worst_overrun_(0),
+   n_deferred_steps_(0),
+   n_running_blocks_(0)
 {
   // Modifying blocks in the scheme
   this->addOperation("hasBlock", &Scheme::hasBlock, this, RTT::OwnThread)
@@ -39,6 +87,22 @@ Scheme::Scheme(std::string name)
     .doc("Add a conman block into this scheme.");
   this->addOperation("removeBlock", (bool (Scheme::*)(const std::string&))&Scheme::removeBlock, this, RTT::OwnThread)
     .doc("Remove a conman block from this scheme.");
+  this->addOperation("refreshModel", &Scheme::refreshModel, this, RTT::OwnThread)
+    .doc("Rescan the port connections of all blocks in this scheme.");
+  this->addOperation("markBlockDirty", &Scheme::markBlockDirty, this, RTT::OwnThread)
+    .doc("Rescan the port connections of a block and its neighbors the next time the model is regenerated.");
+  this->addOperation("addBlocks", &Scheme::addBlocks, this, RTT::OwnThread)
+    .doc("Add several conman blocks into this scheme, or none of them if the result can't be executed.");
+
+  // Transactions
+  this->addOperation("beginTransaction", &Scheme::beginTransaction, this, RTT::OwnThread)
+    .doc("Defer model regeneration until the transaction is committed.");
+  this->addOperation("commitTransaction", &Scheme::commitTransaction, this, RTT::OwnThread)
+    .doc("Regenerate the model once, or roll back all changes since beginTransaction if the scheme can't be executed.");
+  this->addOperation("abortTransaction", &Scheme::abortTransaction, this, RTT::OwnThread)
+    .doc("Roll back all changes since beginTransaction.");
+  this->addOperation("inTransaction", &Scheme::inTransaction, this, RTT::OwnThread)
+    .doc("Check if a transaction is open.");
 
   // Group management
   this->addOperation("hasGroup", &Scheme::hasGroup, this, RTT::OwnThread)
@@ -65,6 +129,12 @@ Scheme::Scheme(std::string name)
     .doc("Latch all the inputs to a given component.");
   this->addOperation("latchOutputs", (bool (Scheme::*)(const std::string&, const bool))&Scheme::latchOutputs, this, RTT::OwnThread)
     .doc("Latch all the outputs to a given component.");
+  this->addOperation("setLatchCost", &Scheme::setLatchCost, this, RTT::OwnThread)
+    .doc("Set the relative cost of latching the connections between two components.");
+  this->addOperation("computeFeedbackLatches", &Scheme::computeFeedbackLatches, this, RTT::OwnThread)
+    .doc("Compute the cheapest set of connections to latch to make the scheme executable.");
+  this->addOperation("latchFeedback", &Scheme::latchFeedback, this, RTT::OwnThread)
+    .doc("Latch the cheapest set of connections which makes the scheme executable.");
 
   // Add properties
   this->addProperty("scheme_name", scheme_name_).doc("Scheme Name");
@@ -72,6 +142,10 @@ Scheme::Scheme(std::string name)
   // Execution introspection
   this->addOperation("executable", &Scheme::executable, this, RTT::OwnThread)
     .doc("Returns true if the graph can be executed with the current latches.");
+  this->addOperation("getCyclicBlocks", &Scheme::getCyclicBlocks, this, RTT::OwnThread)
+    .doc("Get the blocks which are on cycles in the execution scheduling graph.");
+  this->addProperty("max_cycles",max_cycles_)
+    .doc("The maximum number of cycles to enumerate when analyzing latches (zero for unlimited).");
 
   // Block runtime management
   this->addOperation("enableBlock", (bool (Scheme::*)(const std::string&, const bool))&Scheme::enableBlock, this, RTT::OwnThread)
@@ -81,18 +155,129 @@ Scheme::Scheme(std::string name)
   this->addOperation("disableBlock", (bool (Scheme::*)(const std::string&))&Scheme::disableBlock, this, RTT::OwnThread)
     .doc("Disable a block in this scheme.")
     .arg("name","The block to disable.");
-  this->addOperation("switchBlocks", &Scheme::switchBlocks, this, RTT::OwnThread)
+  this->addOperation("standbyBlock", &Scheme::standbyBlock, this, RTT::OwnThread)
+    .doc("Start a block with its outputs held back, so that enabling it later only lets its outputs through.")
+    .arg("name","The block to put in standby.");
+  this->addOperation("inStandby", &Scheme::inStandby, this, RTT::OwnThread)
+    .doc("Check if a block is in standby.");
+  this->addOperation("switchBlocks", (bool (Scheme::*)(const std::vector<std::string>&, const std::vector<std::string>&, const bool, const bool))&Scheme::switchBlocks, this, RTT::OwnThread)
     .doc("Simultaneousy enable and disable a list of blocks, any block not in either list will remain in its current state.");
 
-  this->addOperation("setEnabledBlocks", &Scheme::setEnabledBlocks, this, RTT::OwnThread)
+  this->addOperation("setEnabledBlocks", (bool (Scheme::*)(const std::vector<std::string>&, const bool))&Scheme::setEnabledBlocks, this, RTT::OwnThread)
     .doc("Set the list of running blocks, any block not on the list will be disabled.");
 
+  // Modes
+  this->addOperation("defineMode", &Scheme::defineMode, this, RTT::OwnThread)
+    .doc("Define a named set of non-conflicting blocks and groups which can be switched to at once.")
+    .arg("name","The name of the mode.")
+    .arg("blocks","The blocks and groups which run in this mode.");
+  this->addOperation("removeMode", &Scheme::removeMode, this, RTT::OwnThread)
+    .doc("Remove a mode.");
+  this->addOperation("hasMode", &Scheme::hasMode, this, RTT::OwnThread)
+    .doc("Check if a mode has been defined.");
+  this->addOperation("getModes", &Scheme::getModes, this, RTT::OwnThread)
+    .doc("Get the names of all modes.");
+  this->addOperation("switchMode", (bool (Scheme::*)(const std::string&))&Scheme::switchMode, this, RTT::OwnThread)
+    .doc("Run only the blocks in a mode, disabling all other blocks.")
+    .arg("name","The mode to switch to.");
+  this->addProperty("last_switch_duration",last_switch_duration_)
+    .doc("The duration of the last mode switch, in nanoseconds.");
+  this->addProperty("max_switch_duration",max_switch_duration_)
+    .doc("The longest duration of any mode switch, in nanoseconds.");
+  this->addProperty("switch_count",switch_count_)
+    .doc("The number of mode switches.");
+  this->addOperation("requestMode", (bool (Scheme::*)(const std::string&))&Scheme::requestMode, this, RTT::OwnThread)
+    .doc("Switch to a mode at the start of the next cycle, before any blocks are executed.")
+    .arg("name","The mode to switch to.");
+  this->addProperty("last_switch_time",last_switch_time_)
+    .doc("The time of the cycle in which the last requested mode switch was applied, in nanoseconds.");
+  this->addPort("switch_time",switch_time_out_)
+    .doc("The time of the cycle in which a requested mode switch was applied in nanoseconds, written once the switch is complete.");
+
   this->addProperty("last_exec_period",last_exec_period_)
     .doc("The last period between two consecutive executions.");
   this->addProperty("min_exec_period",min_exec_period_)
     .doc("The minimum observed execution period between two consecutive executions.");
   this->addProperty("max_exec_period",max_exec_period_)
     .doc("The maximum observed execution period between two consecutive executions.");
+
+  // Parallel execution
+  this->addProperty("execution_mode",execution_mode_)
+    .doc("The execution mode used when the scheme is started (see the execution_mode service).");
+  this->addProperty("n_workers",n_workers_)
+    .doc("The number of worker threads used in addition to the scheme's own thread for parallel execution modes.");
+  this->addProperty("worker_cpu_affinity",worker_cpu_affinity_)
+    .doc("The CPU affinity mask for the parallel execution worker threads. Since the workers spin-wait, each one is pinned to a single CPU from this mask, in order.");
+
+  this->addProperty("max_hyperperiod",max_hyperperiod_)
+    .doc("The maximum number of scheme cycles in the precomputed multi-rate schedule.");
+  this->addProperty("balance_phases",balance_phases_)
+    .doc("If true, newly-enabled low-rate blocks are given phase offsets which minimize the peak estimated load per cycle. Otherwise, they are due on the cycle after they are enabled.");
+
+  this->addOperation("getBlockPhases", &Scheme::getBlockPhases, this, RTT::OwnThread)
+    .doc("Get the phase and rate divisor of each block in the execution plan, formatted as \"name phase/divisor\".");
+  this->addOperation("getSlotLoads", &Scheme::getSlotLoads, this, RTT::OwnThread)
+    .doc("Get the estimated execution duration of each cycle in the multi-rate schedule.");
+  this->addProperty("audit_period",audit_period_)
+    .doc("The period in seconds at which a running scheme checks whether its execution plan needs to be audited, or zero to only audit it on request. This takes effect when the scheme is started.");
+  this->addOperation("auditExecutionPlan", &Scheme::auditExecutionPlan, this, RTT::OwnThread)
+    .doc("Recompile the execution plan if any blocks have been started or stopped outside of the scheme, or if the scheme's period or any block's desired_min_exec_period has changed.");
+
+  // Cycle budget enforcement
+  this->addProperty("cycle_budget",cycle_budget_)
+    .doc("The maximum duration of each cycle in nanoseconds, or zero for no budget.");
+  this->addProperty("overrun_policy",overrun_policy_)
+    .doc("What to do with non-critical blocks once a cycle has exceeded its budget (see the overrun_policy service). The parallel execution modes only support EVENT: the scheme can't be started in them with any other policy, and a policy which is set while running is ignored.");
+  this->addProperty("overrun_count",overrun_count_)
+    .doc("The number of cycles which have exceeded the cycle budget.");
+  this->addProperty("worst_overrun",worst_overrun_)
+    .doc("The longest amount of time by which a cycle has exceeded the cycle budget, in nanoseconds.");
+  this->addPort("overrun",overrun_out_)
+    .doc("The amount of time by which a cycle has exceeded the cycle budget in nanoseconds, written at the end of each such cycle.");
+
+  // Duration measurement
+  this->addProperty("timer_source",timer_source_)
+    .doc("The clock used to measure block and cycle durations, applied when the scheme is started (see the timer_source service).");
+
+  this->provides("timer_source")->addConstant("RTT",TimerSource::RTT);
+  this->provides("timer_source")->addConstant("MONOTONIC_RAW",TimerSource::MONOTONIC_RAW);
+  this->provides("timer_source")->addConstant("TSC",TimerSource::TSC);
+
+  this->addProperty("instrumentation",instrumentation_)
+    .doc("How often the scheme's cycle statistics are computed (see the instrumentation service).");
+  this->addProperty("instrumentation_sample_period",instrumentation_sample_period_)
+    .doc("The number of cycles per statistics sample when the instrumentation is SAMPLED.");
+  this->addOperation("setInstrumentation", &Scheme::setInstrumentation, this, RTT::OwnThread)
+    .doc("Set the instrumentation level of the scheme and all of its blocks.")
+    .arg("level","The instrumentation level (see the instrumentation service).")
+    .arg("sample_period","The number of executions per statistics sample when the level is SAMPLED.");
+
+  this->provides("instrumentation")->addConstant("OFF",Instrumentation::OFF);
+  this->provides("instrumentation")->addConstant("SAMPLED",Instrumentation::SAMPLED);
+  this->provides("instrumentation")->addConstant("FULL",Instrumentation::FULL);
+
+  this->provides("overrun_policy")->addConstant("EVENT",OverrunPolicy::EVENT);
+  this->provides("overrun_policy")->addConstant("SKIP",OverrunPolicy::SKIP);
+  this->provides("overrun_policy")->addConstant("DEFER",OverrunPolicy::DEFER);
+
+  this->provides("execution_mode")->addConstant("SERIAL",ExecutionMode::SERIAL);
+  this->provides("execution_mode")->addConstant("WAVEFRONT",ExecutionMode::WAVEFRONT);
+  this->provides("execution_mode")->addConstant("WORK_STEALING",ExecutionMode::WORK_STEALING);
+  this->provides("execution_mode")->addConstant("PIPELINE",ExecutionMode::PIPELINE);
+
+  this->addOperation("getStageLoads", &Scheme::getStageLoads, this, RTT::OwnThread)
+    .doc("Get the fraction of time spent executing each pipeline stage since the execution plan was last compiled.");
+  this->addOperation("getStageLatencies", &Scheme::getStageLatencies, this, RTT::OwnThread)
+    .doc("Get the number of cycles of latency which pipelining adds to the inputs of each pipeline stage.");
+
+  this->addOperation("getWorkerUtilization", &Scheme::getWorkerUtilization, this, RTT::OwnThread)
+    .doc("Get the fraction of time each execution thread has spent executing blocks since the execution plan was last compiled. The first element is the scheme's own thread.");
+}
+
+Scheme::~Scheme()
+{
+  this->stopAuditor();
+  this->stopExecutor();
 }
 
 
@@ -184,6 +369,13 @@ bool Scheme::addBlock(RTT::TaskContext *new_block)
     return false;
   }
 
+  // Make sure the hook service can be called directly
+  if(!conman::HookService::GetHookService(new_block)) {
+    RTT::log(RTT::Error) << "Requested block to add has a \"conman_hook\""
+      " service which is not a conman::HookService." << RTT::endlog();
+    return false;
+  }
+
   // Try to add this block as a peer if it isn't already a peer
   if(!(this->getPeer(new_block->getName()) == new_block)
      && !this->connectPeers(new_block))
@@ -202,11 +394,14 @@ bool Scheme::addBlock(RTT::TaskContext *new_block)
   new_vertex->latched_output = false;
   new_vertex->block = new_block;
   new_vertex->hook = conman::Hook::GetHook(new_block);
+  new_vertex->hook_service = conman::HookService::GetHookService(new_block);
 
   // Add this block to the set of blocks
   blocks_[block_name] = new_vertex;
   // Add this block to the block index (used for re-indexing)
   block_indices_.push_back(new_vertex);
+  this->resizeBlockSets();
+  this->cacheGroupMembers();
 
   // Model the block in the DFG and ESG structures
   if(!addBlockToGraph(new_vertex)) {
@@ -224,7 +419,11 @@ bool Scheme::addBlock(RTT::TaskContext *new_block)
   }
 
   // Compute conflicts for this block and represent them in the RCG
-  this->computeConflicts(new_vertex);
+  if(in_transaction_) {
+    deferred_conflicts_.push_back(new_block);
+  } else {
+    this->computeConflicts(new_vertex);
+  }
 
   // Set the block's activity to be a slave to the scheme's
   new_block->setActivity(
@@ -232,8 +431,12 @@ bool Scheme::addBlock(RTT::TaskContext *new_block)
           this->getActivity(),
           new_block->engine()));
 
+  this->recordUndo(UndoEntry::ADD_BLOCK, new_block);
+
   // Print out the ordering
-  this->printExecutionOrdering();
+  if(!in_transaction_) {
+    this->printExecutionOrdering();
+  }
 
   return true;
 }
@@ -322,6 +525,37 @@ bool Scheme::removeBlock(
 
   // Check if the block is in the scheme
   if(flow_vertex_map_.find(block) != flow_vertex_map_.end()) {
+    // Remember the latches on the block's edges so they can be restored
+    if(in_transaction_) {
+      const DataFlowVertexDescriptor flow_vertex = flow_vertex_map_[block];
+
+      DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+      for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(flow_vertex, flow_graph_);
+          out_edge_it != out_edge_end;
+          ++out_edge_it)
+      {
+        this->recordUndo(
+            UndoEntry::LATCH_CONNECTIONS,
+            block,
+            flow_graph_[boost::target(*out_edge_it, flow_graph_)]->block,
+            flow_graph_[*out_edge_it]->latched);
+      }
+
+      DataFlowInEdgeIterator in_edge_it, in_edge_end;
+      for(boost::tie(in_edge_it, in_edge_end) = boost::in_edges(flow_vertex, flow_graph_);
+          in_edge_it != in_edge_end;
+          ++in_edge_it)
+      {
+        this->recordUndo(
+            UndoEntry::LATCH_CONNECTIONS,
+            flow_graph_[boost::source(*in_edge_it, flow_graph_)]->block,
+            block,
+            flow_graph_[*in_edge_it]->latched);
+      }
+
+      this->recordUndo(UndoEntry::REMOVE_BLOCK, block);
+    }
+
     // Get the vertex properties pointer
     DataFlowVertex::Ptr vertex = flow_graph_[flow_vertex_map_[block]];
     // Remove the vertex from the graph
@@ -338,27 +572,236 @@ bool Scheme::removeBlock(
   // Remove the block from the block map
   blocks_.erase(block->getName());
 
-  // Re-index the vertices
-  unsigned int i=0;
-  std::list<DataFlowVertex::Ptr>::iterator it = block_indices_.begin();
-  for(; it != block_indices_.end(); )
-  {
-    // Remove the block when we get to it
-    if((*it)->block == block) {
-      it = block_indices_.erase(it);
-    } else {
-      // Update index of the blocks we don't remove
-      (*it)->index = i;
-      // Increment the iterator
-      ++it;
-      // Increment the index
-      ++i;
+  // Re-index the vertices after the removed block
+  for(unsigned int i=0; i < block_indices_.size(); i++) {
+    if(block_indices_[i]->block == block) {
+      block_indices_.erase(block_indices_.begin() + i);
+
+      for(; i < block_indices_.size(); i++) {
+        block_indices_[i]->index = i;
+      }
+      break;
     }
   }
 
+  // The handles of the blocks after the removed block have changed
+  this->rebuildBlockSets();
+  this->cacheGroupMembers();
+
+  return true;
+}
+
+bool Scheme::addBlocks(const std::vector<std::string> &block_names)
+{
+  RTT::Logger::In in("Scheme::addBlocks");
+
+  // Join the caller's transaction if there is one
+  const bool own_transaction = !in_transaction_;
+  if(own_transaction && !this->beginTransaction()) {
+    return false;
+  }
+
+  bool success = true;
+  for(std::vector<std::string>::const_iterator it = block_names.begin();
+      it != block_names.end() && success;
+      ++it)
+  {
+    success &= this->addBlock(*it);
+  }
+
+  if(!own_transaction) {
+    return success;
+  } else if(!success) {
+    this->abortTransaction();
+    return false;
+  }
+
+  return this->commitTransaction();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Scheme::beginTransaction()
+{
+  RTT::Logger::In in("Scheme::beginTransaction");
+
+  // Transactions posible only when scheme is stoped
+  if(this->getTaskState() != Stopped) {
+    RTT::log(RTT::Error) << "Scheme is in running state. Transactions forbidden." << RTT::endlog();
+    return false;
+  }
+
+  if(in_transaction_) {
+    RTT::log(RTT::Error) << "A transaction is already open." << RTT::endlog();
+    return false;
+  }
+
+  this->openTransaction();
+
+  return true;
+}
+
+void Scheme::openTransaction()
+{
+  in_transaction_ = true;
+  undo_log_.clear();
+  deferred_conflicts_.clear();
+}
+
+bool Scheme::commitTransaction()
+{
+  RTT::Logger::In in("Scheme::commitTransaction");
+
+  if(!in_transaction_) {
+    RTT::log(RTT::Error) << "No transaction is open." << RTT::endlog();
+    return false;
+  }
+
+  return this->endTransaction(true);
+}
+
+bool Scheme::abortTransaction()
+{
+  RTT::Logger::In in("Scheme::abortTransaction");
+
+  if(!in_transaction_) {
+    RTT::log(RTT::Error) << "No transaction is open." << RTT::endlog();
+    return false;
+  }
+
+  this->rollbackTransaction();
+  this->endTransaction(false);
+
   return true;
 }
 
+bool Scheme::inTransaction() const
+{
+  return in_transaction_;
+}
+
+void Scheme::recordUndo(
+    const UndoEntry::Type type,
+    RTT::TaskContext *block,
+    RTT::TaskContext *sink,
+    const bool latched)
+{
+  if(!in_transaction_) {
+    return;
+  }
+
+  UndoEntry entry;
+  entry.type = type;
+  entry.block = block;
+  entry.sink = sink;
+  entry.latched = latched;
+  entry.latched_input = false;
+  entry.latched_output = false;
+
+  // Removed blocks also need their block-level latch flags restored
+  if(type == UndoEntry::REMOVE_BLOCK) {
+    boost::unordered_map<std::string, conman::graph::DataFlowVertex::Ptr>::const_iterator block_it =
+      blocks_.find(block->getName());
+    if(block_it != blocks_.end()) {
+      entry.latched_input = block_it->second->latched_input;
+      entry.latched_output = block_it->second->latched_output;
+    }
+  }
+
+  undo_log_.push_back(entry);
+}
+
+bool Scheme::endTransaction(const bool atomic)
+{
+  RTT::Logger::In in("Scheme::endTransaction");
+
+  // Regenerate the ordering and the execution plan once
+  in_transaction_ = false;
+  const bool success = this->regenerateModel();
+
+  if(!success && atomic) {
+    RTT::log(RTT::Warning) << "Scheme can't be executed after the transaction,"
+      " rolling back " << undo_log_.size() << " changes." << RTT::endlog();
+
+    in_transaction_ = true;
+    this->rollbackTransaction();
+    in_transaction_ = false;
+
+    if(!this->regenerateModel()) {
+      RTT::log(RTT::Warning) << "Scheme still can't be executed after rolling"
+        " back the transaction." << RTT::endlog();
+    }
+  }
+
+  // Compute the conflicts for the added blocks which are still in the scheme
+  for(std::vector<RTT::TaskContext*>::const_iterator it = deferred_conflicts_.begin();
+      it != deferred_conflicts_.end();
+      ++it)
+  {
+    if(flow_vertex_map_.find(*it) != flow_vertex_map_.end()) {
+      this->computeConflicts(flow_graph_[flow_vertex_map_[*it]]);
+    }
+  }
+
+  deferred_conflicts_.clear();
+  undo_log_.clear();
+
+  // Print out the ordering
+  this->printExecutionOrdering();
+
+  return success;
+}
+
+void Scheme::rollbackTransaction()
+{
+  using namespace conman::graph;
+
+  // Undoing mutations records more mutations, which are discarded
+  std::vector<UndoEntry> log;
+  log.swap(undo_log_);
+
+  for(std::vector<UndoEntry>::const_reverse_iterator it = log.rbegin();
+      it != log.rend();
+      ++it)
+  {
+    boost::unordered_map<std::string, DataFlowVertex::Ptr>::iterator block_it;
+
+    switch(it->type) {
+      case UndoEntry::ADD_BLOCK:
+        this->removeBlock(it->block);
+        break;
+      case UndoEntry::REMOVE_BLOCK:
+        if(this->addBlock(it->block)) {
+          blocks_[it->block->getName()]->latched_input = it->latched_input;
+          blocks_[it->block->getName()]->latched_output = it->latched_output;
+        }
+        break;
+      case UndoEntry::LATCH_CONNECTIONS:
+        if(flow_vertex_map_.find(it->block) != flow_vertex_map_.end()
+           && flow_vertex_map_.find(it->sink) != flow_vertex_map_.end())
+        {
+          this->latchConnections(it->block, it->sink, it->latched, false);
+        }
+        break;
+      case UndoEntry::LATCH_INPUTS:
+        block_it = blocks_.find(it->block->getName());
+        if(block_it != blocks_.end()) {
+          block_it->second->latched_input = it->latched;
+        }
+        break;
+      case UndoEntry::LATCH_OUTPUTS:
+        block_it = blocks_.find(it->block->getName());
+        if(block_it != blocks_.end()) {
+          block_it->second->latched_output = it->latched;
+        }
+        break;
+    };
+  }
+
+  undo_log_.clear();
+  topology_dirty_ = true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool Scheme::hasGroup(const std::string &group_name) const
@@ -398,6 +841,9 @@ bool Scheme::addGroup(const std::string &group_name)
   // Create an empty group
   boost::unordered_set<std::string> no_members;
   block_groups_[group_name] = no_members;
+  group_names_.push_back(group_name);
+
+  this->cacheGroupMembers();
 
   return true;
 }
@@ -444,6 +890,8 @@ bool Scheme::setGroupMembers(
   // Set the group membership
   block_groups_[group_name] = boost::unordered_set<std::string>(members.begin(),members.end());
 
+  this->cacheGroupMembers();
+
   return true;
 }
 
@@ -476,6 +924,8 @@ bool Scheme::addToGroup(
   // Add the new name to the group
   group->second.insert(new_name);
 
+  this->cacheGroupMembers();
+
   return true;
 }
 
@@ -500,6 +950,8 @@ bool Scheme::removeFromGroup(
   // Remove the block from the group
   group->second.erase(block);
 
+  this->cacheGroupMembers();
+
   return true;
 }
 
@@ -513,6 +965,8 @@ bool Scheme::emptyGroup( const std::string &group_name)
   // Remove the elments from the group
   block_groups_[group_name].clear();
 
+  this->cacheGroupMembers();
+
   return true;
 }
 
@@ -522,14 +976,17 @@ bool Scheme::removeGroup( const std::string &group_name)
   if(this->hasGroup(group_name)) {
     // Remove this group
     block_groups_.erase(group_name);
+    group_names_.erase(std::find(group_names_.begin(), group_names_.end(), group_name));
 
     // Remove references to this group from all other groups
     for(conman::GroupMap::iterator it = block_groups_.begin();
         it != block_groups_.end();
         ++it)
     {
-      this->removeFromGroup(it->first, group_name);
+      it->second.erase(group_name);
     }
+
+    this->cacheGroupMembers();
   }
 
   return true;
@@ -552,14 +1009,58 @@ bool Scheme::getGroupMembers(
     std::vector<std::string> &members)
   const
 {
-  // Expand the group recursively
-  boost::unordered_set<std::string> member_set, visited;
-  bool success = getGroupMembers(group_name, member_set, visited);
+  members.clear();
+
+  // Check if the group is a single block
+  if(this->hasBlock(group_name)) {
+    members.push_back(group_name);
+    return true;
+  }
 
-  // Copy the set to vector
-  members.assign(member_set.begin(), member_set.end());
+  boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+    group_handles_.find(group_name);
 
-  return success;
+  if(group == group_handles_.end()) {
+    return false;
+  }
+
+  // Copy the cached members in block order
+  const conman::BlockSet &member_set = group_members_[group->second];
+  for(conman::BlockSet::size_type i = member_set.find_first();
+      i != conman::BlockSet::npos;
+      i = member_set.find_next(i))
+  {
+    members.push_back(block_indices_[i]->block->getName());
+  }
+
+  return group_complete_[group->second];
+}
+
+void Scheme::cacheGroupMembers()
+{
+  group_handles_.clear();
+  group_members_.assign(group_names_.size(), conman::BlockSet(block_indices_.size()));
+  group_complete_.assign(group_names_.size(), true);
+
+  for(conman::GroupHandle handle = 0; handle < group_names_.size(); handle++) {
+    group_handles_[group_names_[handle]] = handle;
+  }
+
+  for(conman::GroupHandle handle = 0; handle < group_names_.size(); handle++) {
+    // Expand the group recursively
+    boost::unordered_set<std::string> member_set, visited;
+    group_complete_[handle] = this->getGroupMembers(group_names_[handle], member_set, visited);
+
+    for(boost::unordered_set<std::string>::const_iterator it = member_set.begin();
+        it != member_set.end();
+        ++it)
+    {
+      group_members_[handle].set(this->getBlockVertex(*it)->index);
+    }
+  }
+
+  // Modes refer to blocks and groups by name
+  this->compileModes();
 }
 
 bool Scheme::getGroupMembers(
@@ -605,6 +1106,177 @@ bool Scheme::getGroupMembers(
 
 ///////////////////////////////////////////////////////////////////////////////
 
+bool Scheme::getBlockHandle(
+    const std::string &block_name,
+    conman::BlockHandle &handle)
+  const
+{
+  boost::unordered_map<std::string, graph::DataFlowVertex::Ptr>::const_iterator block =
+    blocks_.find(block_name);
+
+  if(block == blocks_.end()) {
+    RTT::log(RTT::Error) << "Block named \"" << block_name << "\" is not in"
+      " the scheme." << RTT::endlog();
+    return false;
+  }
+
+  handle = block->second->index;
+
+  return true;
+}
+
+bool Scheme::getBlockHandles(
+    const std::vector<std::string> &block_names,
+    std::vector<conman::BlockHandle> &handles)
+  const
+{
+  conman::BlockSet listed(block_indices_.size());
+
+  handles.clear();
+
+  for(std::vector<std::string>::const_iterator it = block_names.begin();
+      it != block_names.end();
+      ++it)
+  {
+    boost::unordered_map<std::string, graph::DataFlowVertex::Ptr>::const_iterator block =
+      blocks_.find(*it);
+
+    if(block != blocks_.end()) {
+      if(!listed[block->second->index]) {
+        listed.set(block->second->index);
+        handles.push_back(block->second->index);
+      }
+      continue;
+    }
+
+    boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+      group_handles_.find(*it);
+
+    if(group == group_handles_.end()) {
+      RTT::log(RTT::Error) << "Block or group named \"" << *it << "\" is not"
+        " in the scheme." << RTT::endlog();
+      return false;
+    }
+
+    // Add the members of the group
+    const conman::BlockSet &members = group_members_[group->second];
+    for(conman::BlockSet::size_type i = members.find_first();
+        i != conman::BlockSet::npos;
+        i = members.find_next(i))
+    {
+      if(!listed[i]) {
+        listed.set(i);
+        handles.push_back(i);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool Scheme::getBlockName(
+    const conman::BlockHandle handle,
+    std::string &block_name)
+  const
+{
+  if(handle >= block_indices_.size()) {
+    return false;
+  }
+
+  block_name = block_indices_[handle]->block->getName();
+
+  return true;
+}
+
+bool Scheme::getGroupHandle(
+    const std::string &group_name,
+    conman::GroupHandle &handle)
+  const
+{
+  boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+    group_handles_.find(group_name);
+
+  if(group == group_handles_.end()) {
+    RTT::log(RTT::Error) << "Group named \"" << group_name << "\" is not in"
+      " the scheme." << RTT::endlog();
+    return false;
+  }
+
+  handle = group->second;
+
+  return true;
+}
+
+bool Scheme::getGroupMembers(
+    const conman::GroupHandle handle,
+    std::vector<conman::BlockHandle> &members)
+  const
+{
+  if(handle >= group_members_.size()) {
+    RTT::log(RTT::Error) << "Group handle " << handle << " is not in the"
+      " scheme." << RTT::endlog();
+    return false;
+  }
+
+  const conman::BlockSet &member_set = group_members_[handle];
+
+  members.clear();
+  for(conman::BlockSet::size_type i = member_set.find_first();
+      i != conman::BlockSet::npos;
+      i = member_set.find_next(i))
+  {
+    members.push_back(i);
+  }
+
+  return group_complete_[handle];
+}
+
+bool Scheme::getGroupMembers(
+    const conman::GroupHandle handle,
+    conman::BlockSet &members)
+  const
+{
+  if(handle >= group_members_.size()) {
+    RTT::log(RTT::Error) << "Group handle " << handle << " is not in the"
+      " scheme." << RTT::endlog();
+    return false;
+  }
+
+  members = group_members_[handle];
+
+  return group_complete_[handle];
+}
+
+bool Scheme::validHandles(
+    const std::vector<conman::BlockHandle> &handles)
+  const
+{
+  for(std::vector<conman::BlockHandle>::const_iterator it = handles.begin();
+      it != handles.end();
+      ++it)
+  {
+    if(*it >= block_indices_.size()) {
+      RTT::log(RTT::Error) << "Block handle " << *it << " is not in the"
+        " scheme." << RTT::endlog();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void Scheme::markHandles(const std::vector<conman::BlockHandle> &handles)
+{
+  for(std::vector<conman::BlockHandle>::const_iterator it = handles.begin();
+      it != handles.end();
+      ++it)
+  {
+    marked_blocks_.set(*it);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 bool Scheme::latchConnections(
     const std::string &source_name,
     const std::string &sink_name,
@@ -635,6 +1307,14 @@ bool Scheme::latchConnections(
     return false;
   }
 
+  // Batch the latches so that the model is only regenerated once (a single
+  // pair doesn't need a transaction)
+  const bool own_transaction =
+    !in_transaction_ && source_names.size() * sink_names.size() > 1;
+  if(own_transaction) {
+    this->openTransaction();
+  }
+
   // Latch connections between all sources and sinks
   bool success = true;
   for(std::vector<std::string>::const_iterator source_it = source_names.begin();
@@ -651,6 +1331,61 @@ bool Scheme::latchConnections(
     }
   }
 
+  if(own_transaction) {
+    this->endTransaction(false);
+  }
+
+  return success;
+}
+
+bool Scheme::latchConnections(
+    const std::vector<conman::BlockHandle> &sources,
+    const std::vector<conman::BlockHandle> &sinks,
+    const bool latch)
+{
+  // Latching blocks posible only when scheme is stoped
+  if(this->getTaskState() != Stopped) {
+    RTT::log(RTT::Error) << "Scheme is in running state. Latching blocks forbidden." << RTT::endlog();
+    return false;
+  }
+
+  if(!this->validHandles(sources) || !this->validHandles(sinks)) {
+    return false;
+  }
+
+  // Batch the latches so that the model is only regenerated once (a single
+  // pair doesn't need a transaction)
+  const bool own_transaction =
+    !in_transaction_ && sources.size() * sinks.size() > 1;
+  if(own_transaction) {
+    this->openTransaction();
+  }
+
+  // Latch connections between all sources and sinks
+  bool success = true;
+  for(std::vector<conman::BlockHandle>::const_iterator source_it = sources.begin();
+      source_it != sources.end();
+      ++source_it)
+  {
+    for(std::vector<conman::BlockHandle>::const_iterator sink_it = sinks.begin();
+        sink_it != sinks.end();
+        ++sink_it)
+    {
+      // Self-loops are implicitly latched
+      if(*source_it != *sink_it) {
+        success &= this->latchConnections(
+            block_indices_[*source_it]->block,
+            block_indices_[*sink_it]->block,
+            latch,
+            false);
+      }
+    }
+  }
+
+  if(own_transaction) {
+    this->endTransaction(false);
+  }
+
   return success;
 }
 
@@ -667,6 +1402,12 @@ bool Scheme::latchConnections(
     return false;
   }
 
+  // The ESG is frozen while the scheme is running
+  if(model_frozen_) {
+    RTT::log(RTT::Error) << "Scheme is in running state. Latching blocks forbidden." << RTT::endlog();
+    return false;
+  }
+
   RTT::log(RTT::Debug) << "Latching connections between \"" << source->getName()
     << "\" and \"" << sink->getName() << "\"" << RTT::endlog();
 
@@ -680,6 +1421,9 @@ bool Scheme::latchConnections(
 
   // Latch the edge
   if(edge_found) {
+    const bool previous = flow_graph_[edge]->latched;
+    this->recordUndo(UndoEntry::LATCH_CONNECTIONS, source, sink, previous);
+
     // Set the latch flag
     flow_graph_[edge]->latched = latch;
 
@@ -689,19 +1433,32 @@ bool Scheme::latchConnections(
           exec_vertex_map_[source],
           exec_vertex_map_[sink],
           exec_graph_);
-    } else {
+    } else if(previous) {
       boost::add_edge(
           exec_vertex_map_[source],
           exec_vertex_map_[sink],
           flow_graph_[edge],
           exec_graph_);
+      // Report new cycles as soon as they're created
+      if(exec_topology_.valid() && !exec_topology_.addEdge(
+          exec_graph_,
+          exec_vertex_map_[source],
+          exec_vertex_map_[sink]))
+      {
+        RTT::log(RTT::Warning) << "Unlatching connections between \"" <<
+          source->getName() << "\" and \"" << sink->getName() << "\""
+          " creates a cycle." << RTT::endlog();
+      }
     }
 
     // Regenerate the graphs
+    topology_dirty_ = true;
     this->regenerateModel();
 
     // Print out the ordering
-    this->printExecutionOrdering();
+    if(!in_transaction_) {
+      this->printExecutionOrdering();
+    }
   } else if(strict) {
     // Only error if strict
     RTT::log(RTT::Error) << "Tried to " <<
@@ -728,6 +1485,7 @@ bool Scheme::latchInputs(const std::string &sink_name, const bool latch)
       it != sinks.end();
       ++it)
   {
+    this->recordUndo(UndoEntry::LATCH_INPUTS, blocks_[*it]->block, NULL, blocks_[*it]->latched_input);
     blocks_[*it]->latched_input = latch;
   }
 
@@ -753,6 +1511,7 @@ bool Scheme::latchOutputs(const std::string &source_name, const bool latch)
       it != sources.end();
       ++it)
   {
+    this->recordUndo(UndoEntry::LATCH_OUTPUTS, blocks_[*it]->block, NULL, blocks_[*it]->latched_output);
     blocks_[*it]->latched_output = latch;
   }
 
@@ -764,6 +1523,156 @@ bool Scheme::latchOutputs(RTT::TaskContext *source, const bool latch)
   return source && this->latchOutputs(source->getName(), latch);
 }
 
+bool Scheme::setLatchCost(
+    const std::string &source_name,
+    const std::string &sink_name,
+    const double cost)
+{
+  using namespace conman::graph;
+
+  RTT::Logger::In in("Scheme::setLatchCost");
+
+  if(cost < 0.0) {
+    RTT::log(RTT::Error) << "Latch costs must be non-negative." << RTT::endlog();
+    return false;
+  }
+
+  boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator
+    source = blocks_.find(source_name),
+    sink = blocks_.find(sink_name);
+
+  if(source == blocks_.end() || sink == blocks_.end()) {
+    RTT::log(RTT::Error) << "Could not set latch cost because the blocks"
+      " aren't in the scheme." << RTT::endlog();
+    return false;
+  }
+
+  // Get the edge between these blocks
+  DataFlowEdgeDescriptor edge;
+  bool edge_found;
+  boost::tie(edge, edge_found) = boost::edge(
+      flow_vertex_map_.find(source->second->block)->second,
+      flow_vertex_map_.find(sink->second->block)->second,
+      flow_graph_);
+
+  if(!edge_found) {
+    RTT::log(RTT::Error) << "Could not set latch cost because \"" <<
+      source_name << "\" isn't connected to \"" << sink_name << "\"." <<
+      RTT::endlog();
+    return false;
+  }
+
+  flow_graph_[edge]->latch_cost = cost;
+
+  return true;
+}
+
+bool Scheme::computeFeedbackLatches(
+    std::vector<std::string> &source_names,
+    std::vector<std::string> &sink_names)
+  const
+{
+  using namespace conman::graph;
+
+  source_names.clear();
+  sink_names.clear();
+
+  // Cycles can be broken independently in each strongly connected component
+  std::vector<DataFlowPath> components;
+  this->computeCyclicComponents(exec_graph_, components);
+
+  for(std::vector<DataFlowPath>::const_iterator component = components.begin();
+      component != components.end();
+      ++component)
+  {
+    // Index the vertices in this component
+    const std::vector<DataFlowVertexDescriptor> vertices(component->begin(), component->end());
+    boost::unordered_map<DataFlowVertexDescriptor, unsigned int> local_index;
+
+    for(unsigned int i=0; i < vertices.size(); i++) {
+      local_index[vertices[i]] = i;
+    }
+
+    // Collect the ESG arcs within the component
+    std::vector<WeightedArc> arcs;
+    std::vector<DataFlowEdgeDescriptor> arc_edges;
+
+    for(unsigned int i=0; i < vertices.size(); i++) {
+      DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+      for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(vertices[i], exec_graph_);
+          out_edge_it != out_edge_end;
+          ++out_edge_it)
+      {
+        boost::unordered_map<DataFlowVertexDescriptor, unsigned int>::const_iterator target =
+          local_index.find(boost::target(*out_edge_it, exec_graph_));
+
+        if(target != local_index.end()) {
+          arcs.push_back(WeightedArc(i, target->second, exec_graph_[*out_edge_it]->latch_cost));
+          arc_edges.push_back(*out_edge_it);
+        }
+      }
+    }
+
+    // Find the cheapest arcs to latch
+    std::vector<size_t> feedback_arcs;
+    const double cost = FeedbackArcSet(vertices.size(), arcs, feedback_arcs);
+
+    RTT::log(RTT::Debug) << "Breaking the cycles between " << vertices.size()
+      << " blocks requires " << feedback_arcs.size() << " latches with a"
+      " total cost of " << cost << "." << RTT::endlog();
+
+    for(std::vector<size_t>::const_iterator it = feedback_arcs.begin();
+        it != feedback_arcs.end();
+        ++it)
+    {
+      source_names.push_back(exec_graph_[boost::source(arc_edges[*it], exec_graph_)]->block->getName());
+      sink_names.push_back(exec_graph_[boost::target(arc_edges[*it], exec_graph_)]->block->getName());
+    }
+  }
+
+  return true;
+}
+
+bool Scheme::latchFeedback()
+{
+  RTT::Logger::In in("Scheme::latchFeedback");
+
+  // Latching blocks posible only when scheme is stoped
+  if(this->getTaskState() != Stopped) {
+    RTT::log(RTT::Error) << "Scheme is in running state. Latching blocks forbidden." << RTT::endlog();
+    return false;
+  }
+
+  std::vector<std::string> source_names, sink_names;
+  this->computeFeedbackLatches(source_names, sink_names);
+
+  if(source_names.empty()) {
+    return this->executable();
+  }
+
+  // Apply all of the latches with a single regeneration
+  const bool own_transaction = !in_transaction_;
+  if(own_transaction) {
+    this->openTransaction();
+  }
+
+  for(size_t i=0; i < source_names.size(); i++) {
+    RTT::log(RTT::Info) << "Latching connections from \"" << source_names[i]
+      << "\" to \"" << sink_names[i] << "\"" << RTT::endlog();
+
+    this->latchConnections(
+        blocks_[source_names[i]]->block,
+        blocks_[sink_names[i]]->block,
+        true);
+  }
+
+  if(own_transaction) {
+    return this->commitTransaction();
+  }
+
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 int Scheme::latchCount(
@@ -777,38 +1686,37 @@ int Scheme::latchCount(
     return 0;
   }
 
-  int latch_count = 0;
+  // Look up each block once
+  DataFlowPath vertices;
+  for(std::vector<std::string>::const_iterator name = path.begin();
+      name != path.end();
+      ++name)
+  {
+    boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator block =
+      blocks_.find(*name);
 
-  // Iterate over pairs of vertices
-  std::vector<std::string>::const_iterator
-    source_name = path.begin(),
-    sink_name = ++path.begin();
-  for( ;source_name != path.end() && sink_name != path.end();
-       ++source_name, ++sink_name)
-  {
-    // Get the blocks corresponding to the names
-    boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator
-      source,
-      sink;
-
-    source = blocks_.find(*source_name);
-    sink = blocks_.find(*sink_name);
-
-    // Make sure the blocks are valid
-    if(source == blocks_.end() || sink == blocks_.end()) {
+    // Make sure the block is valid
+    if(block == blocks_.end()) {
       RTT::log(RTT::Error) << "Could not compute latch count because path"
         " elements aren't in the graph." << RTT::endlog();
       return 0;
     }
 
-    // Get the vertex descriptors for these blocks
-    DataFlowVertexDescriptor u = flow_vertex_map_.find(source->second->block)->second;
-    DataFlowVertexDescriptor v = flow_vertex_map_.find(sink->second->block)->second;
+    vertices.push_back(flow_vertex_map_.find(block->second->block)->second);
+  }
+
+  int latch_count = 0;
 
+  // Iterate over pairs of vertices
+  DataFlowPath::const_iterator
+    source = vertices.begin(),
+    sink = ++vertices.begin();
+  for( ;sink != vertices.end(); ++source, ++sink)
+  {
     // Get the edge between these blocks
     DataFlowEdgeDescriptor edge;
     bool edge_found;
-    boost::tie(edge,edge_found) = boost::edge(u,v,flow_graph_);
+    boost::tie(edge,edge_found) = boost::edge(*source,*sink,flow_graph_);
 
     if(!edge_found) {
       RTT::log(RTT::Error) << "Could not compute latch count because path"
@@ -825,23 +1733,160 @@ int Scheme::latchCount(
   return latch_count;
 }
 
+int Scheme::cycleLatchCount(const conman::graph::DataFlowPath &cycle) const
+{
+  using namespace conman::graph;
+
+  int latch_count = 0;
+
+  // Iterate over pairs of vertices, including the pair which closes the cycle
+  for(DataFlowPath::const_iterator source = cycle.begin();
+      source != cycle.end();
+      ++source)
+  {
+    DataFlowPath::const_iterator sink = boost::next(source);
+    if(sink == cycle.end()) {
+      sink = cycle.begin();
+    }
+
+    DataFlowEdgeDescriptor edge;
+    bool edge_found;
+    boost::tie(edge,edge_found) = boost::edge(*source,*sink,flow_graph_);
+
+    if(edge_found && flow_graph_[edge]->latched) {
+      latch_count++;
+    }
+  }
+
+  return latch_count;
+}
+
+void Scheme::getComponentArcs(
+    const conman::graph::DataFlowPath &component,
+    std::vector<std::vector<std::pair<unsigned int, int> > > &arcs)
+  const
+{
+  using namespace conman::graph;
+
+  // Index the vertices in this component
+  const std::vector<DataFlowVertexDescriptor> vertices(component.begin(), component.end());
+  boost::unordered_map<DataFlowVertexDescriptor, unsigned int> local_index;
+
+  for(unsigned int i=0; i < vertices.size(); i++) {
+    local_index[vertices[i]] = i;
+  }
+
+  arcs.clear();
+  arcs.resize(vertices.size());
+
+  // Collect the DFG arcs within the component
+  for(unsigned int i=0; i < vertices.size(); i++) {
+    DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+    for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(vertices[i], flow_graph_);
+        out_edge_it != out_edge_end;
+        ++out_edge_it)
+    {
+      boost::unordered_map<DataFlowVertexDescriptor, unsigned int>::const_iterator target =
+        local_index.find(boost::target(*out_edge_it, flow_graph_));
+
+      if(target != local_index.end()) {
+        arcs[i].push_back(std::make_pair(
+              target->second,
+              flow_graph_[*out_edge_it]->latched ? 1 : 0));
+      }
+    }
+  }
+}
+
 int Scheme::maxLatchCount() const
 {
+  using namespace conman::graph;
+
   int max_latch_count = 0;
 
-  std::vector<std::vector<std::string> > cycles;
-  this->getFlowCycles(cycles);
+  // Every cycle lies within a strongly connected component
+  std::vector<DataFlowPath> components;
+  if(this->computeCyclicComponents(flow_graph_, components) == 0) {
+    return 0;
+  }
 
-  for(std::vector<std::vector<std::string> >::const_iterator it = cycles.begin();
-      it != cycles.end();
-      ++it)
+  // The size of the largest component which is solved exactly
+  static const unsigned int max_exact_blocks = 16;
+
+  std::vector<std::vector<std::pair<unsigned int, int> > > arcs;
+  bool enumerate = false;
+
+  for(std::vector<DataFlowPath>::const_iterator component = components.begin();
+      component != components.end();
+      ++component)
   {
-    std::vector<std::string> closed_path;
-    if(it->size() >= 2) {
-      closed_path.push_back((*it)[it->size()-1]);
-      closed_path.push_back((*it)[0]);
+    if(component->size() > max_exact_blocks) {
+      enumerate = true;
+      continue;
+    }
+
+    this->getComponentArcs(*component, arcs);
+    const unsigned int n = arcs.size();
+
+    // The latch flags between blocks (-1 if not connected)
+    std::vector<int> latched(n * n, -1);
+    for(unsigned int v=0; v < n; v++) {
+      for(size_t a=0; a < arcs[v].size(); a++) {
+        latched[v * n + arcs[v][a].first] = arcs[v][a].second;
+      }
+    }
+
+    // best[mask * n + v] is the most latches on a simple path which starts
+    // at the lowest block in the mask, visits all of the blocks in the mask,
+    // and ends at v (-1 if there's no such path)
+    std::vector<int> best((size_t(1) << n) * n, -1);
+    for(unsigned int v=0; v < n; v++) {
+      best[(size_t(1) << v) * n + v] = 0;
+    }
+
+    for(size_t mask = 1; mask < (size_t(1) << n); mask++) {
+      // Get the start of the paths through this set of blocks
+      unsigned int start = 0;
+      while(!(mask & (size_t(1) << start))) { start++; }
+
+      for(unsigned int v=start; v < n; v++) {
+        const int latches = best[mask * n + v];
+        if(latches < 0) {
+          continue;
+        }
+
+        // Close the cycle
+        if(latched[v * n + start] >= 0) {
+          max_latch_count = std::max(max_latch_count, latches + latched[v * n + start]);
+        }
+
+        // Extend the path to blocks after the start, so that each cycle is
+        // only considered from its lowest block
+        for(unsigned int w=start+1; w < n; w++) {
+          const size_t bit = size_t(1) << w;
+          if(!(mask & bit) && latched[v * n + w] >= 0) {
+            int &extended = best[(mask | bit) * n + w];
+            extended = std::max(extended, latches + latched[v * n + w]);
+          }
+        }
+      }
+    }
+  }
+
+  // Fall back to (bounded) cycle enumeration for large components
+  if(enumerate) {
+    RTT::log(RTT::Warning) << "Computing the maximum latch count of a large"
+      " cycle by enumeration." << RTT::endlog();
+
+    std::vector<DataFlowPath> cycles;
+    this->computeCycles(flow_graph_, cycles);
+
+    for(std::vector<DataFlowPath>::const_iterator it = cycles.begin();
+        it != cycles.end();
+        ++it)
+    {
+      max_latch_count = std::max(max_latch_count, this->cycleLatchCount(*it));
     }
-    max_latch_count = std::max(max_latch_count, this->latchCount(*it) + this->latchCount(closed_path));
   }
 
   return max_latch_count;
@@ -849,23 +1894,61 @@ int Scheme::maxLatchCount() const
 
 int Scheme::minLatchCount() const
 {
-  int min_latch_count = std::numeric_limits<int>::max();
+  using namespace conman::graph;
 
-  std::vector<std::vector<std::string> > cycles;
-  if(this->getFlowCycles(cycles) == 0) {
+  // Every cycle lies within a strongly connected component
+  std::vector<DataFlowPath> components;
+  if(this->computeCyclicComponents(flow_graph_, components) == 0) {
     return 0;
   }
 
-  for(std::vector<std::vector<std::string> >::const_iterator it = cycles.begin();
-      it != cycles.end();
-      ++it)
+  int min_latch_count = std::numeric_limits<int>::max();
+
+  std::vector<std::vector<std::pair<unsigned int, int> > > arcs;
+  std::vector<int> distance;
+  std::deque<unsigned int> queue;
+
+  for(std::vector<DataFlowPath>::const_iterator component = components.begin();
+      component != components.end();
+      ++component)
   {
-    std::vector<std::string> closed_path;
-    if(it->size() >= 2) {
-      closed_path.push_back((*it)[it->size()-1]);
-      closed_path.push_back((*it)[0]);
+    this->getComponentArcs(*component, arcs);
+    const unsigned int n = arcs.size();
+
+    for(unsigned int source=0; source < n; source++) {
+      // Find the fewest latches on a path from the source to every block
+      distance.assign(n, std::numeric_limits<int>::max());
+      distance[source] = 0;
+      queue.push_back(source);
+
+      while(!queue.empty()) {
+        const unsigned int u = queue.front();
+        queue.pop_front();
+
+        for(size_t a=0; a < arcs[u].size(); a++) {
+          const unsigned int v = arcs[u][a].first;
+          const int latches = distance[u] + arcs[u][a].second;
+
+          if(v == source) {
+            // This arc closes a cycle through the source
+            min_latch_count = std::min(min_latch_count, latches);
+          } else if(latches < distance[v]) {
+            // Unlatched arcs go to the front of the queue
+            distance[v] = latches;
+            if(arcs[u][a].second == 0) {
+              queue.push_front(v);
+            } else {
+              queue.push_back(v);
+            }
+          }
+        }
+      }
+
+      // It can't get any lower
+      if(min_latch_count == 0) {
+        return 0;
+      }
     }
-    min_latch_count = std::min(min_latch_count, this->latchCount(*it) + this->latchCount(closed_path));
   }
 
   return min_latch_count;
@@ -877,26 +1960,48 @@ int Scheme::getFlowCycles(
 {
   using namespace conman::graph;
 
-  cycle_strs.clear();
-
   std::vector<DataFlowPath> cycles;
   this->computeCycles(flow_graph_, cycles);
+  this->getPathNames(flow_graph_, cycles, cycle_strs);
+
+  return cycle_strs.size();
+}
+
+int Scheme::getFlowCyclicComponents(
+    std::vector<std::vector<std::string> > &component_strs)
+  const
+{
+  using namespace conman::graph;
+
+  std::vector<DataFlowPath> components;
+  this->computeCyclicComponents(flow_graph_, components);
+  this->getPathNames(flow_graph_, components, component_strs);
+
+  return component_strs.size();
+}
 
-  // Clear cycle component names
-  cycle_strs.resize(cycles.size());
+void Scheme::getPathNames(
+    const conman::graph::DataFlowGraph &data_flow_graph,
+    const std::vector<conman::graph::DataFlowPath> &paths,
+    std::vector<std::vector<std::string> > &path_names)
+  const
+{
+  using namespace conman::graph;
+
+  // Clear path component names
+  path_names.clear();
+  path_names.resize(paths.size());
 
   // Copy the names of the components associated with the verticies for each
-  // cycle
-  for(size_t c=0; c < cycles.size(); c++) {
-    for(DataFlowPath::const_iterator v_it=cycles[c].begin();
-        v_it != cycles[c].end();
+  // path
+  for(size_t c=0; c < paths.size(); c++) {
+    for(DataFlowPath::const_iterator v_it=paths[c].begin();
+        v_it != paths[c].end();
         ++v_it)
     {
-      cycle_strs[c].push_back(flow_graph_[*v_it]->block->getName());
+      path_names[c].push_back(data_flow_graph[*v_it]->block->getName());
     }
   }
-
-  return cycle_strs.size();
 }
 
 int Scheme::computeCycles(
@@ -909,8 +2014,14 @@ int Scheme::computeCycles(
   // Clear the output variable
   cycles.clear();
 
+  // Don't bother enumerating circuits if there aren't any
+  std::vector<DataFlowPath> components;
+  if(this->computeCyclicComponents(data_flow_graph, components) == 0) {
+    return 0;
+  }
+
   // Construct a cycle visitor for extracting cycles
-  FlowCycleVisitor visitor(cycles);
+  FlowCycleVisitor visitor(cycles, max_cycles_);
 
   try {
     // Find all cycles
@@ -919,6 +2030,10 @@ int Scheme::computeCycles(
 #else
     boost::tiernan_all_cycles( data_flow_graph, visitor);
 #endif
+  } catch(CycleLimitReached &ex) {
+    RTT::log(RTT::Warning) << "Stopped enumerating cycles after " <<
+      cycles.size() << " cycles. Increase \"max_cycles\" to find more." <<
+      RTT::endlog();
   } catch( std::runtime_error &ex) {
     RTT::log(RTT::Error) << "Could not compute cycles for data flow graph." <<
       RTT::endlog();
@@ -928,6 +2043,62 @@ int Scheme::computeCycles(
   return cycles.size();
 }
 
+int Scheme::computeCyclicComponents(
+    const conman::graph::DataFlowGraph &data_flow_graph,
+    std::vector<conman::graph::DataFlowPath> &components)
+  const
+{
+  using namespace conman::graph;
+
+  components.clear();
+
+  // Index the vertices explicitly, since the graph's vertex indices aren't
+  // renumbered when blocks are removed
+  typedef boost::unordered_map<DataFlowVertexDescriptor, int> VertexIntMap;
+  VertexIntMap index_map, component_map;
+
+  int n_vertices = 0;
+  DataFlowVertexIterator vertex_it, vertex_end;
+  for(boost::tie(vertex_it, vertex_end) = boost::vertices(data_flow_graph);
+      vertex_it != vertex_end;
+      ++vertex_it)
+  {
+    index_map[*vertex_it] = n_vertices++;
+  }
+
+  if(n_vertices == 0) {
+    return 0;
+  }
+
+  // Find the strongly connected components with Tarjan's algorithm
+  boost::associative_property_map<VertexIntMap> index(index_map), component(component_map);
+  const int n_components = boost::strong_components(
+      data_flow_graph,
+      component,
+      boost::vertex_index_map(index));
+
+  // Group the vertices by component
+  std::vector<DataFlowPath> members(n_components);
+  for(boost::tie(vertex_it, vertex_end) = boost::vertices(data_flow_graph);
+      vertex_it != vertex_end;
+      ++vertex_it)
+  {
+    members[component_map[*vertex_it]].push_back(*vertex_it);
+  }
+
+  // Only components with more than one vertex or a self-loop have cycles
+  for(std::vector<DataFlowPath>::const_iterator it = members.begin();
+      it != members.end();
+      ++it)
+  {
+    if(it->size() > 1 || boost::edge(it->front(), it->front(), data_flow_graph).second) {
+      components.push_back(*it);
+    }
+  }
+
+  return components.size();
+}
+
 bool Scheme::computeSchedule(
     const conman::graph::DataFlowGraph &data_flow_graph,
     conman::graph::ExecutionOrdering &ordering,
@@ -972,6 +2143,11 @@ bool Scheme::executable() const
 {
   using namespace conman::graph;
 
+  // The maintained order is only valid if the ESG is acyclic
+  if(exec_topology_.valid()) {
+    return true;
+  }
+
   // Compute the schedule on a throw-away ordering
   ExecutionOrdering ordering;
   return this->computeSchedule(exec_graph_, ordering, true);
@@ -983,26 +2159,40 @@ int Scheme::getExecutionCycles(
 {
   using namespace conman::graph;
 
-  cycle_strs.clear();
-
   std::vector<DataFlowPath> cycles;
   this->computeCycles(exec_graph_, cycles);
+  this->getPathNames(exec_graph_, cycles, cycle_strs);
 
-  // Clear cycle component names
-  cycle_strs.resize(cycles.size());
-
-  // Copy the names of the components associated with the verticies for each
-  // cycle
-  for(size_t c=0; c < cycles.size(); c++) {
-    for(DataFlowPath::const_iterator v_it=cycles[c].begin();
-        v_it != cycles[c].end();
-        ++v_it)
-    {
-      cycle_strs[c].push_back(exec_graph_[*v_it]->block->getName());
-    }
+  return cycle_strs.size();
+}
+
+int Scheme::getExecutionCyclicComponents(
+    std::vector<std::vector<std::string> > &component_strs)
+  const
+{
+  using namespace conman::graph;
+
+  std::vector<DataFlowPath> components;
+  this->computeCyclicComponents(exec_graph_, components);
+  this->getPathNames(exec_graph_, components, component_strs);
+
+  return component_strs.size();
+}
+
+std::vector<std::string> Scheme::getCyclicBlocks() const
+{
+  std::vector<std::vector<std::string> > components;
+  this->getExecutionCyclicComponents(components);
+
+  std::vector<std::string> cyclic_blocks;
+  for(std::vector<std::vector<std::string> >::const_iterator it = components.begin();
+      it != components.end();
+      ++it)
+  {
+    cyclic_blocks.insert(cyclic_blocks.end(), it->begin(), it->end());
   }
 
-  return cycle_strs.size();
+  return cyclic_blocks;
 }
 
 bool Scheme::getExecutionOrder(std::vector<std::string> &order) const
@@ -1015,6 +2205,15 @@ bool Scheme::getExecutionOrder(std::vector<std::string> &order) const
     return false;
   }
 
+  // The frozen model is already in execution order
+  if(model_frozen_) {
+    order.reserve(compact_model_.size());
+    for(size_t i=0; i < compact_model_.size(); i++) {
+      order.push_back(compact_model_.blocks[i]->getName());
+    }
+    return true;
+  }
+
   // Fill the order with
   for(conman::graph::ExecutionOrdering::const_iterator it = exec_ordering_.begin();
       it != exec_ordering_.end();
@@ -1067,6 +2266,8 @@ void Scheme::computeConflicts(conman::graph::DataFlowVertex::Ptr seed_vertex)
 
   RTT::log(RTT::Debug) << "Computing conflicts for " << seed_block->getName() << "..." << RTT::endlog();
 
+  bool conflicts_added = false;
+
   // Add this block to the conflict graph / map if it isn't already in it
   if(conflict_vertex_map_.find(seed_block) == conflict_vertex_map_.end()) {
     conflict_vertex_map_[seed_block] = boost::add_vertex(seed_vertex,conflict_graph_);
@@ -1105,7 +2306,7 @@ void Scheme::computeConflicts(conman::graph::DataFlowVertex::Ptr seed_vertex)
 
       // Get the exclusivity of this connection from the seed to this sink
       // (the sink port of the out connection is the input that it is connected to)
-      const conman::Exclusivity::Mode mode = sink_vertex->hook->getInputExclusivity(sink_port_path);
+      const conman::Exclusivity::Mode mode = sink_vertex->hook_service->getInputExclusivity(sink_port_path);
 
       // Only exclusive ports can induce conflicts
       if(mode != conman::Exclusivity::EXCLUSIVE) {
@@ -1160,6 +2361,10 @@ void Scheme::computeConflicts(conman::graph::DataFlowVertex::Ptr seed_vertex)
               conflict_vertex_map_[conflicting_vertex->block],
               conflict_graph_);
 
+          conflict_matrix_[seed_vertex->index].set(conflicting_vertex->index);
+          conflict_matrix_[conflicting_vertex->index].set(seed_vertex->index);
+          conflicts_added = true;
+
           // Debug output
           RTT::log(RTT::Debug) << " -- -- -- -- Added conflict between blocks "<<
             seed_block->getName() << " and " <<
@@ -1169,6 +2374,11 @@ void Scheme::computeConflicts(conman::graph::DataFlowVertex::Ptr seed_vertex)
       }
     }
   }
+
+  // Modes which are now self-conflicting can't be used
+  if(conflicts_added) {
+    this->compileModes();
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1183,6 +2393,157 @@ const conman::graph::ConflictVertexDescriptor Scheme::getConflictVertex(RTT::Tas
   return conflict_vertex_map_.find(task)->second;
 }
 
+RTT::TaskContext* Scheme::getRunningConflict(const conman::BlockHandle handle) const
+{
+  const conman::BlockSet &conflicts = conflict_matrix_[handle];
+
+  // Only look for the running block if there is one
+  if(!conflicts.intersects(running_blocks_)) {
+    return NULL;
+  }
+
+  for(conman::BlockSet::size_type conflict = conflicts.find_first();
+      conflict != conman::BlockSet::npos;
+      conflict = conflicts.find_next(conflict))
+  {
+    if(running_blocks_[conflict]) {
+      return block_indices_[conflict]->block;
+    }
+  }
+
+  return NULL;
+}
+
+void Scheme::resizeBlockSets()
+{
+  const size_t n_blocks = block_indices_.size();
+
+  conflict_matrix_.resize(n_blocks);
+  for(size_t i=0; i < n_blocks; i++) {
+    conflict_matrix_[i].resize(n_blocks);
+  }
+
+  running_blocks_.resize(n_blocks);
+  marked_blocks_.resize(n_blocks);
+  disabled_blocks_.resize(n_blocks);
+}
+
+void Scheme::rebuildBlockSets()
+{
+  using namespace conman::graph;
+
+  conflict_matrix_.clear();
+  running_blocks_.clear();
+  marked_blocks_.clear();
+  disabled_blocks_.clear();
+
+  this->resizeBlockSets();
+
+  // Copy the RCG
+  boost::graph_traits<ConflictGraph>::edge_iterator conflict_it, conflict_end;
+  for(boost::tie(conflict_it, conflict_end) = boost::edges(conflict_graph_);
+      conflict_it != conflict_end;
+      ++conflict_it)
+  {
+    const unsigned int a = conflict_graph_[boost::source(*conflict_it, conflict_graph_)]->index;
+    const unsigned int b = conflict_graph_[boost::target(*conflict_it, conflict_graph_)]->index;
+    conflict_matrix_[a].set(b);
+    conflict_matrix_[b].set(a);
+  }
+
+  for(size_t i=0; i < block_indices_.size(); i++) {
+    running_blocks_[i] =
+      block_indices_[i]->block->getTaskState() == RTT::TaskContext::Running &&
+      !this->isStandby(block_indices_[i]);
+  }
+}
+
+const conman::graph::CompactModel& Scheme::getCompactModel() const
+{
+  return compact_model_;
+}
+
+void Scheme::freezeModel()
+{
+  using namespace conman::graph;
+
+  compact_model_.clear();
+
+  // Assign ids in execution order
+  compact_model_.blocks.reserve(exec_ordering_.size());
+  compact_model_.indices.reserve(exec_ordering_.size());
+  for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
+      it != exec_ordering_.end();
+      ++it)
+  {
+    RTT::TaskContext *block = exec_graph_[*it]->block;
+    compact_model_.ids[block] = compact_model_.blocks.size();
+    compact_model_.blocks.push_back(block);
+    compact_model_.indices.push_back(exec_graph_[*it]->index);
+  }
+
+  const size_t n_blocks = compact_model_.blocks.size();
+  std::vector<std::pair<BlockId, BlockId> > edges, reversed;
+
+  // ESG
+  boost::graph_traits<DataFlowGraph>::edge_iterator edge_it, edge_end;
+  for(boost::tie(edge_it, edge_end) = boost::edges(exec_graph_);
+      edge_it != edge_end;
+      ++edge_it)
+  {
+    const BlockId source = compact_model_.ids[exec_graph_[boost::source(*edge_it, exec_graph_)]->block];
+    const BlockId target = compact_model_.ids[exec_graph_[boost::target(*edge_it, exec_graph_)]->block];
+    edges.push_back(std::make_pair(source, target));
+    reversed.push_back(std::make_pair(target, source));
+  }
+
+  compact_model_.exec_out.build(n_blocks, edges);
+  compact_model_.exec_in.build(n_blocks, reversed);
+
+  model_frozen_ = true;
+}
+
+void Scheme::getExecNeighbors(
+    const conman::graph::DataFlowVertex::Ptr &block_vertex,
+    const bool successors,
+    std::vector<unsigned int> &neighbors) const
+{
+  using namespace conman::graph;
+
+  neighbors.clear();
+
+  // Read the frozen ESG while the scheme is running
+  BlockId id;
+  if(model_frozen_ && compact_model_.getId(block_vertex->block, id)) {
+    const CompactAdjacency &adjacency = successors ? compact_model_.exec_out : compact_model_.exec_in;
+    for(const BlockId *it = adjacency.begin(id); it != adjacency.end(id); ++it) {
+      neighbors.push_back(compact_model_.indices[*it]);
+    }
+    return;
+  }
+
+  // Otherwise walk the ESG itself
+  const DataFlowVertexDescriptor vertex = exec_vertex_map_.find(block_vertex->block)->second;
+
+  if(successors) {
+    DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+    for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(vertex, exec_graph_);
+        out_edge_it != out_edge_end;
+        ++out_edge_it)
+    {
+      neighbors.push_back(exec_graph_[boost::target(*out_edge_it, exec_graph_)]->index);
+    }
+  } else {
+    DataFlowInEdgeIterator in_edge_it, in_edge_end;
+    for(boost::tie(in_edge_it, in_edge_end) = boost::in_edges(vertex, exec_graph_);
+        in_edge_it != in_edge_end;
+        ++in_edge_it)
+    {
+      neighbors.push_back(exec_graph_[boost::source(*in_edge_it, exec_graph_)]->index);
+    }
+  }
+}
+
 bool Scheme::addBlockToGraph(conman::graph::DataFlowVertex::Ptr new_vertex)
 {
   using namespace conman::graph;
@@ -1214,11 +2575,15 @@ bool Scheme::addBlockToGraph(conman::graph::DataFlowVertex::Ptr new_vertex)
   // Add this block to the DFG & ESG
   flow_vertex_map_[new_block] = boost::add_vertex(new_vertex, flow_graph_);
   exec_vertex_map_[new_block] = boost::add_vertex(new_vertex, exec_graph_);
+  exec_topology_.addVertex(exec_vertex_map_[new_block]);
 
   RTT::log(RTT::Debug) << "Created vertex: "<< new_vertex->index << " (" <<
     flow_vertex_map_[new_block] << ", " << exec_vertex_map_[new_block] << ")"
     << RTT::endlog();
 
+  // Model the new block's connections
+  dirty_blocks_.insert(new_block);
+
   // Regenerate the topological ordering
   if(!this->regenerateModel()) {
     // Report error if we can't regenerate the graphs
@@ -1247,6 +2612,40 @@ bool Scheme::removeBlockFromGraph(conman::graph::DataFlowVertex::Ptr vertex)
     return true;
   }
 
+  // Forget the connections on the block's edges
+  const DataFlowVertexDescriptor flow_vertex = flow_vertex_map_[vertex->block];
+
+  DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+  for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(flow_vertex, flow_graph_);
+      out_edge_it != out_edge_end;
+      ++out_edge_it)
+  {
+    const std::vector<DataFlowEdge::Connection> &connections = flow_graph_[*out_edge_it]->connections;
+    for(std::vector<DataFlowEdge::Connection>::const_iterator it = connections.begin();
+        it != connections.end();
+        ++it)
+    {
+      modeled_connections_.erase(std::make_pair(it->source_port, it->sink_port));
+    }
+  }
+
+  DataFlowInEdgeIterator in_edge_it, in_edge_end;
+  for(boost::tie(in_edge_it, in_edge_end) = boost::in_edges(flow_vertex, flow_graph_);
+      in_edge_it != in_edge_end;
+      ++in_edge_it)
+  {
+    const std::vector<DataFlowEdge::Connection> &connections = flow_graph_[*in_edge_it]->connections;
+    for(std::vector<DataFlowEdge::Connection>::const_iterator it = connections.begin();
+        it != connections.end();
+        ++it)
+    {
+      modeled_connections_.erase(std::make_pair(it->source_port, it->sink_port));
+    }
+  }
+
+  dirty_blocks_.erase(vertex->block);
+  topology_dirty_ = true;
+
   // Remove the edges, the vertex itself, and the reference in the flow map
   if(flow_vertex_map_.find(vertex->block) != flow_vertex_map_.end()) {
     boost::clear_vertex(flow_vertex_map_[vertex->block], flow_graph_);
@@ -1256,6 +2655,7 @@ bool Scheme::removeBlockFromGraph(conman::graph::DataFlowVertex::Ptr vertex)
 
   // Remove the edges, the vertex itself, and the reference in the exec map
   if(exec_vertex_map_.find(vertex->block) != exec_vertex_map_.end()) {
+    exec_topology_.removeVertex(exec_vertex_map_[vertex->block]);
     boost::clear_vertex(exec_vertex_map_[vertex->block], exec_graph_);
     boost::remove_vertex(exec_vertex_map_[vertex->block], exec_graph_);
     exec_vertex_map_.erase(vertex->block);
@@ -1285,241 +2685,649 @@ bool Scheme::regenerateModel()
   }
 
   // Initialize the modification flag
-  bool topology_modified = exec_ordering_.size() != flow_vertex_map_.size();
+  bool topology_modified = topology_dirty_ || exec_ordering_.size() != flow_vertex_map_.size();
 
-  // Iterate over all vertex structures
-  for(boost::unordered_map<std::string, DataFlowVertex::Ptr>::iterator vert_it = blocks_.begin();
-      vert_it != blocks_.end();
-      ++vert_it)
-  {
-    // Temporary variable for readability
-    DataFlowVertex::Ptr source_vertex = vert_it->second;
+  // Rescan the dirty blocks in index order, so that edges are always created
+  // in the same order
+  if(!dirty_blocks_.empty()) {
+    for(std::vector<DataFlowVertex::Ptr>::const_iterator it = block_indices_.begin();
+        it != block_indices_.end();
+        ++it)
+    {
+      if(dirty_blocks_.find((*it)->block) != dirty_blocks_.end()) {
+        topology_modified |= this->scanBlockConnections(*it);
+      }
+    }
+
+    dirty_blocks_.clear();
+  }
+
+  // Defer the ordering and the plan until the transaction is committed
+  if(in_transaction_) {
+    topology_dirty_ |= topology_modified;
+    return true;
+  }
 
-    // Get the output ports for a given taskcontext
-    std::vector<RTT::base::PortInterface*> ports;
-    GetAllPorts(source_vertex->block->provides(), ports);
+  // Update the execution schedule if the topology changed. The order is
+  // maintained incrementally as ESG arcs are added, so it only needs to be
+  // recomputed from scratch after the ESG had a cycle.
+  if(topology_modified) {
+    if(exec_topology_.valid() || exec_topology_.reset(exec_graph_)) {
+      exec_ordering_.assign(exec_topology_.order().begin(), exec_topology_.order().end());
+      RTT::log(RTT::Debug) << "Regenerated topological ordering." << RTT::endlog();
+      topology_dirty_ = false;
+    } else {
+      RTT::log(RTT::Debug) << "Could not regenerate the topological ordering." << RTT::endlog();
+      exec_ordering_.clear();
+      exec_blocks_.clear();
+      topology_dirty_ = true;
+      this->compileModes();
+      return false;
+    }
 
-    // Create graph arcs for each port between blocks
-    std::vector<RTT::base::PortInterface*>::const_iterator port_it;
-    for(port_it = ports.begin(); port_it != ports.end(); ++port_it)
+    exec_blocks_.clear();
+    exec_blocks_.reserve(exec_ordering_.size());
+    for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
+        it != exec_ordering_.end();
+        ++it)
     {
-      // Get the port, for readability
-      const RTT::base::PortInterface *port = *port_it;
+      exec_blocks_.push_back(exec_graph_[*it]);
+    }
+
+    // Modes start their blocks in execution order
+    this->compileModes();
+  }
+
+  // Recompile the execution plan from the new ordering
+  this->compileExecutionPlan();
+
+  return true;
+}
+
+bool Scheme::refreshModel()
+{
+  // Rescan every block
+  for(boost::unordered_map<std::string, conman::graph::DataFlowVertex::Ptr>::const_iterator it = blocks_.begin();
+      it != blocks_.end();
+      ++it)
+  {
+    dirty_blocks_.insert(it->second->block);
+  }
+
+  return this->regenerateModel();
+}
+
+bool Scheme::markBlockDirty(const std::string &block_name)
+{
+  using namespace conman::graph;
+
+  boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator block_it = blocks_.find(block_name);
+  if(block_it == blocks_.end()) {
+    return false;
+  }
+
+  RTT::TaskContext *block = block_it->second->block;
+  dirty_blocks_.insert(block);
+
+  // The neighbors' edges to this block might also have changed
+  const DataFlowVertexDescriptor vertex = flow_vertex_map_[block];
+
+  DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+  for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(vertex, flow_graph_);
+      out_edge_it != out_edge_end;
+      ++out_edge_it)
+  {
+    dirty_blocks_.insert(flow_graph_[boost::target(*out_edge_it, flow_graph_)]->block);
+  }
+
+  DataFlowInEdgeIterator in_edge_it, in_edge_end;
+  for(boost::tie(in_edge_it, in_edge_end) = boost::in_edges(vertex, flow_graph_);
+      in_edge_it != in_edge_end;
+      ++in_edge_it)
+  {
+    dirty_blocks_.insert(flow_graph_[boost::source(*in_edge_it, flow_graph_)]->block);
+  }
+
+  return true;
+}
+
+bool Scheme::scanBlockConnections(const conman::graph::DataFlowVertex::Ptr &block_vertex)
+{
+  using namespace conman::graph;
+
+  bool topology_modified = false;
 
-      RTT::log(RTT::Debug) << "Examining port: "<<source_vertex->block->getName() << " . " <<port->getName() << RTT::endlog();
+  // Get all of the ports for a given taskcontext
+  std::vector<RTT::base::PortInterface*> ports;
+  GetAllPorts(block_vertex->block->provides(), ports);
+
+  // Create graph arcs for each connection to or from this block
+  std::vector<RTT::base::PortInterface*>::const_iterator port_it;
+  for(port_it = ports.begin(); port_it != ports.end(); ++port_it)
+  {
+    // Get the port, for readability
+    const RTT::base::PortInterface *port = *port_it;
+
+    RTT::log(RTT::Debug) << "Examining port: "<<block_vertex->block->getName() << " . " <<port->getName() << RTT::endlog();
+
+    // Get the port connections (to get endpoints)
+    std::list<RTT::internal::ConnectionManager::ChannelDescriptor> channels = port->getManager()->getChannels();
+    std::list<RTT::internal::ConnectionManager::ChannelDescriptor>::iterator channel_it;
+
+    // Create graph arcs for each connection
+    for(channel_it = channels.begin(); channel_it != channels.end(); ++channel_it)
+    {
+      // Get the connection descriptor
+      RTT::base::ChannelElementBase::shared_ptr connection = channel_it->get<1>();
+
+      // Pointers to the endpoints of this connection
+      RTT::base::PortInterface
+        *source_port = connection->getInputEndPoint()->getPort(),
+        *sink_port = connection->getOutputEndPoint()->getPort();
+
+      // Make sure the ports and components are not null
+      // Make sure they have DFIs (some dont, like streamed ports)
+      if( source_port == NULL || source_port->getInterface() == NULL
+          || sink_port == NULL || sink_port->getInterface() == NULL)
+      {
+        continue;
+      }
 
-      // Only start from output ports
-      if(!dynamic_cast<const RTT::base::OutputPortInterface*>(port)) {
+      // Skip connections which have already been modeled
+      if(!modeled_connections_.insert(std::make_pair(source_port, sink_port)).second) {
         continue;
       }
 
-      // Get the port connections (to get endpoints)
-      std::list<RTT::internal::ConnectionManager::ChannelDescriptor> channels = port->getManager()->getChannels();
-      std::list<RTT::internal::ConnectionManager::ChannelDescriptor>::iterator channel_it;
+      // Get the source and sink components
+      RTT::Service
+        *source_service = source_port->getInterface()->getService(),
+        *sink_service = sink_port->getInterface()->getService();
+
+      RTT::TaskContext
+        *source_block = source_port->getInterface()->getOwner(),
+        *sink_block = sink_port->getInterface()->getOwner();
 
-      // Create graph arcs for each connection
-      for(channel_it = channels.begin(); channel_it != channels.end(); ++channel_it)
+      // Make sure both blocks are in the DFG and ESG
+      if( flow_vertex_map_.find(source_block) == flow_vertex_map_.end() ||
+          flow_vertex_map_.find(sink_block)   == flow_vertex_map_.end() ||
+          exec_vertex_map_.find(source_block) == exec_vertex_map_.end() ||
+          exec_vertex_map_.find(sink_block)   == exec_vertex_map_.end())
       {
-        // Get the connection descriptor
-        RTT::base::ChannelElementBase::shared_ptr connection = channel_it->get<1>();
-
-        // Pointers to the endpoints of this connection
-        RTT::base::PortInterface
-          *source_port = connection->getInputEndPoint()->getPort(),
-          *sink_port = connection->getOutputEndPoint()->getPort();
-
-        // Make sure the ports and components are not null
-        // Make sure they have DFIs (some dont, like streamed ports)
-        if( source_port == NULL || source_port->getInterface() == NULL
-            || sink_port == NULL || sink_port->getInterface() == NULL)
-        {
-          continue;
-        }
+        // This will be modeled when the other block is added
+        modeled_connections_.erase(std::make_pair(source_port, sink_port));
+        continue;
+      }
 
-        // Get the source and sink components
-        RTT::Service
-          *source_service = source_port->getInterface()->getService(),
-          *sink_service = sink_port->getInterface()->getService();
+      // Get the source and sink flow vertex descriptors
+      DataFlowVertexDescriptor flow_source_desc = flow_vertex_map_[source_block];
+      DataFlowVertexDescriptor flow_sink_desc = flow_vertex_map_[sink_block];
 
-        RTT::TaskContext
-          *source_block = source_port->getInterface()->getOwner(),
-          *sink_block = sink_port->getInterface()->getOwner();
+      // Get the source and sink vertex properties
+      DataFlowVertex::Ptr source_vertex = flow_graph_[flow_source_desc];
+      DataFlowVertex::Ptr sink_vertex = flow_graph_[flow_sink_desc];
 
-        // Make sure both blocks are in the DFG and ESG
-        if( flow_vertex_map_.find(source_block) == flow_vertex_map_.end() ||
-            flow_vertex_map_.find(sink_block)   == flow_vertex_map_.end() ||
-            exec_vertex_map_.find(source_block) == exec_vertex_map_.end() ||
-            exec_vertex_map_.find(sink_block)   == exec_vertex_map_.end())
-        {
-          continue;
-        }
+      // Get an existing edge between these two blocks in the DFG
+      DataFlowEdgeDescriptor flow_edge_desc;
+      bool flow_edge_found;
 
-        // Get the source and sink flow vertex descriptors
-        DataFlowVertexDescriptor flow_source_desc = flow_vertex_map_[source_block];
-        DataFlowVertexDescriptor flow_sink_desc = flow_vertex_map_[sink_block];
+      boost::tie(flow_edge_desc, flow_edge_found) = boost::edge(
+          flow_source_desc,
+          flow_sink_desc,
+          flow_graph_);
 
-        // Get the sink vertex properties
-        DataFlowVertex::Ptr sink_vertex = flow_graph_[flow_sink_desc];
+      // Pointer to flow edge properties
+      DataFlowEdge::Ptr flow_edge;
 
-        // Get an existing edge between these two blocks in the DFG
-        DataFlowEdgeDescriptor flow_edge_desc;
-        bool flow_edge_found;
+      // Only create edge if it isn't already there
+      if(flow_edge_found) {
+        RTT::log(RTT::Debug) << "Found DFG edge "
+          << source_block->getName() << "." << source_port->getName() << " --> "
+          << sink_block->getName() << "." << sink_port->getName() << RTT::endlog();
+
+        // Get the existing DFG edge
+        flow_edge = flow_graph_[flow_edge_desc];
+      } else {
+        // Create a new edge representing the connections between these two vertices
+        flow_edge = boost::make_shared<DataFlowEdge>();
 
-        boost::tie(flow_edge_desc, flow_edge_found) = boost::edge(
+        // Add the edge to the DFG
+        bool edge_added;
+        boost::tie(flow_edge_desc,edge_added) = boost::add_edge(
             flow_source_desc,
             flow_sink_desc,
+            flow_edge,
             flow_graph_);
 
-        // Pointer to flow edge properties
-        DataFlowEdge::Ptr flow_edge;
+        if(edge_added) {
+          // Set the topo flag since we've modified edges
+          topology_modified = true;
 
-        // Only create edge if it isn't already there
-        if(flow_edge_found) {
-          RTT::log(RTT::Debug) << "Found DFG edge "
+          RTT::log(RTT::Debug) << "Created DFG edge "
             << source_block->getName() << "." << source_port->getName() << " --> "
             << sink_block->getName() << "." << sink_port->getName() << RTT::endlog();
-
-          // Get the existing DFG edge
-          flow_edge = flow_graph_[flow_edge_desc];
         } else {
-          // Create a new edge representing the connections between these two vertices
-          flow_edge = boost::make_shared<DataFlowEdge>();
-
-          // Add the edge to the DFG
-          bool edge_added;
-          boost::tie(flow_edge_desc,edge_added) = boost::add_edge(
-              flow_source_desc,
-              flow_sink_desc,
-              flow_edge,
-              flow_graph_);
-
-          if(edge_added) {
-            // Set the topo flag since we've modified edges
-            topology_modified = true;
-
-            RTT::log(RTT::Debug) << "Created DFG edge "
-              << source_block->getName() << "." << source_port->getName() << " --> "
-              << sink_block->getName() << "." << sink_port->getName() << RTT::endlog();
-          } else {
-            RTT::log(RTT::Error) << "Could not create DFG edge "
-              << source_block->getName() << "." << source_port->getName() << " --> "
-              << sink_block->getName() << "." << sink_port->getName() << RTT::endlog();
-          }
+          RTT::log(RTT::Error) << "Could not create DFG edge "
+            << source_block->getName() << "." << source_port->getName() << " --> "
+            << sink_block->getName() << "." << sink_port->getName() << RTT::endlog();
         }
+      }
 
-        // Check if this connection is already modeled in the data flow edge
-        bool connection_exists = false;
-        std::vector<DataFlowEdge::Connection>::const_iterator edge_connection_it;
-        for(edge_connection_it = flow_edge->connections.begin();
-            edge_connection_it != flow_edge->connections.end();
-            ++edge_connection_it)
-        {
-          if( edge_connection_it->source_port == source_port &&
-              edge_connection_it->sink_port == sink_port)
-          {
-            connection_exists = true;
-            break;
-          }
-        }
+      // Store the data flow connection in the edge
+      flow_edge->connections.push_back(
+          DataFlowEdge::Connection(
+              source_service, source_port,
+              sink_service, sink_port));
 
-        // Store the data flow connection in the edge if it doesn't already exist
-        if(!connection_exists) {
-          flow_edge->connections.push_back(
-              DataFlowEdge::Connection(
-                  source_service, source_port,
-                  sink_service, sink_port));
-        }
+      // Check if either of the blocks involved in this connection are latched
+      if(source_vertex->latched_output || sink_vertex->latched_input) {
+        flow_edge->latched = true;
+      }
 
-        // Check if either of the blocks involved in this connection are latched
-        if(source_vertex->latched_output || sink_vertex->latched_input) {
-          flow_edge->latched = true;
-        }
+      // Get the source and sink exec vertex descriptors
+      DataFlowVertexDescriptor exec_source_desc = exec_vertex_map_[source_block];
+      DataFlowVertexDescriptor exec_sink_desc = exec_vertex_map_[sink_block];
 
-        // Get the source and sink exec vertex descriptors
-        DataFlowVertexDescriptor exec_source_desc = exec_vertex_map_[source_block];
-        DataFlowVertexDescriptor exec_sink_desc = exec_vertex_map_[sink_block];
-
-        // Get the edge in the exec graph
-        DataFlowEdgeDescriptor exec_edge_desc;
-        bool exec_edge_found;
-        boost::tie(exec_edge_desc, exec_edge_found) = boost::edge(
-            exec_source_desc,
-            exec_sink_desc,
-            exec_graph_);
-
-        if(flow_edge->latched) {
-          if(exec_edge_found) {
-            // Remove the edge from the exec graph
-            boost::remove_edge(exec_edge_desc, exec_graph_);
-            topology_modified = true;
-          }
-        } else {
-          if(!exec_edge_found) {
-            // Add the edge to the exec graph
-            bool edge_added;
-            boost::tie(exec_edge_desc,edge_added) = boost::add_edge(
-                exec_source_desc,
-                exec_sink_desc,
-                flow_edge,
-                exec_graph_);
-            topology_modified = true;
-          }
+      // Get the edge in the exec graph
+      DataFlowEdgeDescriptor exec_edge_desc;
+      bool exec_edge_found;
+      boost::tie(exec_edge_desc, exec_edge_found) = boost::edge(
+          exec_source_desc,
+          exec_sink_desc,
+          exec_graph_);
+
+      if(flow_edge->latched) {
+        if(exec_edge_found) {
+          // Remove the edge from the exec graph
+          boost::remove_edge(exec_edge_desc, exec_graph_);
+          topology_modified = true;
+        }
+      } else {
+        if(!exec_edge_found) {
+          // Add the edge to the exec graph
+          bool edge_added;
+          boost::tie(exec_edge_desc,edge_added) = boost::add_edge(
+              exec_source_desc,
+              exec_sink_desc,
+              flow_edge,
+              exec_graph_);
+          exec_topology_.addEdge(exec_graph_, exec_source_desc, exec_sink_desc);
+          topology_modified = true;
         }
       }
     }
   }
 
-  // Recompute the execution schedule if the topology changed
-  if(topology_modified) {
-    if(this->computeSchedule(exec_graph_, exec_ordering_, true)) {
-      RTT::log(RTT::Debug) << "Regenerated topological ordering." << RTT::endlog();
-    } else {
-      RTT::log(RTT::Debug) << "Could not regenerate the topological ordering." << RTT::endlog();
-      return false;
+  return topology_modified;
+}
+
+void Scheme::compileExecutionPlan()
+{
+  using namespace conman::graph;
+
+  RTT::Logger::In in("Scheme::compileExecutionPlan");
+
+  // Block the publication of the plan while it's being replaced
+  RTT::os::MutexLock lock(plan_mutex_);
+
+  // Only running blocks are included in the plan
+  std::vector<bool> active(block_indices_.size(), false);
+
+  for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
+      it != exec_ordering_.end();
+      ++it)
+  {
+    const DataFlowVertex::Ptr &block_vertex = exec_graph_[*it];
+    if(block_vertex->index < active.size()) {
+      active[block_vertex->index] =
+        block_vertex->block->getTaskState() == RTT::TaskContext::Running;
+      // Blocks in standby are executed, but they can't cause conflicts
+      running_blocks_[block_vertex->index] =
+        active[block_vertex->index] && !this->isStandby(block_vertex);
+
+      // Restore the connections of blocks which were stopped by a mode
+      // switch (the gates themselves are kept, since the published plan
+      // still refers to them)
+      if(!active[block_vertex->index] && block_vertex->gate) {
+        block_vertex->gate->clear();
+      }
     }
   }
 
-  return true;
-}
-
-///////////////////////////////////////////////////////////////////////////////
+  this->buildExecutionPlan(active, pending_plan_);
 
-bool Scheme::enableBlock(const std::string &block_name, const bool force)
-{
-  RTT::Logger::In in("Scheme::enableBlock");
+  // Allocate the executor's buffers here instead of in the scheme's thread
+  if(executor_) {
+    executor_->prepare(pending_plan_);
+  }
 
-  // First check if this block is a group
-  conman::GroupMap::iterator group =
-    block_groups_.find(block_name);
+  plan_pending_ = true;
 
-  if(group != block_groups_.end()) {
-    // Enable the blocks in this group
-    RTT::log(RTT::Debug) << "Enabling blocks in group \"" << block_name <<"\"" << RTT::endlog();
-    return this->enableBlocks(
-        std::vector<std::string>(group->second.begin(),group->second.end()),
-        true,
-        force);
+  // If the scheme isn't running, there's no cycle boundary to wait for
+  if(!this->isRunning()) {
+    this->publishExecutionPlan();
   }
 
-  // Enable the block by name
-  return this->enableBlock(this->getPeer(block_name), force);
+  // A requested mode switch starts from the blocks which are running now
+  if(switch_pending_ && !this->compileModeSwitch(mode_switch_.handle, true)) {
+    RTT::log(RTT::Warning) << "Dropping the requested mode switch because"
+      " the mode can no longer be used." << RTT::endlog();
+    switch_pending_ = false;
+  }
 }
 
-bool Scheme::enableBlock(RTT::TaskContext *block, const bool force)
+void Scheme::buildExecutionPlan(
+    const std::vector<bool> &active,
+    conman::ExecutionPlan &plan)
 {
   using namespace conman::graph;
 
-  RTT::Logger::In in("Scheme::enableBlock");
+  // The most recently compiled plan, which might not be published yet
+  const ExecutionPlan &latest_plan = plan_pending_ ? pending_plan_ : execution_plan_;
 
-  if(block == NULL) {
-    RTT::log(RTT::Error) << "Could not enable block because the given block is NULL." << RTT::endlog();
-    return false;
+  // Keep the phase of blocks which were already active
+  std::vector<unsigned int> phases(block_indices_.size(), 0);
+  std::vector<bool> was_active(block_indices_.size(), false);
+
+  for(std::vector<ExecutionStep>::const_iterator it = latest_plan.steps.begin();
+      it != latest_plan.steps.end();
+      ++it)
+  {
+    if(it->index < phases.size()) {
+      phases[it->index] = it->phase;
+      was_active[it->index] = true;
+    }
   }
 
-  const std::string &block_name = block->getName();
-  boost::unordered_map<std::string,conman::graph::DataFlowVertex::Ptr>::const_iterator block_vertex_it = blocks_.find(block_name);
+  // Dependency levels of each block, indexed by vertex index
+  std::vector<unsigned int> levels(block_indices_.size(), 0);
+  // ESG neighbors of the block being visited
+  std::vector<unsigned int> neighbors;
 
-  RTT::log(RTT::Debug) << "Enabling block \"" << block_name <<"\"" << RTT::endlog();
+  plan.period = SecondsToNSecs(this->getPeriod());
+  plan.steps.clear();
+  plan.level_offsets.clear();
+  plan.successors.clear();
+  plan.successor_offsets.clear();
+
+  for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
+      it != exec_ordering_.end();
+      ++it)
+  {
+    const DataFlowVertex::Ptr &block_vertex = exec_graph_[*it];
+
+    if(block_vertex->index >= active.size() || !active[block_vertex->index]) {
+      continue;
+    }
+
+    ExecutionStep step;
+    step.index = block_vertex->index;
+    step.block = block_vertex->block;
+    step.hook = block_vertex->hook_service;
+    step.criticality = step.hook->getCriticality();
+    step.stage = (step.index < stage_of_index_.size()) ? stage_of_index_[step.index] : 0;
+    step.deferred = false;
+    step.gate = block_vertex->gate.get();
+
+    // A block's level is one more than the highest level of its active
+    // predecessors (which have already been visited in topological order)
+    step.level = 0;
+    step.n_predecessors = 0;
+    this->getExecNeighbors(block_vertex, false, neighbors);
+    for(size_t n=0; n < neighbors.size(); n++) {
+      const unsigned int source_index = neighbors[n];
+      if(source_index != step.index && source_index < levels.size() && active[source_index]) {
+        step.level = std::max(step.level, levels[source_index] + 1);
+      }
+    }
+    levels[step.index] = step.level;
+
+    step.rate_divisor = ExecutionPlan::RateDivisor(
+        plan.period,
+        step.hook->getDesiredMinPeriodNSecs());
+
+    // Blocks which haven't been executed yet are assumed to be cheap
+    step.load = std::max(step.hook->getDurationAvgNSecs(), RTT::nsecs(1000));
+
+    // Newly-active blocks will be due on the next cycle
+    step.phase = 0;
+    if(step.rate_divisor > 0) {
+      if(was_active[step.index]) {
+        step.phase = phases[step.index] % step.rate_divisor;
+      } else {
+        step.phase = execution_plan_.cycle % step.rate_divisor;
+      }
+    }
+
+    plan.steps.push_back(step);
+  }
+
+  // Group the steps by level (this is still a topological ordering)
+  std::stable_sort(plan.steps.begin(), plan.steps.end(), &StepLevelLess);
+
+  for(size_t i=0; i < plan.steps.size(); i++) {
+    if(i == 0 || plan.steps[i].level != plan.steps[i-1].level) {
+      plan.level_offsets.push_back(i);
+    }
+  }
+  plan.level_offsets.push_back(plan.steps.size());
+
+  // Positions of each block in the sorted plan, indexed by vertex index
+  std::vector<unsigned int> positions(block_indices_.size(), 0);
+  for(size_t i=0; i < plan.steps.size(); i++) {
+    positions[plan.steps[i].index] = i;
+  }
+
+  // Store the ESG successors of each step so that executors can track when
+  // a block's inputs are ready without touching the graph
+  for(size_t i=0; i < plan.steps.size(); i++) {
+    plan.successor_offsets.push_back(plan.successors.size());
+
+    this->getExecNeighbors(block_indices_[plan.steps[i].index], true, neighbors);
+    for(size_t n=0; n < neighbors.size(); n++) {
+      const unsigned int target_index = neighbors[n];
+      if(target_index != plan.steps[i].index && target_index < positions.size() && active[target_index]) {
+        plan.successors.push_back(positions[target_index]);
+        plan.steps[positions[target_index]].n_predecessors++;
+      }
+    }
+  }
+  plan.successor_offsets.push_back(plan.successors.size());
+
+  // Spread the newly-active blocks across the phases
+  if(balance_phases_) {
+    std::vector<bool> pinned(plan.steps.size(), false);
+    for(size_t i=0; i < plan.steps.size(); i++) {
+      pinned[i] = was_active[plan.steps[i].index];
+    }
+    plan.balancePhases(pinned, max_hyperperiod_);
+  }
+
+  // Precompute the blocks which are due in each slot of the hyperperiod
+  if(!plan.computeSlots(max_hyperperiod_)) {
+    RTT::log(RTT::Warning) << "The hyperperiod of the scheme's block rates "
+      "is longer than " << max_hyperperiod_ << " cycles, so block rates will "
+      "be checked every cycle." << RTT::endlog();
+  }
+}
+
+void Scheme::publishExecutionPlan()
+{
+  execution_plan_.swap(pending_plan_);
+  plan_pending_ = false;
+
+  // The new plan doesn't have any deferred blocks
+  n_deferred_steps_ = 0;
+  n_running_blocks_ = execution_plan_.steps.size();
+
+  // Let the parallel executor prepare for the new plan
+  if(executor_) {
+    executor_->configure(execution_plan_);
+  }
+}
+
+bool Scheme::auditExecutionPlan()
+{
+  bool stale;
+
+  {
+    RTT::os::MutexLock lock(plan_mutex_);
+    stale = this->isPlanStale();
+  }
+
+  if(stale) {
+    this->compileExecutionPlan();
+  }
+
+  return stale;
+}
+
+bool Scheme::isPlanStale() const
+{
+  using namespace conman::graph;
+
+  // Check for blocks which have been started or stopped outside of the scheme
+  size_t n_running = 0;
+
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = block_indices_.begin();
+      it != block_indices_.end();
+      ++it)
+  {
+    if((*it)->block->getTaskState() == RTT::TaskContext::Running) {
+      n_running++;
+    }
+  }
+
+  // The most recently compiled plan, which might not be published yet
+  const ExecutionPlan &latest_plan = plan_pending_ ? pending_plan_ : execution_plan_;
+
+  // Rates are compiled from the periods at the time the plan was built
+  const RTT::nsecs period = SecondsToNSecs(this->getPeriod());
+
+  bool stale =
+    n_running != latest_plan.steps.size() ||
+    period != latest_plan.period;
+
+  for(std::vector<ExecutionStep>::const_iterator it = latest_plan.steps.begin();
+      !stale && it != latest_plan.steps.end();
+      ++it)
+  {
+    stale =
+      it->block->getTaskState() != RTT::TaskContext::Running ||
+      it->rate_divisor != ExecutionPlan::RateDivisor(period, it->hook->getDesiredMinPeriodNSecs());
+  }
+
+  return stale;
+}
+
+/** \brief Periodic low-priority thread which audits a running scheme
+ *
+ * Each period, this only compares the latest execution plan with the blocks.
+ * When the plan is stale, it sends the scheme's auditExecutionPlan operation,
+ * so the plan is recompiled by the scheme's own thread between two cycles.
+ * The plan lock is only held for the comparison, so at worst this delays the
+ * publication of a new plan by one cycle.
+ */
+class Scheme::Auditor : public RTT::os::Thread
+{
+public:
+  Auditor(Scheme *scheme, const RTT::Seconds period) :
+    RTT::os::Thread(ORO_SCHED_OTHER, RTT::os::LowestPriority, period, ~0, scheme->getName() + "_auditor"),
+    scheme_(scheme),
+    audit_(scheme->getOperation("auditExecutionPlan"))
+  { }
+
+protected:
+  virtual void step()
+  {
+    // Don't queue another audit until the last one has been handled
+    if(pending_.ready() && pending_.collectIfDone() == RTT::SendNotReady) {
+      return;
+    }
+
+    bool stale;
+
+    {
+      RTT::os::MutexLock lock(scheme_->plan_mutex_);
+      stale = scheme_->isPlanStale();
+    }
+
+    if(stale) {
+      pending_ = audit_.send();
+    }
+  }
+
+private:
+  Scheme *scheme_;
+  RTT::OperationCaller<bool(void)> audit_;
+  RTT::SendHandle<bool(void)> pending_;
+};
+
+bool Scheme::startAuditor()
+{
+  RTT::Logger::In in("Scheme::startAuditor");
+
+  this->stopAuditor();
+
+  if(audit_period_ <= 0.0) {
+    return true;
+  }
+
+  auditor_ = new Auditor(this, audit_period_);
+
+  if(!auditor_->start()) {
+    RTT::log(RTT::Error) << "Could not start the audit thread." << RTT::endlog();
+    this->stopAuditor();
+    return false;
+  }
+
+  return true;
+}
+
+void Scheme::stopAuditor()
+{
+  if(auditor_) {
+    auditor_->stop();
+    delete auditor_;
+    auditor_ = NULL;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Scheme::enableBlock(const std::string &block_name, const bool force)
+{
+  RTT::Logger::In in("Scheme::enableBlock");
+
+  // First check if this block is a group
+  boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+    group_handles_.find(block_name);
+
+  if(group != group_handles_.end()) {
+    // Enable the blocks in this group
+    RTT::log(RTT::Debug) << "Enabling blocks in group \"" << block_name <<"\"" << RTT::endlog();
+    marked_blocks_ = group_members_[group->second];
+    return this->enableMarkedBlocks(true, force);
+  }
+
+  // Enable the block by name
+  return this->enableBlock(this->getPeer(block_name), force);
+}
+
+bool Scheme::enableBlock(RTT::TaskContext *block, const bool force)
+{
+  using namespace conman::graph;
+
+  RTT::Logger::In in("Scheme::enableBlock");
+
+  if(block == NULL) {
+    RTT::log(RTT::Error) << "Could not enable block because the given block is NULL." << RTT::endlog();
+    return false;
+  }
+
+  const std::string &block_name = block->getName();
+  boost::unordered_map<std::string,conman::graph::DataFlowVertex::Ptr>::const_iterator block_vertex_it = blocks_.find(block_name);
+
+  RTT::log(RTT::Debug) << "Enabling block \"" << block_name <<"\"" << RTT::endlog();
 
   if(block_vertex_it == blocks_.end()) {
     RTT::log(RTT::Error) << "Could not enable block \""<< block_name << "\""
@@ -1527,311 +3335,1380 @@ bool Scheme::enableBlock(RTT::TaskContext *block, const bool force)
     return false;
   }
 
-  DataFlowVertex::Ptr block_vertex = block_vertex_it->second;
-
-  // Make sure the block is configured
-  if(!block->isConfigured()) {
-    RTT::log(RTT::Error) << "Could not enable block \""<< block_name << "\""
-      " because it has not been confiugre()ed." << RTT::endlog();
+  return this->enableVertex(block_vertex_it->second, force);
+}
+
+bool Scheme::enableVertex(
+    const conman::graph::DataFlowVertex::Ptr &block_vertex,
+    const bool force)
+{
+  RTT::TaskContext *block = block_vertex->block;
+  const std::string &block_name = block->getName();
+
+  // Make sure the block is configured
+  if(!block->isConfigured()) {
+    RTT::log(RTT::Error) << "Could not enable block \""<< block_name << "\""
+      " because it has not been confiugre()ed." << RTT::endlog();
+    return false;
+  }
+
+  // Blocks in standby are already running, but they still need to be checked
+  // for conflicts before they're promoted
+  const bool standby = this->isStandby(block_vertex);
+
+  // Check if the block is already enabled
+  if(!standby && block->getTaskState() == RTT::TaskContext::Running) {
+    // If it's already running, then we're going to assume for now that the
+    // user isn't doing anything dirty.
+    // TODO: Keep track of whether or not a block has been properly enabled.
+    RTT::log(RTT::Debug) << "The block \"" << block_name <<"\" is already enabled." << RTT::endlog();
+    return true;
+  }
+
+  // Check if conflicting blocks are running
+  RTT::TaskContext *conflict_block = NULL;
+
+  while((conflict_block = this->getRunningConflict(block_vertex->index)) != NULL)
+  {
+    // If force is selected, disable the conflicting block
+    if(force) {
+      RTT::log(RTT::Info) << "Force-enabling block \""<< block_name << "\""
+        " involves disabling block \"" << conflict_block->getName() << "\""
+        << RTT::endlog();
+
+      // Make sure we can actually disable it
+      if(this->disableBlock(conflict_block) == false) {
+        RTT::log(RTT::Error) << "Could not disable block \"" <<
+          conflict_block->getName() << "\"" << RTT::endlog();
+        return false;
+      }
+    } else {
+      RTT::log(RTT::Error) << "Could not enable block \""<< block_name <<
+        "\" because it conflicts with block \"" << conflict_block->getName()
+        << "\"" << RTT::endlog();
+      return false;
+    }
+  }
+
+  // Try to start the block
+  if(!this->startVertex(block_vertex)) {
+    return false;
+  }
+
+  // Pick up the block's current desired period in the execution plan (a
+  // block in standby is already in it)
+  if(!standby) {
+    this->compileExecutionPlan();
+  }
+
+  return true;
+}
+
+bool Scheme::startVertex(const conman::graph::DataFlowVertex::Ptr &block_vertex)
+{
+  RTT::TaskContext *block = block_vertex->block;
+
+  // Promote a block in standby by letting its outputs through
+  if(this->isStandby(block_vertex)) {
+    block_vertex->gate->open();
+    running_blocks_.set(block_vertex->index);
+    return true;
+  }
+
+  // Initialize the hook
+  block_vertex->hook_service->init(RTT::nsecs_to_Seconds(last_update_time_));
+
+  // Try to start the block
+  if(!block->start()) {
+    RTT::log(RTT::Error) << "Could not enable block \""<< block->getName() << "\""
+      " because it could not be start()ed." << RTT::endlog();
+    return false;
+  }
+
+  running_blocks_.set(block_vertex->index);
+
+  return true;
+}
+
+bool Scheme::disableBlock(const std::string &block_name)
+{
+  // First check if this block is a group
+  boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+    group_handles_.find(block_name);
+
+  if(group != group_handles_.end()) {
+    // Disable the blocks in this group
+    marked_blocks_ = group_members_[group->second];
+    return this->disableMarkedBlocks(true, false);
+  }
+
+  // Disable the block by name
+  return this->disableBlock(this->getPeer(block_name));
+}
+
+bool Scheme::disableBlock(RTT::TaskContext* block)
+{
+  if(block == NULL) { return false; }
+
+  // Keep track of the blocks in the scheme
+  graph::DataFlowVertexTaskMap::const_iterator vertex_it = flow_vertex_map_.find(block);
+  if(vertex_it != flow_vertex_map_.end()) {
+    return this->disableVertex(flow_graph_[vertex_it->second]);
+  }
+
+  // Stop a block
+  if(block->isRunning()) {
+    if(!block->stop()) {
+      RTT::log(RTT::Error)
+        << "Could not disable block \""<< block->getName() << "\" because it"
+        " could not be stop()ed." << RTT::endlog();
+      return false;
+    }
+
+    // Reset the block's phase in the execution plan
+    this->compileExecutionPlan();
+  }
+
+  return true;
+}
+
+bool Scheme::disableVertex(const conman::graph::DataFlowVertex::Ptr &block_vertex)
+{
+  // Stop a block
+  if(block_vertex->block->isRunning()) {
+    if(!this->stopVertex(block_vertex)) {
+      return false;
+    }
+
+    // Reset the block's phase in the execution plan
+    this->compileExecutionPlan();
+  } else {
+    // The block may have been stopped outside of the scheme
+    running_blocks_.reset(block_vertex->index);
+  }
+
+  return true;
+}
+
+bool Scheme::stopVertex(
+    const conman::graph::DataFlowVertex::Ptr &block_vertex,
+    const bool clear_gate)
+{
+  RTT::TaskContext *block = block_vertex->block;
+
+  if(!block->stop()) {
+    RTT::log(RTT::Error)
+      << "Could not disable block \""<< block->getName() << "\" because it"
+      " could not be stop()ed." << RTT::endlog();
+    return false;
+  }
+
+  running_blocks_.reset(block_vertex->index);
+
+  // Restore the original connections of a block which was in standby
+  if(clear_gate && block_vertex->gate) {
+    block_vertex->gate->clear();
+  }
+
+  return true;
+}
+
+bool Scheme::isStandby(const conman::graph::DataFlowVertex::Ptr &block_vertex) const
+{
+  return block_vertex->gate && !block_vertex->gate->isOpen();
+}
+
+bool Scheme::standbyBlock(const std::string &block_name)
+{
+  using namespace conman::graph;
+
+  RTT::Logger::In in("Scheme::standbyBlock");
+
+  boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator block_vertex_it =
+    blocks_.find(block_name);
+
+  if(block_vertex_it == blocks_.end()) {
+    RTT::log(RTT::Error) << "Could not put block \""<< block_name << "\" in"
+      " standby because it has not been added to the scheme." << RTT::endlog();
+    return false;
+  }
+
+  const DataFlowVertex::Ptr &block_vertex = block_vertex_it->second;
+  RTT::TaskContext *block = block_vertex->block;
+
+  // Make sure the block is configured
+  if(!block->isConfigured()) {
+    RTT::log(RTT::Error) << "Could not put block \""<< block_name << "\" in"
+      " standby because it has not been configure()ed." << RTT::endlog();
+    return false;
+  }
+
+  // The gate and the pipeline's relays would both splice into the same
+  // connections
+  if(dynamic_cast<PipelineExecutor*>(executor_)) {
+    DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+    for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(flow_vertex_map_[block], flow_graph_);
+        out_edge_it != out_edge_end;
+        ++out_edge_it)
+    {
+      const unsigned int sink = flow_graph_[boost::target(*out_edge_it, flow_graph_)]->index;
+
+      if(flow_graph_[*out_edge_it]->latched &&
+         stage_of_index_[block_vertex->index] != stage_of_index_[sink])
+      {
+        RTT::log(RTT::Error) << "Could not put block \""<< block_name << "\" in"
+          " standby because its connections are relayed between pipeline"
+          " stages." << RTT::endlog();
+        return false;
+      }
+    }
+  }
+
+  if(!block_vertex->gate) {
+    block_vertex->gate.reset(new OutputGate());
+  }
+
+  OutputGate &gate = *block_vertex->gate;
+
+  // Relay each of the block's output connections through the gate, unless
+  // it's already been promoted from standby
+  if(gate.empty()) {
+    DataFlowOutEdgeIterator out_edge_it, out_edge_end;
+    for(boost::tie(out_edge_it, out_edge_end) = boost::out_edges(flow_vertex_map_[block], flow_graph_);
+        out_edge_it != out_edge_end;
+        ++out_edge_it)
+    {
+      const DataFlowVertex::Ptr sink_vertex = flow_graph_[boost::target(*out_edge_it, flow_graph_)];
+
+      // The block's own feedback keeps its state consistent
+      if(sink_vertex == block_vertex) {
+        continue;
+      }
+
+      const DataFlowEdge::Ptr &edge = flow_graph_[*out_edge_it];
+
+      for(std::vector<DataFlowEdge::Connection>::const_iterator conn_it = edge->connections.begin();
+          conn_it != edge->connections.end();
+          ++conn_it)
+      {
+        if(!gate.addRelay(
+              dynamic_cast<RTT::base::OutputPortInterface*>(conn_it->source_port),
+              dynamic_cast<RTT::base::InputPortInterface*>(conn_it->sink_port)))
+        {
+          RTT::log(RTT::Error) << "Could not put block \""<< block_name << "\""
+            " in standby because its connection to \"" <<
+            sink_vertex->block->getName() << "\" could not be relayed." <<
+            RTT::endlog();
+          gate.clear();
+          return false;
+        }
+      }
+    }
+  }
+
+  // Hold back the block's outputs
+  gate.close();
+
+  // Start the block with its outputs held back
+  if(block->getTaskState() != RTT::TaskContext::Running) {
+    block_vertex->hook_service->init(RTT::nsecs_to_Seconds(last_update_time_));
+
+    if(!block->start()) {
+      RTT::log(RTT::Error) << "Could not put block \""<< block_name << "\" in"
+        " standby because it could not be start()ed." << RTT::endlog();
+      gate.clear();
+      return false;
+    }
+  }
+
+  // Add the block's gate to the execution plan
+  this->compileExecutionPlan();
+
+  return true;
+}
+
+bool Scheme::inStandby(const std::string &block_name) const
+{
+  boost::unordered_map<std::string, conman::graph::DataFlowVertex::Ptr>::const_iterator block_vertex_it =
+    blocks_.find(block_name);
+
+  return block_vertex_it != blocks_.end() && this->isStandby(block_vertex_it->second);
+}
+
+bool Scheme::enableable(
+    const std::string &block_name) const
+{
+  using namespace conman::graph;
+
+  boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group;
+
+  // Make sure the block is in the scheme
+  if(this->hasBlock(block_name)) {
+    // Check if conflicting blocks are running
+    if(this->getRunningConflict(this->getBlockVertex(block_name)->index) != NULL) {
+      return false;
+    }
+  } else if((group = group_handles_.find(block_name)) != group_handles_.end()) {
+    // Enable a group
+    if(!this->enableable(group_members_[group->second])) {
+      return false;
+    }
+  } else {
+    RTT::log(RTT::Error) << "Could not check block or group for conflicts named \"" << block_name << "\" because it is not in the scheme." << RTT::endlog();
+  }
+
+  return true;
+}
+
+bool Scheme::enableBlocks(
+    const std::vector<std::string> &unordered,
+    const bool strict,
+    const bool force)
+{
+  this->markBlocks(unordered);
+
+  return this->enableMarkedBlocks(strict, force);
+}
+
+bool Scheme::disableBlocks(const bool strict)
+{
+  bool success = true;
+
+  for(boost::unordered_map<std::string,graph::DataFlowVertex::Ptr>::const_iterator it = blocks_.begin();
+      it != blocks_.end();
+      ++it)
+  {
+    // Try to disable the block
+    success &= this->disableBlock(it->second->block);
+
+    // Break on failure if strict
+    if(!success && strict) { return false; }
+  }
+
+  return success;
+}
+
+bool Scheme::disableBlocks(
+    const std::vector<std::string> &unordered,
+    const bool strict,
+    const bool inverse)
+{
+  this->markBlocks(unordered);
+
+  return this->disableMarkedBlocks(strict, inverse);
+}
+
+
+bool Scheme::switchBlocks(
+    const std::vector<std::string> &disable_block_names,
+    const std::vector<std::string> &enable_block_names,
+    const bool strict,
+    const bool force)
+{
+
+  bool success = true;
+
+  for(std::vector<std::string>::const_iterator it = disable_block_names.begin();
+      it != disable_block_names.end();
+      ++it)
+  {
+    // Don't disable a blcok that's about to be enabled
+    if(std::find(enable_block_names.begin(), enable_block_names.end(), *it) == enable_block_names.end()) {
+      // Try to disable the block
+      success &= this->disableBlock(*it);
+
+      // Break on failure if strict
+      if(!success && strict) { return false; }
+    }
+  }
+
+  // First disable blocks, so that "force" can be used appropriately when
+  // enabling blocks.
+  success = success && this->enableBlocks(enable_block_names, strict, force);
+
+  return success;
+}
+
+bool Scheme::setEnabledBlocks(
+    const std::vector<std::string> &enabled_block_names,
+    const bool strict)
+{
+  bool disable_success = this->disableBlocks(enabled_block_names, strict, true /*inverse*/);
+  bool enable_success = this->enableBlocks(enabled_block_names, strict, false);
+
+  return disable_success && enable_success;
+}
+
+bool Scheme::enableable(
+    const std::vector<conman::BlockHandle> &handles)
+  const
+{
+  if(!this->validHandles(handles)) {
+    return false;
+  }
+
+  for(std::vector<conman::BlockHandle>::const_iterator it = handles.begin();
+      it != handles.end();
+      ++it)
+  {
+    if(conflict_matrix_[*it].intersects(running_blocks_)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Scheme::enableable(
+    const conman::BlockSet &blocks)
+  const
+{
+  for(conman::BlockSet::size_type i = blocks.find_first();
+      i != conman::BlockSet::npos;
+      i = blocks.find_next(i))
+  {
+    if(conflict_matrix_[i].intersects(running_blocks_)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Scheme::enableBlocks(
+    const std::vector<conman::BlockHandle> &handles,
+    const bool strict,
+    const bool force)
+{
+  if(!this->validHandles(handles)) {
+    return false;
+  }
+
+  this->markHandles(handles);
+
+  return this->enableMarkedBlocks(strict, force);
+}
+
+bool Scheme::disableBlocks(
+    const std::vector<conman::BlockHandle> &handles,
+    const bool strict,
+    const bool inverse)
+{
+  if(!this->validHandles(handles)) {
+    return false;
+  }
+
+  this->markHandles(handles);
+
+  return this->disableMarkedBlocks(strict, inverse);
+}
+
+void Scheme::markBlocks(const std::vector<std::string> &names)
+{
+  // Flatten the groups into blocks
+  for(std::vector<std::string>::const_iterator it = names.begin();
+      it != names.end();
+      ++it)
+  {
+    boost::unordered_map<std::string, graph::DataFlowVertex::Ptr>::const_iterator block =
+      blocks_.find(*it);
+
+    if(block != blocks_.end()) {
+      marked_blocks_.set(block->second->index);
+      continue;
+    }
+
+    boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+      group_handles_.find(*it);
+
+    if(group != group_handles_.end()) {
+      marked_blocks_ |= group_members_[group->second];
+    }
+  }
+}
+
+bool Scheme::enableMarkedBlocks(const bool strict, const bool force)
+{
+  using namespace conman::graph;
+
+  // First make sure all the blocks can be enabled before actually trying to enable them
+  if(!force && !this->enableable(marked_blocks_)) {
+    RTT::log(RTT::Error) << "Could not enable block because it has conflicts which will not be force-disabled." << RTT::endlog();
+    marked_blocks_.reset();
+    return false;
+  }
+
+  bool success = true;
+
+  if(force) {
+    // Get all of the running blocks which conflict with these blocks
+    disabled_blocks_.reset();
+    for(BlockSet::size_type i = marked_blocks_.find_first();
+        i != BlockSet::npos;
+        i = marked_blocks_.find_next(i))
+    {
+      disabled_blocks_ |= conflict_matrix_[i];
+    }
+    disabled_blocks_ &= running_blocks_;
+
+    // Disable them in reverse execution order
+    for(std::vector<DataFlowVertex::Ptr>::const_reverse_iterator it = exec_blocks_.rbegin();
+        disabled_blocks_.any() && it != exec_blocks_.rend();
+        ++it)
+    {
+      const DataFlowVertex::Ptr &block_vertex = *it;
+
+      if(disabled_blocks_[block_vertex->index]) {
+        RTT::log(RTT::Info) << "Force-enabling blocks involves disabling"
+          " block \"" << block_vertex->block->getName() << "\"" << RTT::endlog();
+
+        if(!this->disableVertex(block_vertex)) {
+          RTT::log(RTT::Error) << "Could not disable block \"" <<
+            block_vertex->block->getName() << "\"" << RTT::endlog();
+          marked_blocks_.reset();
+          return false;
+        }
+      }
+    }
+  }
+
+  // Enable the marked blocks in execution order
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = exec_blocks_.begin();
+      it != exec_blocks_.end();
+      ++it)
+  {
+    const DataFlowVertex::Ptr &block_vertex = *it;
+
+    if(marked_blocks_[block_vertex->index]) {
+      // Try to start the block
+      success = this->enableVertex(block_vertex, force) && success;
+
+      // Break on failure if strict
+      if(!success && strict) { break; }
+    }
+  }
+
+  marked_blocks_.reset();
+
+  return success;
+}
+
+bool Scheme::disableMarkedBlocks(const bool strict, const bool inverse)
+{
+  using namespace conman::graph;
+
+  bool success = true;
+
+  // Disable the marked (or unmarked) blocks in reverse execution order
+  for(std::vector<DataFlowVertex::Ptr>::const_reverse_iterator it = exec_blocks_.rbegin();
+      it != exec_blocks_.rend();
+      ++it)
+  {
+    const DataFlowVertex::Ptr &block_vertex = *it;
+
+    if(inverse ^ marked_blocks_[block_vertex->index]) {
+      // Try to disable the block
+      success &= this->disableVertex(block_vertex);
+
+      // Break on failure if strict
+      if(!success && strict) { break; }
+    }
+  }
+
+  marked_blocks_.reset();
+
+  return success;
+}
+
+bool Scheme::switchBlocks(
+    const std::vector<conman::BlockHandle> &disable_handles,
+    const std::vector<conman::BlockHandle> &enable_handles,
+    const bool strict,
+    const bool force)
+{
+  if(!this->validHandles(disable_handles) || !this->validHandles(enable_handles)) {
+    return false;
+  }
+
+  bool success = true;
+
+  // Don't disable blocks that are about to be enabled
+  this->markHandles(enable_handles);
+
+  for(std::vector<conman::BlockHandle>::const_iterator it = disable_handles.begin();
+      it != disable_handles.end();
+      ++it)
+  {
+    if(!marked_blocks_[*it]) {
+      // Try to disable the block
+      success &= this->disableVertex(block_indices_[*it]);
+
+      // Break on failure if strict
+      if(!success && strict) { break; }
+    }
+  }
+
+  marked_blocks_.reset();
+
+  // First disable blocks, so that "force" can be used appropriately when
+  // enabling blocks.
+  return success && this->enableBlocks(enable_handles, strict, force);
+}
+
+bool Scheme::setEnabledBlocks(
+    const std::vector<conman::BlockHandle> &enabled_handles,
+    const bool strict)
+{
+  bool disable_success = this->disableBlocks(enabled_handles, strict, true /*inverse*/);
+  bool enable_success = this->enableBlocks(enabled_handles, strict, false);
+
+  return disable_success && enable_success;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool Scheme::defineMode(
+    const std::string &mode_name,
+    const std::vector<std::string> &block_names)
+{
+  RTT::Logger::In in("Scheme::defineMode");
+
+  CompiledMode mode;
+  mode.name = mode_name;
+  mode.block_names = block_names;
+
+  // Make sure the mode can be used before keeping it
+  if(!this->compileMode(mode, false)) {
+    RTT::log(RTT::Error) << "Could not define mode \"" << mode_name << "\"."
+      << RTT::endlog();
+    return false;
+  }
+
+  boost::unordered_map<std::string, conman::ModeHandle>::const_iterator handle =
+    mode_handles_.find(mode_name);
+
+  if(handle != mode_handles_.end()) {
+    // Redefine an existing mode
+    modes_[handle->second] = mode;
+
+    // Recompile a requested switch to this mode
+    RTT::os::MutexLock lock(plan_mutex_);
+    if(switch_pending_ && mode_switch_.handle == handle->second) {
+      this->compileModeSwitch(handle->second, false);
+    }
+  } else {
+    mode_handles_[mode_name] = modes_.size();
+    modes_.push_back(mode);
+  }
+
+  return true;
+}
+
+bool Scheme::removeMode(const std::string &mode_name)
+{
+  RTT::Logger::In in("Scheme::removeMode");
+
+  boost::unordered_map<std::string, conman::ModeHandle>::iterator handle =
+    mode_handles_.find(mode_name);
+
+  if(handle == mode_handles_.end()) {
+    RTT::log(RTT::Error) << "Could not remove mode \"" << mode_name << "\""
+      " because it does not exist." << RTT::endlog();
+    return false;
+  }
+
+  // The handle of a requested switch would be renumbered
+  RTT::os::MutexLock lock(plan_mutex_);
+  if(switch_pending_) {
+    RTT::log(RTT::Error) << "Could not remove mode \"" << mode_name << "\""
+      " because a mode switch is pending." << RTT::endlog();
+    return false;
+  }
+
+  // Renumber the modes after the removed one
+  const conman::ModeHandle removed = handle->second;
+  modes_.erase(modes_.begin() + removed);
+  mode_handles_.erase(handle);
+
+  for(conman::ModeHandle i = removed; i < modes_.size(); i++) {
+    mode_handles_[modes_[i].name] = i;
+  }
+
+  return true;
+}
+
+bool Scheme::hasMode(const std::string &mode_name) const
+{
+  return mode_handles_.find(mode_name) != mode_handles_.end();
+}
+
+std::vector<std::string> Scheme::getModes() const
+{
+  std::vector<std::string> mode_names;
+  mode_names.reserve(modes_.size());
+
+  for(std::vector<CompiledMode>::const_iterator it = modes_.begin();
+      it != modes_.end();
+      ++it)
+  {
+    mode_names.push_back(it->name);
+  }
+
+  return mode_names;
+}
+
+bool Scheme::getModeHandle(
+    const std::string &mode_name,
+    conman::ModeHandle &handle) const
+{
+  boost::unordered_map<std::string, conman::ModeHandle>::const_iterator it =
+    mode_handles_.find(mode_name);
+
+  if(it == mode_handles_.end()) {
+    return false;
+  }
+
+  handle = it->second;
+  return true;
+}
+
+bool Scheme::switchMode(const std::string &mode_name)
+{
+  conman::ModeHandle handle;
+
+  if(!this->getModeHandle(mode_name, handle)) {
+    RTT::log(RTT::Error) << "Could not switch to mode \"" << mode_name << "\""
+      " because it does not exist." << RTT::endlog();
+    return false;
+  }
+
+  return this->switchMode(handle);
+}
+
+bool Scheme::switchMode(const conman::ModeHandle handle)
+{
+  RTT::Logger::In in("Scheme::switchMode");
+
+  RTT::os::MutexLock lock(plan_mutex_);
+
+  if(!this->compileModeSwitch(handle, false)) {
+    return false;
+  }
+
+  return this->applyModeSwitch();
+}
+
+bool Scheme::requestMode(const conman::ModeHandle handle)
+{
+  RTT::Logger::In in("Scheme::requestMode");
+
+  // Compile the switch here so that the scheme only has to apply it
+  RTT::os::MutexLock lock(plan_mutex_);
+
+  if(!this->compileModeSwitch(handle, false)) {
+    return false;
+  }
+
+  switch_pending_ = true;
+
+  return true;
+}
+
+bool Scheme::requestMode(const std::string &mode_name)
+{
+  conman::ModeHandle handle;
+
+  if(!this->getModeHandle(mode_name, handle)) {
+    RTT::log(RTT::Error) << "Could not request mode \"" << mode_name << "\""
+      " because it does not exist." << RTT::endlog();
+    return false;
+  }
+
+  return this->requestMode(handle);
+}
+
+bool Scheme::compileModeSwitch(const conman::ModeHandle handle, const bool quiet)
+{
+  using namespace conman::graph;
+
+  if(handle >= modes_.size()) {
+    if(!quiet) {
+      RTT::log(RTT::Error) << "Could not switch to mode " << handle <<
+        " because it does not exist." << RTT::endlog();
+    }
+    return false;
+  }
+
+  const CompiledMode &mode = modes_[handle];
+
+  if(!mode.valid) {
+    if(!quiet) {
+      RTT::log(RTT::Error) << "Could not switch to mode \"" << mode.name << "\""
+        " because it can't be used with the current blocks." << RTT::endlog();
+    }
+    return false;
+  }
+
+  mode_switch_.handle = handle;
+  mode_switch_.stop_order.clear();
+  mode_switch_.start_order.clear();
+  mode_switch_.promoted = conman::BlockSet(block_indices_.size());
+
+  // Blocks in standby keep running, whether or not they're in the mode
+  std::vector<bool> active(block_indices_.size(), false);
+
+  for(std::vector<DataFlowVertex::Ptr>::const_reverse_iterator it = exec_blocks_.rbegin();
+      it != exec_blocks_.rend();
+      ++it)
+  {
+    const DataFlowVertex::Ptr &block_vertex = *it;
+
+    if(mode.blocks[block_vertex->index]) {
+      active[block_vertex->index] = true;
+    } else if(this->isStandby(block_vertex)) {
+      active[block_vertex->index] = block_vertex->block->isRunning();
+    } else if(block_vertex->block->isRunning()) {
+      // Disable the running blocks which aren't in the mode in reverse
+      // execution order
+      mode_switch_.stop_order.push_back(block_vertex);
+    }
+  }
+
+  // Enable the blocks in the mode which aren't running in execution order
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = mode.start_order.begin();
+      it != mode.start_order.end();
+      ++it)
+  {
+    if(!(*it)->block->isRunning() || this->isStandby(*it)) {
+      mode_switch_.start_order.push_back(*it);
+      mode_switch_.promoted[(*it)->index] = this->isStandby(*it);
+    }
+  }
+
+  this->buildExecutionPlan(active, mode_switch_.plan);
+
+  // Allocate the executor's buffers for the plan which will be published
+  if(executor_) {
+    executor_->prepare(mode_switch_.plan);
+  }
+
+  return true;
+}
+
+bool Scheme::applyModeSwitch()
+{
+  using namespace conman::graph;
+
+  const RTT::nsecs switch_start = timer_.getNSecs();
+
+  switch_pending_ = false;
+
+  bool success = true;
+
+  // Keep track of the blocks which have been switched so that they can be
+  // restored if the switch fails
+  disabled_blocks_.reset();
+  marked_blocks_.reset();
+
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = mode_switch_.stop_order.begin();
+      success && it != mode_switch_.stop_order.end();
+      ++it)
+  {
+    // An open gate passes the block's samples through, so its connections
+    // can be restored later, outside of the real-time path
+    if((*it)->block->isRunning()) {
+      success = this->stopVertex(*it, false);
+      disabled_blocks_[(*it)->index] = success;
+    }
+  }
+
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = mode_switch_.start_order.begin();
+      success && it != mode_switch_.start_order.end();
+      ++it)
+  {
+    if(!(*it)->block->isRunning() || this->isStandby(*it)) {
+      success = this->startVertex(*it);
+      marked_blocks_[(*it)->index] = success;
+    }
+  }
+
+  if(success) {
+    // Publish the plan which was compiled for the switch
+    pending_plan_.swap(mode_switch_.plan);
+    this->publishExecutionPlan();
+  } else {
+    RTT::log(RTT::Error) << "Could not completely switch to mode \"" <<
+      modes_[mode_switch_.handle].name << "\", so the switch has been rolled"
+      " back." << RTT::endlog();
+
+    // Undo the switch in reverse order, and keep the current plan
+    for(std::vector<DataFlowVertex::Ptr>::const_reverse_iterator it = mode_switch_.start_order.rbegin();
+        it != mode_switch_.start_order.rend();
+        ++it)
+    {
+      if(marked_blocks_[(*it)->index]) {
+        if(mode_switch_.promoted[(*it)->index]) {
+          // Put a promoted block back into standby
+          (*it)->gate->close();
+        } else {
+          (*it)->block->stop();
+        }
+        running_blocks_.reset((*it)->index);
+      }
+    }
+
+    for(std::vector<DataFlowVertex::Ptr>::const_reverse_iterator it = mode_switch_.stop_order.rbegin();
+        it != mode_switch_.stop_order.rend();
+        ++it)
+    {
+      if(disabled_blocks_[(*it)->index]) {
+        this->startVertex(*it);
+      }
+    }
+  }
+
+  disabled_blocks_.reset();
+  marked_blocks_.reset();
+
+  // Update the switch statistics
+  last_switch_duration_ = timer_.getNSecs(switch_start);
+  max_switch_duration_ = std::max(max_switch_duration_, last_switch_duration_);
+  switch_count_++;
+
+  return success;
+}
+
+bool Scheme::compileMode(CompiledMode &mode, const bool quiet)
+{
+  using namespace conman::graph;
+
+  mode.blocks = conman::BlockSet(block_indices_.size());
+  mode.start_order.clear();
+  mode.valid = false;
+
+  // Flatten the blocks and groups in the mode
+  for(std::vector<std::string>::const_iterator it = mode.block_names.begin();
+      it != mode.block_names.end();
+      ++it)
+  {
+    boost::unordered_map<std::string, DataFlowVertex::Ptr>::const_iterator block =
+      blocks_.find(*it);
+    boost::unordered_map<std::string, conman::GroupHandle>::const_iterator group =
+      group_handles_.find(*it);
+
+    if(block != blocks_.end()) {
+      mode.blocks.set(block->second->index);
+    } else if(group != group_handles_.end()) {
+      mode.blocks |= group_members_[group->second];
+    } else {
+      if(!quiet) {
+        RTT::log(RTT::Error) << "Mode \"" << mode.name << "\" refers to \"" <<
+          *it << "\", which is not a block or group in the scheme." << RTT::endlog();
+      }
+      return false;
+    }
+  }
+
+  // Make sure the blocks in the mode can run together
+  for(BlockSet::size_type i = mode.blocks.find_first();
+      i != BlockSet::npos;
+      i = mode.blocks.find_next(i))
+  {
+    if(conflict_matrix_[i].intersects(mode.blocks)) {
+      if(!quiet) {
+        RTT::log(RTT::Error) << "Mode \"" << mode.name << "\" contains block \""
+          << block_indices_[i]->block->getName() << "\" and a block which"
+          " conflicts with it." << RTT::endlog();
+      }
+      return false;
+    }
+  }
+
+  // Start the blocks in execution order
+  mode.start_order.reserve(mode.blocks.count());
+  for(std::vector<DataFlowVertex::Ptr>::const_iterator it = exec_blocks_.begin();
+      it != exec_blocks_.end();
+      ++it)
+  {
+    if(mode.blocks[(*it)->index]) {
+      mode.start_order.push_back(*it);
+    }
+  }
+
+  if(mode.start_order.size() != mode.blocks.count()) {
+    if(!quiet) {
+      RTT::log(RTT::Error) << "Mode \"" << mode.name << "\" can't be used"
+        " because the scheme has no valid execution ordering." << RTT::endlog();
+    }
     return false;
   }
 
-  // Check if the block is already enabled
-  if(block->getTaskState() == RTT::TaskContext::Running) {
-    // If it's already running, then we're going to assume for now that the
-    // user isn't doing anything dirty.
-    // TODO: Keep track of whether or not a block has been properly enabled.
-    RTT::log(RTT::Debug) << "The block \"" << block_name <<"\" is already enabled." << RTT::endlog();
-    return true;
-  }
-
-  // Get the blocks that conflict with this block
-  ConflictAdjacencyIterator conflict_it, conflict_end;
+  mode.valid = true;
 
-  boost::tie(conflict_it, conflict_end) =
-    boost::adjacent_vertices(conflict_vertex_map_[block], conflict_graph_);
+  return true;
+}
 
-  // Check if conflicting blocks are running
-  for(; conflict_it != conflict_end; ++conflict_it)
+void Scheme::compileModes()
+{
+  for(std::vector<CompiledMode>::iterator it = modes_.begin();
+      it != modes_.end();
+      ++it)
   {
-    RTT::TaskContext *&conflict_block = conflict_graph_[*conflict_it]->block;
+    // Only complain about modes which were usable before
+    if(!this->compileMode(*it, !it->valid)) {
+      RTT::log(RTT::Debug) << "Mode \"" << it->name << "\" can't be used." << RTT::endlog();
+    }
+  }
+}
 
-    // Check if the conflicting block is running
-    if(conflict_block->getTaskState() == RTT::TaskContext::Running) {
-      // If force is selected, disable the conflicting block
-      if(force) {
-        RTT::log(RTT::Info) << "Force-enabling block \""<< block_name << "\""
-          " involves disabling block \"" << conflict_block->getName() << "\""
-          << RTT::endlog();
+///////////////////////////////////////////////////////////////////////////////
 
-        // Make sure we can actually disable it
-        if(this->disableBlock(conflict_block) == false) {
-          RTT::log(RTT::Error) << "Could not disable block \"" <<
-            conflict_block->getName() << "\"" << RTT::endlog();
-          return false;
-        }
-      } else {
-        RTT::log(RTT::Error) << "Could not enable block \""<< block_name <<
-          "\" because it conflicts with block \"" << conflict_block->getName()
-          << "\"" << RTT::endlog();
-        return false;
-      }
-    }
+bool Scheme::configureHook()
+{
+  return true;
+}
+
+bool Scheme::startHook()
+{
+  // The model isn't complete until the transaction is committed
+  if(in_transaction_) {
+    RTT::log(RTT::Error) << "Scheme can't be started with an open transaction." << RTT::endlog();
+    return false;
   }
 
-  // Initialize the hook
-  block_vertex->hook->init(last_update_time_);
+  // Pick up any connections which were made since the blocks were added
+  if(!this->refreshModel()) {
+    return false;
+  }
 
-  // Try to start the block
-  if(!block->start()) {
-    RTT::log(RTT::Error) << "Could not enable block \""<< block_name << "\""
-      " because it could not be start()ed." << RTT::endlog();
+  if(!timer_.setSource(timer_source_)) {
     return false;
   }
 
-  return true;
-}
+  // The topology can't change while running, so flatten the graphs
+  this->freezeModel();
 
-bool Scheme::disableBlock(const std::string &block_name)
-{
-  // First check if this block is a group
-  boost::unordered_map<std::string, boost::unordered_set<std::string> >::iterator group =
-    block_groups_.find(block_name);
+  if(!this->startExecutor()) {
+    model_frozen_ = false;
+    compact_model_.clear();
+    return false;
+  }
 
-  if(group != block_groups_.end()) {
-    // Enable the blocks in this group
-    return this->disableBlocks(
-        std::vector<std::string>(group->second.begin(),group->second.end()),
-        true);
+  // Pick up blocks which are started or stopped outside of the scheme
+  if(!this->startAuditor()) {
+    this->stopExecutor();
+    model_frozen_ = false;
+    compact_model_.clear();
+    return false;
   }
 
-  // Disable the block by name
-  return this->disableBlock(this->getPeer(block_name));
+  return true;
 }
 
-bool Scheme::disableBlock(RTT::TaskContext* block)
+void Scheme::stopHook()
 {
-  if(block == NULL) { return false; }
+  this->stopAuditor();
+  this->stopExecutor();
 
-  // Stop a block
-  if(block->isRunning()) {
-    if(!block->stop()) {
-      RTT::log(RTT::Error)
-        << "Could not disable block \""<< block->getName() << "\" because it"
-        " could not be stop()ed." << RTT::endlog();
-      return false;
-    }
-  }
+  // Blocks can be added and removed again
+  model_frozen_ = false;
+  compact_model_.clear();
 
-  return true;
+  // Publish any plan which was compiled after the last cycle
+  RTT::os::MutexLock lock(plan_mutex_);
+  if(plan_pending_) {
+    this->publishExecutionPlan();
+  }
 }
 
-bool Scheme::enableable(
-    const std::string &block_name) const
+bool Scheme::startExecutor()
 {
-  using namespace conman::graph;
+  RTT::Logger::In in("Scheme::startExecutor");
 
-  // Make sure the block is in the scheme
-  if(this->hasBlock(block_name)) {
-    // Get the blocks that conflict with this block
-    ConflictAdjacencyIterator conflict_it, conflict_end;
+  this->stopExecutor();
 
-    boost::tie(conflict_it, conflict_end) =
-      boost::adjacent_vertices(
-          this->getConflictVertex(
-              this->getBlockVertex(block_name)->block), conflict_graph_);
+  if(execution_mode_ == ExecutionMode::SERIAL) {
+    return true;
+  }
 
-    // Check if conflicting blocks are running
-    for(; conflict_it != conflict_end; ++conflict_it)
-    {
-      RTT::TaskContext *&conflict_block = conflict_graph_[*conflict_it]->block;
+  // The executors only measure the whole cycle against the budget
+  if(overrun_policy_ != OverrunPolicy::EVENT) {
+    RTT::log(RTT::Error) << "Overrun policy " << overrun_policy_ << " is only "
+      "supported in SERIAL execution mode." << RTT::endlog();
+    return false;
+  }
 
-      // Check if the conflicting block is running
-      if(conflict_block->getTaskState() == RTT::TaskContext::Running) {
+  switch(execution_mode_) {
+    case ExecutionMode::WAVEFRONT:
+      executor_ = new WavefrontExecutor(this->getName(), timer_);
+      break;
+    case ExecutionMode::WORK_STEALING:
+      executor_ = new WorkStealingExecutor(this->getName(), timer_);
+      break;
+    case ExecutionMode::PIPELINE:
+      executor_ = new PipelineExecutor(this->getName(), timer_);
+      if(!this->startPipeline(static_cast<PipelineExecutor*>(executor_))) {
+        this->stopExecutor();
         return false;
       }
-    }
-  } else if(this->hasGroup(block_name)) {
-    // Enable a group
-    if(!this->enableable(this->getGroupMembers(block_name))) {
+      break;
+    default:
+      RTT::log(RTT::Error) << "Unknown execution mode: " << execution_mode_ << RTT::endlog();
       return false;
-    }
-  } else {
-    RTT::log(RTT::Error) << "Could not check block or group for conflicts named \"" << block_name << "\" because it is not in the scheme." << RTT::endlog();
+  };
+
+  // Create the workers with the same scheduling parameters as the scheme,
+  // pinned to their own CPUs since all of the executors spin-wait
+  RTT::os::ThreadInterface *thread = this->getActivity()->thread();
+
+  if(!executor_->startWorkers(
+        n_workers_,
+        thread->getScheduler(),
+        thread->getPriority(),
+        worker_cpu_affinity_,
+        true))
+  {
+    RTT::log(RTT::Error) << "Could not start " << n_workers_ << " worker threads." << RTT::endlog();
+    this->stopExecutor();
+    return false;
   }
 
+  // Recompile the plan so that it's annotated with any pipeline stages
+  this->compileExecutionPlan();
+
   return true;
 }
 
-bool Scheme::enableBlocks(
-    const std::vector<std::string> &unordered,
-    const bool strict,
-    const bool force)
+bool Scheme::startPipeline(PipelineExecutor *executor)
 {
   using namespace conman::graph;
 
-  // Flatten the groups into block names
-  boost::unordered_set<std::string> flattened;
+  RTT::Logger::In in("Scheme::startPipeline");
 
-  for(std::vector<std::string>::const_iterator it=unordered.begin();
-      it!=unordered.end();
-      ++it)
+  // Partition the ESG into weakly-connected components, which are only
+  // connected to each other by latched edges
+  std::vector<unsigned int> parents(block_indices_.size());
+  for(unsigned int i=0; i < parents.size(); i++) {
+    parents[i] = i;
+  }
+
+  boost::graph_traits<DataFlowGraph>::edge_iterator edge_it, edge_end;
+  for(boost::tie(edge_it, edge_end) = boost::edges(exec_graph_);
+      edge_it != edge_end;
+      ++edge_it)
   {
-    if(this->hasBlock(*it)) {
-      flattened.insert(flattened.end(), *it);
-    } else if(this->hasGroup(*it)) {
-      const std::vector<std::string> members = this->getGroupMembers(*it);
-      flattened.insert(members.begin(), members.end());
-    }
+    unsigned int
+      source = exec_graph_[boost::source(*edge_it, exec_graph_)]->index,
+      sink = exec_graph_[boost::target(*edge_it, exec_graph_)]->index;
+
+    while(parents[source] != source) { source = parents[source]; }
+    while(parents[sink] != sink) { sink = parents[sink]; }
+    parents[sink] = source;
   }
 
-  // First make sure all the blocks can be enabled before actually trying to enable them
-  if(!force) {
-    if(!this->enableable(flattened)) {
-      RTT::log(RTT::Error) << "Could not enable block because it has conflicts which will not be force-disabled." << RTT::endlog();
-      return false;
+  // Number the stages in execution order
+  std::vector<unsigned int> positions(block_indices_.size(), 0);
+  std::vector<int> root_stages(block_indices_.size(), -1);
+  unsigned int n_stages = 0;
+  unsigned int position = 0;
+
+  stage_of_index_.assign(block_indices_.size(), 0);
+
+  for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
+      it != exec_ordering_.end();
+      ++it, ++position)
+  {
+    const unsigned int index = exec_graph_[*it]->index;
+    unsigned int root = index;
+    while(parents[root] != root) { root = parents[root]; }
+
+    if(root_stages[root] < 0) {
+      root_stages[root] = n_stages++;
     }
+
+    stage_of_index_[index] = root_stages[root];
+    positions[index] = position;
   }
 
-  // Enable the blocks
-  bool success = true;
+  // Relay the connections between stages, and compute the number of cycles
+  // of latency that the relays add to each block's inputs; latched
+  // connections which go backwards in the execution order already deliver
+  // data from the previous cycle
+  std::vector<int> latencies(block_indices_.size(), 0);
 
-  //Goes through all blocks in execution order, if that block is also
-  //in list of blocks to enable, it is put in the new ordered vector
   for(ExecutionOrdering::const_iterator it = exec_ordering_.begin();
       it != exec_ordering_.end();
       ++it)
   {
-    const std::string &block_name = flow_graph_[*it]->block->getName();
-    if(std::find(flattened.begin(), flattened.end(), block_name) != flattened.end())
+    RTT::TaskContext *sink_block = exec_graph_[*it]->block;
+    const DataFlowVertexDescriptor flow_sink = flow_vertex_map_[sink_block];
+    const unsigned int sink = flow_graph_[flow_sink]->index;
+
+    DataFlowInEdgeIterator in_edge_it, in_edge_end;
+    for(boost::tie(in_edge_it, in_edge_end) = boost::in_edges(flow_sink, flow_graph_);
+        in_edge_it != in_edge_end;
+        ++in_edge_it)
     {
-      // Try to start the block
-      success = this->enableBlock(block_name,force) && success;
+      const DataFlowEdge::Ptr &edge = flow_graph_[*in_edge_it];
+      const unsigned int source = flow_graph_[boost::source(*in_edge_it, flow_graph_)]->index;
 
-      // Break on failure if strict
-      if(!success && strict) { return false; }
+      if(source == sink) {
+        continue;
+      }
+
+      if(!edge->latched || stage_of_index_[source] == stage_of_index_[sink]) {
+        // The source executes before the sink in the same cycle
+        if(!edge->latched || positions[source] < positions[sink]) {
+          latencies[sink] = std::max(latencies[sink], latencies[source]);
+        }
+        continue;
+      }
+
+      if(positions[source] < positions[sink]) {
+        latencies[sink] = std::max(latencies[sink], latencies[source] + 1);
+      }
+
+      // A block's gate might have already spliced into its connections
+      const DataFlowVertex::Ptr &source_vertex = flow_graph_[boost::source(*in_edge_it, flow_graph_)];
+      if(source_vertex->gate && !source_vertex->gate->empty()) {
+        if(source_vertex->block->isRunning()) {
+          RTT::log(RTT::Error) << "Could not relay the connection from \"" <<
+            source_vertex->block->getName() << "\" to \"" <<
+            sink_block->getName() << "\" because its outputs are gated for"
+            " standby." << RTT::endlog();
+          return false;
+        }
+
+        // The block was stopped by a mode switch
+        source_vertex->gate->clear();
+      }
+
+      for(std::vector<DataFlowEdge::Connection>::const_iterator conn_it = edge->connections.begin();
+          conn_it != edge->connections.end();
+          ++conn_it)
+      {
+        PortRelay *relay = new PortRelay(
+            dynamic_cast<RTT::base::OutputPortInterface*>(conn_it->source_port),
+            dynamic_cast<RTT::base::InputPortInterface*>(conn_it->sink_port));
+
+        if(relay->getSource() == NULL || relay->getSink() == NULL || !relay->connect()) {
+          RTT::log(RTT::Error) << "Could not relay the connection from \"" <<
+            flow_graph_[boost::source(*in_edge_it, flow_graph_)]->block->getName() <<
+            "\" to \"" << sink_block->getName() << "\"." << RTT::endlog();
+          delete relay;
+          return false;
+        }
+
+        executor->addRelay(relay);
+      }
     }
   }
 
-  return success;
+  stage_latencies_.assign(n_stages, 0);
+  for(unsigned int i=0; i < block_indices_.size(); i++) {
+    stage_latencies_[stage_of_index_[i]] = std::max(stage_latencies_[stage_of_index_[i]], latencies[i]);
+  }
+
+  RTT::log(RTT::Info) << "Partitioned the scheme into " << n_stages <<
+    " pipeline stages." << RTT::endlog();
+
+  return true;
 }
 
-bool Scheme::disableBlocks(const bool strict)
+std::vector<std::string> Scheme::getBlockPhases() const
 {
-  bool success = true;
+  std::vector<std::string> phases;
 
-  for(boost::unordered_map<std::string,graph::DataFlowVertex::Ptr>::const_iterator it = blocks_.begin();
-      it != blocks_.end();
+  for(std::vector<ExecutionStep>::const_iterator it = execution_plan_.steps.begin();
+      it != execution_plan_.steps.end();
       ++it)
   {
-    // Try to disable the block
-    success &= this->disableBlock(it->second->block);
-
-    // Break on failure if strict
-    if(!success && strict) { return false; }
+    phases.push_back(
+        it->block->getName() + " " +
+        boost::lexical_cast<std::string>(it->phase) + "/" +
+        boost::lexical_cast<std::string>(it->rate_divisor));
   }
 
-  return success;
+  return phases;
 }
 
-bool Scheme::disableBlocks(
-    const std::vector<std::string> &unordered,
-    const bool strict,
-    const bool inverse)
+bool Scheme::setInstrumentation(
+    const unsigned int level,
+    const unsigned int sample_period)
 {
-  using namespace conman::graph;
+  RTT::Logger::In in("Scheme::setInstrumentation");
 
-  bool success = true;
+  if(level > Instrumentation::FULL || sample_period == 0) {
+    RTT::log(RTT::Error) << "Invalid instrumentation level " << level <<
+      " with sample period " << sample_period << RTT::endlog();
+    return false;
+  }
 
-  // Flatten the groups into block names
-  boost::unordered_set<std::string> flattened;
+  instrumentation_ = level;
+  instrumentation_sample_period_ = sample_period;
+  sample_countdown_ = 1;
 
-  for(std::vector<std::string>::const_iterator it=unordered.begin();
-      it!=unordered.end();
+  for(boost::unordered_map<std::string,conman::graph::DataFlowVertex::Ptr>::const_iterator it = blocks_.begin();
+      it != blocks_.end();
       ++it)
   {
-    if(this->hasBlock(*it)) {
-      flattened.insert(flattened.end(), *it);
-    } else if(this->hasGroup(*it)) {
-      const std::vector<std::string> members = this->getGroupMembers(*it);
-      flattened.insert(members.begin(), members.end());
-    }
+    it->second->hook_service->setInstrumentation(level, sample_period);
   }
 
-  for(ExecutionOrdering::const_reverse_iterator it = exec_ordering_.rbegin();
-      it != exec_ordering_.rend();
-      ++it)
-  {
-    const std::string &block_name = flow_graph_[*it]->block->getName();
-    if(inverse ^ std::find(flattened.begin(), flattened.end(), block_name) != flattened.end())
-    {
-      // Try to disable the block
-      success &= this->disableBlock(block_name);
+  return true;
+}
 
-      // Break on failure if strict
-      if(!success && strict) { return false; }
+std::vector<double> Scheme::getSlotLoads() const
+{
+  std::vector<RTT::nsecs> slot_loads;
+  execution_plan_.getSlotLoads(slot_loads);
 
-    }
+  std::vector<double> loads(slot_loads.size());
+  for(size_t i=0; i < slot_loads.size(); i++) {
+    loads[i] = RTT::nsecs_to_Seconds(slot_loads[i]);
   }
 
-  return success;
+  return loads;
 }
 
-
-bool Scheme::switchBlocks(
-    const std::vector<std::string> &disable_block_names,
-    const std::vector<std::string> &enable_block_names,
-    const bool strict,
-    const bool force)
+std::vector<double> Scheme::getWorkerUtilization() const
 {
+  std::vector<double> utilization;
 
-  bool success = true;
-
-  for(std::vector<std::string>::const_iterator it = disable_block_names.begin();
-      it != disable_block_names.end();
-      ++it)
-  {
-    // Don't disable a blcok that's about to be enabled
-    if(std::find(enable_block_names.begin(), enable_block_names.end(), *it) == enable_block_names.end()) {
-      // Try to disable the block
-      success &= this->disableBlock(*it);
-
-      // Break on failure if strict
-      if(!success && strict) { return false; }
-    }
+  if(executor_) {
+    executor_->getUtilization(utilization);
   }
 
-  // First disable blocks, so that "force" can be used appropriately when
-  // enabling blocks.
-  success = success && this->enableBlocks(enable_block_names, strict, force);
-
-  return success;
+  return utilization;
 }
 
-bool Scheme::setEnabledBlocks(
-    const std::vector<std::string> &enabled_block_names,
-    const bool strict)
+void Scheme::stopExecutor()
 {
-  bool disable_success = this->disableBlocks(enabled_block_names, strict, true /*inverse*/);
-  bool enable_success = this->enableBlocks(enabled_block_names, strict, false);
+  if(executor_) {
+    executor_->stopWorkers();
+    delete executor_;
+    executor_ = NULL;
+  }
 
-  return disable_success && enable_success;
+  stage_of_index_.clear();
+  stage_latencies_.clear();
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-bool Scheme::configureHook()
+std::vector<double> Scheme::getStageLoads() const
 {
-  return true;
+  std::vector<double> loads;
+
+  PipelineExecutor *pipeline = dynamic_cast<PipelineExecutor*>(executor_);
+  if(pipeline) {
+    pipeline->getStageLoads(loads);
+  }
+
+  return loads;
 }
 
-bool Scheme::startHook()
+std::vector<int> Scheme::getStageLatencies() const
 {
-  if(!this->regenerateModel()) {
-    return false;
-  } else {
-    return true;
-  }
+  return stage_latencies_;
 }
 
 void Scheme::updateHook()
@@ -1841,41 +4718,149 @@ void Scheme::updateHook()
   RTT::Logger::In in("Scheme::updateHook");
 
   // What time is it
-  RTT::os::TimeService::nsecs now = RTT::os::TimeService::Instance()->getNSecs();
-  RTT::os::TimeService::Seconds
-    time = RTT::nsecs_to_Seconds(now),
-    period = RTT::nsecs_to_Seconds(RTT::os::TimeService::Instance()->getNSecs(last_update_time_));
+  const RTT::os::TimeService::nsecs now = RTT::os::TimeService::Instance()->getNSecs();
+
+  // Durations are measured with the cheaper timer if one has been selected
+  const RTT::os::TimeService::nsecs cycle_start =
+    (timer_.getSource() == TimerSource::RTT) ? now : timer_.getNSecs();
 
   // Store update time
   last_update_time_ = now;
 
+  // Apply the most recently requested mode switch before any blocks are
+  // executed, so that its plan is published in this cycle (it was compiled
+  // when it was requested)
+  if(switch_pending_) {
+    RTT::os::MutexTryLock trylock(plan_mutex_);
+    if(trylock.isSuccessful() && switch_pending_ && this->applyModeSwitch()) {
+      last_switch_time_ = now;
+      switch_time_out_.write(now);
+    }
+  }
+
+  // Publish a newly-compiled plan at the cycle boundary, without waiting for
+  // a thread which is still compiling it
+  if(plan_pending_) {
+    RTT::os::MutexTryLock trylock(plan_mutex_);
+    if(trylock.isSuccessful() && plan_pending_) {
+      this->publishExecutionPlan();
+    }
+  }
+
   // Compute statistics describing how often update is being called
-  last_exec_period_ = time - last_exec_time_;
-  last_exec_time_ = time;
-  min_exec_period_ = std::min(min_exec_period_,last_exec_period_);
-  max_exec_period_ = std::max(max_exec_period_,last_exec_period_);
+  last_exec_period_ns_ = now - last_exec_time_ns_;
+  last_exec_time_ns_ = now;
 
-  // Execute the blocks in the appropriate order
-  for(ExecutionOrdering::iterator block_it = exec_ordering_.begin();
-      block_it != exec_ordering_.end();
-      ++block_it)
-  {
-    // Temporary variable for readability
-    DataFlowVertex::Ptr block_vertex = flow_graph_[*block_it];
+  bool sample = (instrumentation_ == Instrumentation::FULL);
+  if(instrumentation_ == Instrumentation::SAMPLED && --sample_countdown_ == 0) {
+    sample_countdown_ = std::max(instrumentation_sample_period_, 1U);
+    sample = true;
+  }
+
+  if(sample) {
+    last_exec_period_ = RTT::nsecs_to_Seconds(last_exec_period_ns_);
+    min_exec_period_ = std::min(min_exec_period_,last_exec_period_);
+    max_exec_period_ = std::max(max_exec_period_,last_exec_period_);
+  }
+
+  // Set when the cycle budget has been exceeded
+  bool overrun = false;
+  // The most recent timer reading, passed from one block to the next
+  RTT::nsecs timestamp = 0;
 
-    // Get the state of the task
-    const RTT::base::TaskCore::TaskState block_state = block_vertex->block->getTaskState();
+  if(executor_) {
+    // Execute the blocks in parallel if an executor has been started
+    if(!executor_->execute(now)) {
+      // Signal an error
+      this->error();
+    }
+  } else if(execution_plan_.hyperperiod > 0 && n_deferred_steps_ == 0) {
+    // Only visit the blocks which are due in this slot
+    const unsigned int slot = execution_plan_.cycle % execution_plan_.hyperperiod;
 
-    // Check if the task is running
-    if(block_state == RTT::TaskContext::Running) {
+    for(unsigned int i = execution_plan_.slot_offsets[slot];
+        i < execution_plan_.slot_offsets[slot+1];
+        i++)
+    {
+      if(!this->executeStep(execution_plan_.steps[execution_plan_.slot_steps[i]], now, cycle_start, timestamp, overrun)) {
+        // Signal an error
+        this->error();
+      }
+    }
+  } else {
+    // Visit every block, since some might have been deferred
+    for(std::vector<ExecutionStep>::iterator step = execution_plan_.steps.begin();
+        step != execution_plan_.steps.end();
+        ++step)
+    {
+      if(!step->deferred && !step->isDue(execution_plan_.cycle)) {
+        continue;
+      }
 
-      // Update the task
-      if(!block_vertex->hook->update(time)) {
+      if(!this->executeStep(*step, now, cycle_start, timestamp, overrun)) {
         // Signal an error
         this->error();
       }
     }
   }
+
+  // Check the duration of the whole cycle against the budget
+  if(cycle_budget_ > 0) {
+    const RTT::os::TimeService::nsecs duration = timer_.getNSecs(cycle_start);
+
+    if(duration > cycle_budget_) {
+      const RTT::nsecs overrun_duration = duration - cycle_budget_;
+      overrun_count_++;
+      worst_overrun_ = std::max(worst_overrun_, overrun_duration);
+      overrun_out_.write(overrun_duration);
+    }
+  }
+
+  execution_plan_.cycle++;
+}
+
+bool Scheme::executeStep(
+    ExecutionStep &step,
+    const RTT::os::TimeService::nsecs time,
+    const RTT::os::TimeService::nsecs cycle_start,
+    RTT::nsecs &timestamp,
+    bool &overrun)
+{
+  // Hold back non-critical blocks once the cycle budget has been exceeded
+  if(cycle_budget_ > 0 && step.criticality < Criticality::CRITICAL) {
+    if(!overrun) {
+      // Reuse the reading taken when the previous block finished
+      if(timestamp == 0) {
+        timestamp = timer_.getNSecs();
+      }
+      overrun = timestamp - cycle_start > cycle_budget_;
+    }
+
+    if(overrun && overrun_policy_ != OverrunPolicy::EVENT) {
+      // Blocks whose hooks decide when to run will run as soon as possible
+      // anyway, so only blocks with fixed rates need to be deferred
+      if(overrun_policy_ == OverrunPolicy::DEFER
+         && step.rate_divisor > 0
+         && !step.deferred)
+      {
+        step.deferred = true;
+        n_deferred_steps_++;
+      }
+      return true;
+    }
+  }
+
+  if(step.deferred) {
+    step.deferred = false;
+    n_deferred_steps_--;
+  }
+
+  // The caller has already determined whether or not fixed-rate blocks are due
+  if(step.rate_divisor > 0) {
+    return step.executeDue(time, timer_, timestamp);
+  } else {
+    return step.execute(time, execution_plan_.cycle, timer_, timestamp);
+  }
 }
 
 void Scheme::getConnectionDescriptions(
@@ -0,0 +1,84 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <conman/timer.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+using namespace conman;
+
+const TimerSource::Mode TimerSource::RTT;
+const TimerSource::Mode TimerSource::MONOTONIC_RAW;
+const TimerSource::Mode TimerSource::TSC;
+
+unsigned long long Timer::tsc_base_ = 0;
+RTT::nsecs Timer::ns_base_ = 0;
+unsigned long long Timer::tsc_mult_ = 0;
+
+bool Timer::setSource(const TimerSource::Mode source)
+{
+  RTT::Logger::In in("Timer::setSource");
+
+  switch(source) {
+    case TimerSource::RTT:
+    case TimerSource::MONOTONIC_RAW:
+      source_ = source;
+      return true;
+    case TimerSource::TSC:
+      // Only calibrate the first time the TSC is selected
+      if(tsc_mult_ > 0 || CalibrateTSC()) {
+        source_ = TimerSource::TSC;
+      } else {
+        RTT::log(RTT::Warning) << "The CPU timestamp counter isn't usable, "
+          "falling back to the raw monotonic clock." << RTT::endlog();
+        source_ = TimerSource::MONOTONIC_RAW;
+      }
+      return true;
+    default:
+      RTT::log(RTT::Error) << "Unknown timer source: " << source << RTT::endlog();
+      return false;
+  };
+}
+
+bool Timer::CalibrateTSC(const RTT::nsecs duration)
+{
+#if defined(__x86_64__)
+  // Check for an invariant TSC, which ticks at a constant rate regardless of
+  // frequency scaling and sleep states
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8))) {
+    return false;
+  }
+
+  // Measure the number of ticks in a known interval
+  const RTT::nsecs ns_start = ReadMonotonicRaw();
+  const unsigned long long tsc_start = ReadTSC();
+
+  RTT::nsecs ns_end = ns_start;
+  while(ns_end - ns_start < duration) {
+    ns_end = ReadMonotonicRaw();
+  }
+  const unsigned long long tsc_end = ReadTSC();
+
+  if(tsc_end <= tsc_start) {
+    return false;
+  }
+
+  tsc_mult_ = (static_cast<unsigned long long>(ns_end - ns_start) << 32) / (tsc_end - tsc_start);
+  tsc_base_ = tsc_end;
+  ns_base_ = ns_end;
+
+  return tsc_mult_ > 0;
+#else
+  return false;
+#endif
+}
+
+double Timer::GetTSCFrequency()
+{
+  return (tsc_mult_ > 0) ? 1E9 * 4294967296.0 / double(tsc_mult_) : 0.0;
+}
@@ -0,0 +1,116 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <cstdio>
+#include <string>
+
+#include <rtt/os/main.h>
+#include <rtt/Logger.hpp>
+#include <rtt/os/TimeService.hpp>
+
+#include <boost/lexical_cast.hpp>
+
+#include <conman/timer.h>
+
+/** \brief Microbenchmark for the cost of reading each conman timer source
+ *
+ * This measures the cost of each clock read, both for the raw clocks and
+ * through conman::Timer with each source selected. It also reports how far
+ * the calibrated timestamp counter drifts from the raw monotonic clock over
+ * the run.
+ *
+ * Usage: timer_benchmark [n_reads]
+ */
+
+//! Accumulated readings, so that the compiler can't discard the reads
+static volatile RTT::nsecs sink = 0;
+
+static void Report(
+    const std::string &name,
+    const RTT::nsecs elapsed,
+    const size_t n_reads)
+{
+  std::printf("  %-32s %8.2f ns/read\n",
+      name.c_str(),
+      double(elapsed) / double(n_reads));
+}
+
+//! Time a number of reads of the timer with the given source
+static void BenchmarkSource(
+    const std::string &name,
+    const conman::TimerSource::Mode source,
+    const size_t n_reads)
+{
+  conman::Timer timer;
+  timer.setSource(source);
+
+  if(timer.getSource() != source) {
+    std::printf("  %-32s unavailable\n", name.c_str());
+    return;
+  }
+
+  RTT::nsecs total = 0;
+  const RTT::nsecs start = conman::Timer::ReadMonotonicRaw();
+  for(size_t i=0; i < n_reads; i++) {
+    total += timer.getNSecs();
+  }
+  Report(name, conman::Timer::ReadMonotonicRaw() - start, n_reads);
+
+  sink = sink + total;
+}
+
+int ORO_main(int argc, char** argv)
+{
+  RTT::Logger::log().setLogLevel(RTT::Logger::Warning);
+
+  const size_t n_reads = (argc > 1) ? boost::lexical_cast<size_t>(argv[1]) : 10000000;
+
+  RTT::os::TimeService *time_service = RTT::os::TimeService::Instance();
+  RTT::nsecs start, total;
+
+  std::printf("Reading each clock %lu times:\n", (unsigned long)n_reads);
+
+  // The RTT TimeService
+  total = 0;
+  start = conman::Timer::ReadMonotonicRaw();
+  for(size_t i=0; i < n_reads; i++) {
+    total += time_service->getNSecs();
+  }
+  Report("TimeService::getNSecs", conman::Timer::ReadMonotonicRaw() - start, n_reads);
+  sink = sink + total;
+
+  // The raw monotonic clock
+  total = 0;
+  start = conman::Timer::ReadMonotonicRaw();
+  for(size_t i=0; i < n_reads; i++) {
+    total += conman::Timer::ReadMonotonicRaw();
+  }
+  Report("clock_gettime(MONOTONIC_RAW)", conman::Timer::ReadMonotonicRaw() - start, n_reads);
+  sink = sink + total;
+
+  // The raw timestamp counter
+  unsigned long long tsc_total = 0;
+  start = conman::Timer::ReadMonotonicRaw();
+  for(size_t i=0; i < n_reads; i++) {
+    tsc_total += conman::Timer::ReadTSC();
+  }
+  Report("rdtsc", conman::Timer::ReadMonotonicRaw() - start, n_reads);
+  sink = sink + tsc_total;
+
+  // Each source through the timer
+  BenchmarkSource("Timer::getNSecs (RTT)", conman::TimerSource::RTT, n_reads);
+  BenchmarkSource("Timer::getNSecs (MONOTONIC_RAW)", conman::TimerSource::MONOTONIC_RAW, n_reads);
+  BenchmarkSource("Timer::getNSecs (TSC)", conman::TimerSource::TSC, n_reads);
+
+  // Check the calibration against the raw monotonic clock
+  if(conman::Timer::GetTSCFrequency() > 0.0) {
+    const RTT::nsecs drift = conman::Timer::ReadNSecs(conman::TimerSource::TSC) - conman::Timer::ReadMonotonicRaw();
+    std::printf("TSC frequency: %.6f GHz, drift from MONOTONIC_RAW: %ld ns\n",
+        conman::Timer::GetTSCFrequency() / 1E9,
+        (long)drift);
+  }
+
+  return 0;
+}
@@ -0,0 +1,120 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <algorithm>
+
+#include <conman/wavefront_executor.h>
+
+using namespace conman;
+
+WavefrontExecutor::WavefrontExecutor(const std::string &name, const conman::Timer &timer) :
+  Executor(name, timer),
+  plan_(NULL),
+  time_(0),
+  cycle_(0),
+  failed_(0),
+  finished_(0)
+{
+}
+
+void WavefrontExecutor::prepare(const conman::ExecutionPlan &plan)
+{
+  prepared_next_.assign(plan.getNumLevels(), 0);
+  prepared_arrived_.assign(plan.getNumLevels(), 0);
+}
+
+void WavefrontExecutor::configure(conman::ExecutionPlan &plan)
+{
+  plan_ = &plan;
+
+  const unsigned int n_levels = plan.getNumLevels();
+
+  // Only allocate here if the plan wasn't prepared
+  if(prepared_next_.size() != n_levels) {
+    this->prepare(plan);
+  }
+
+  next_.swap(prepared_next_);
+  arrived_.swap(prepared_arrived_);
+
+  // The barrier counters are compared against the cycle count, so they are
+  // restarted along with it; no workers are running, since they have all
+  // finished the previous cycle
+  std::fill(arrived_.begin(), arrived_.end(), 0);
+  cycle_ = 0;
+  finished_ = 0;
+}
+
+bool WavefrontExecutor::execute(const RTT::nsecs time)
+{
+  if(plan_ == NULL) {
+    return true;
+  }
+
+  // Reset the claim counters for this cycle; no workers are running, since
+  // they have all finished the previous cycle
+  for(unsigned int level=0; level < next_.size(); level++) {
+    next_[level] = plan_->level_offsets[level];
+  }
+
+  time_ = time;
+  failed_ = 0;
+  cycle_++;
+  __sync_synchronize();
+
+  // Wake up the workers and participate in the execution
+  this->dispatch();
+  this->work(0);
+
+  // Wait for the workers to leave the final barrier, so that the counters
+  // can be reset or replaced before the next cycle
+  const unsigned int target = cycle_ * (this->getNumWorkers() + 1);
+  while(static_cast<int>(target - finished_) > 0) { }
+
+  __sync_synchronize();
+
+  return failed_ == 0;
+}
+
+void WavefrontExecutor::work(const unsigned int worker_id)
+{
+  const unsigned int n_levels = next_.size();
+  const unsigned int n_participants = this->getNumWorkers() + 1;
+  const unsigned int target = cycle_ * n_participants;
+  RTT::nsecs timestamp = 0;
+
+  for(unsigned int level=0; level < n_levels; level++) {
+    const unsigned int end = plan_->level_offsets[level+1];
+
+    // Claim and execute steps until the level is exhausted
+    while(true) {
+      const unsigned int i = __sync_fetch_and_add(&next_[level], 1);
+      if(i >= end) {
+        break;
+      }
+
+      if(!plan_->steps[i].execute(time_, plan_->cycle, timer_, timestamp)) {
+        failed_ = 1;
+      }
+    }
+
+    __sync_fetch_and_add(&arrived_[level], 1);
+    this->waitForLevel(level, target);
+    timestamp = 0;
+  }
+
+  __sync_fetch_and_add(&finished_, 1);
+}
+
+void WavefrontExecutor::waitForLevel(
+    const unsigned int level,
+    const unsigned int target)
+{
+  // The counters are monotonic, so compare them in a way that is robust to
+  // unsigned wrap-around
+  while(static_cast<int>(target - *static_cast<volatile unsigned int*>(&arrived_[level])) > 0) { }
+
+  __sync_synchronize();
+}
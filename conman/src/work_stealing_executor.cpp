@@ -0,0 +1,236 @@
+/** Copyright (c) 2013, Jonathan Bohren, all rights reserved.
+ * This software is released under the BSD 3-clause license, for the details of
+ * this license, please see LICENSE.txt at the root of this repository.
+ */
+
+#include <conman/work_stealing_executor.h>
+
+using namespace conman;
+
+void WorkStealingExecutor::Deque::push(const unsigned int step)
+{
+  const long b = bottom;
+  buffer[b] = step;
+  // Make sure the step is visible before thieves can see the new bottom
+  __sync_synchronize();
+  bottom = b + 1;
+}
+
+bool WorkStealingExecutor::Deque::pop(unsigned int &step)
+{
+  const long b = bottom - 1;
+  bottom = b;
+  __sync_synchronize();
+  const long t = top;
+
+  if(t > b) {
+    // The deque is empty
+    bottom = b + 1;
+    return false;
+  }
+
+  step = buffer[b];
+
+  if(t == b) {
+    // This is the last step, so race the thieves for it
+    const bool won = __sync_bool_compare_and_swap(&top, t, t + 1);
+    bottom = b + 1;
+    return won;
+  }
+
+  return true;
+}
+
+bool WorkStealingExecutor::Deque::steal(unsigned int &step)
+{
+  const long t = top;
+  __sync_synchronize();
+  const long b = bottom;
+
+  if(t >= b) {
+    return false;
+  }
+
+  // The owner can overwrite this slot by pushing after a pop, so the value is
+  // only used if the CAS on top shows that nobody else claimed it in the
+  // meantime (as in a Chase-Lev deque)
+  const unsigned int candidate = buffer[t];
+
+  if(!__sync_bool_compare_and_swap(&top, t, t + 1)) {
+    return false;
+  }
+
+  step = candidate;
+  return true;
+}
+
+WorkStealingExecutor::WorkStealingExecutor(const std::string &name, const conman::Timer &timer) :
+  Executor(name, timer),
+  plan_(NULL),
+  time_(0),
+  cycle_(0),
+  failed_(0),
+  remaining_(0),
+  finished_(0),
+  start_time_(0)
+{
+}
+
+void WorkStealingExecutor::prepare(const conman::ExecutionPlan &plan)
+{
+  const unsigned int n_participants = this->getNumWorkers() + 1;
+
+  // The number of participants only changes when the workers are started,
+  // which happens before the first plan is prepared
+  if(participants_.size() != n_participants) {
+    participants_.assign(n_participants, Participant());
+  }
+
+  prepared_pending_.assign(plan.steps.size(), 0);
+  prepared_buffers_.assign(n_participants, std::vector<unsigned int>(plan.steps.size(), 0));
+}
+
+void WorkStealingExecutor::configure(conman::ExecutionPlan &plan)
+{
+  plan_ = &plan;
+
+  // Only allocate here if the plan wasn't prepared
+  if(prepared_pending_.size() != plan.steps.size() ||
+     prepared_buffers_.size() != this->getNumWorkers() + 1)
+  {
+    this->prepare(plan);
+  }
+
+  // The completion counter is compared against the cycle count, so they are
+  // restarted together
+  cycle_ = 0;
+  finished_ = 0;
+
+  pending_.swap(prepared_pending_);
+
+  for(size_t i=0; i < participants_.size(); i++) {
+    participants_[i].deque.buffer.swap(prepared_buffers_[i]);
+    participants_[i].busy_time = 0;
+  }
+
+  start_time_ = timer_.getNSecs();
+}
+
+bool WorkStealingExecutor::execute(const RTT::nsecs time)
+{
+  if(plan_ == NULL || plan_->steps.empty()) {
+    return true;
+  }
+
+  const unsigned int n_participants = participants_.size();
+
+  // Reset the per-cycle state; no workers are running, since they have all
+  // finished the previous cycle
+  for(std::vector<Participant>::iterator it = participants_.begin();
+      it != participants_.end();
+      ++it)
+  {
+    it->deque.top = 0;
+    it->deque.bottom = 0;
+  }
+
+  unsigned int next_participant = 0;
+  for(unsigned int i=0; i < plan_->steps.size(); i++) {
+    pending_[i] = plan_->steps[i].n_predecessors;
+
+    // Distribute the blocks without predecessors among the participants
+    if(pending_[i] == 0) {
+      participants_[next_participant].deque.push(i);
+      next_participant = (next_participant + 1) % n_participants;
+    }
+  }
+
+  remaining_ = plan_->steps.size();
+  time_ = time;
+  failed_ = 0;
+  cycle_++;
+  __sync_synchronize();
+
+  // Wake up the workers and participate in the execution
+  this->dispatch();
+  this->work(0);
+
+  // Wait for the workers to stop touching the deques
+  const unsigned int target = cycle_ * n_participants;
+  while(static_cast<int>(target - finished_) > 0) { }
+
+  __sync_synchronize();
+
+  return failed_ == 0;
+}
+
+bool WorkStealingExecutor::getUtilization(std::vector<double> &utilization) const
+{
+  const RTT::nsecs elapsed = timer_.getNSecs(start_time_);
+
+  utilization.resize(participants_.size());
+
+  for(size_t i=0; i < participants_.size(); i++) {
+    utilization[i] = (elapsed > 0) ? double(participants_[i].busy_time) / double(elapsed) : 0.0;
+  }
+
+  return true;
+}
+
+void WorkStealingExecutor::work(const unsigned int worker_id)
+{
+  const unsigned int n_participants = participants_.size();
+  Deque &own_deque = participants_[worker_id].deque;
+  unsigned int step;
+
+  while(remaining_ > 0) {
+    // Execute ready steps from this participant's own deque first
+    if(own_deque.pop(step)) {
+      this->executeStep(worker_id, step);
+      continue;
+    }
+
+    // Try to steal a ready step from another participant
+    for(unsigned int offset=1; offset < n_participants; offset++) {
+      if(participants_[(worker_id + offset) % n_participants].deque.steal(step)) {
+        this->executeStep(worker_id, step);
+        break;
+      }
+    }
+  }
+
+  __sync_fetch_and_add(&finished_, 1);
+}
+
+void WorkStealingExecutor::executeStep(
+    const unsigned int worker_id,
+    const unsigned int step)
+{
+  Participant &participant = participants_[worker_id];
+
+  const RTT::nsecs start = timer_.getNSecs();
+
+  // The hook passes back its own reading of when the block finished, if it
+  // took one
+  RTT::nsecs timestamp = start;
+  if(!plan_->steps[step].execute(time_, plan_->cycle, timer_, timestamp)) {
+    failed_ = 1;
+  }
+
+  participant.busy_time += ((timestamp != 0) ? timestamp : timer_.getNSecs()) - start;
+
+  // Release the successors whose predecessors have all finished
+  for(unsigned int i = plan_->successor_offsets[step];
+      i < plan_->successor_offsets[step+1];
+      i++)
+  {
+    const unsigned int successor = plan_->successors[i];
+    if(__sync_sub_and_fetch(&pending_[successor], 1) == 0) {
+      participant.deque.push(successor);
+    }
+  }
+
+  // This must happen after the successors have been pushed, so that the
+  // other participants don't stop early
+  __sync_fetch_and_sub(&remaining_, 1);
+}
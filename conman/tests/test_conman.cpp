@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#include <unistd.h>
 
 #include <rtt/os/startstop.h>
 
@@ -21,6 +22,8 @@
 #include <conman/conman.h>
 #include <conman/scheme.h>
 #include <conman/hook.h>
+#include <conman/timer.h>
+#include <conman/feedback_arc_set.h>
 
 #include <boost/assign/std/vector.hpp>
 using namespace boost::assign;
@@ -65,6 +68,72 @@ public:
   boost::shared_ptr<conman::Hook> conman_hook_;
 };
 
+class CountingBlock : public RTT::TaskContext {
+public:
+  CountingBlock(const std::string &name) : RTT::TaskContext(name), count(0) { 
+    conman_hook_ = conman::Hook::GetHook(this);
+  }
+  void updateHook() { count++; }
+  boost::shared_ptr<conman::Hook> conman_hook_;
+  int count;
+};
+
+class ValueBlock : public RTT::TaskContext {
+public:
+  RTT::InputPort<double> in;
+  RTT::OutputPort<double> out;
+
+  ValueBlock(const std::string &name) : RTT::TaskContext(name), count(0), received(0.0) {
+    this->addPort("in",in);
+    this->addPort("out",out);
+
+    conman_hook_ = conman::Hook::GetHook(this);
+  }
+  void updateHook() {
+    count++;
+    out.write(count);
+
+    double value;
+    if(in.read(value) != RTT::NoData) {
+      received = value;
+    }
+  }
+  boost::shared_ptr<conman::Hook> conman_hook_;
+  int count;
+  double received;
+};
+
+class OrderBlock : public RTT::TaskContext {
+public:
+  RTT::InputPort<double> in1;
+  RTT::InputPort<double> in2;
+
+  RTT::OutputPort<double> out1;
+  RTT::OutputPort<double> out2;
+
+  OrderBlock(
+      const std::string &name,
+      std::vector<std::string> &log,
+      RTT::os::Mutex &log_mutex) :
+    RTT::TaskContext(name), log_(log), log_mutex_(log_mutex)
+  {
+    this->addPort("in1",in1);
+    this->addPort("in2",in2);
+
+    this->addPort("out1",out1);
+    this->addPort("out2",out2);
+
+    conman_hook_ = conman::Hook::GetHook(this);
+  }
+  void updateHook() {
+    RTT::os::MutexLock lock(log_mutex_);
+    log_.push_back(this->getName());
+  }
+  boost::shared_ptr<conman::Hook> conman_hook_;
+  std::vector<std::string> &log_;
+  RTT::os::Mutex &log_mutex_;
+};
+
 class SchemeTest : public ::testing::Test {
 protected:
   SchemeTest() : scheme("Scheme") { }
@@ -223,7 +292,8 @@ TEST_F(GroupsTest, AddToGroups) {
   EXPECT_TRUE(scheme.getGroupMembers("win",members_get));
   EXPECT_EQ(members_get.size(),2);
 
-  EXPECT_THAT(members_get, ElementsAre("vb2","vb1"));
+  // Members are listed in the order they were added to the scheme
+  EXPECT_THAT(members_get, ElementsAre("vb1","vb2"));
 }
 
 TEST_F(GroupsTest, NestedGroups) {
@@ -243,6 +313,44 @@ TEST_F(GroupsTest, NestedGroups) {
   EXPECT_EQ(members_get.size(),3);
 }
 
+TEST_F(GroupsTest, CachedMembers) {
+  conman::GroupHandle outer, inner;
+  conman::BlockSet member_set;
+  std::vector<conman::BlockHandle> members;
+
+  EXPECT_TRUE(scheme.setGroupMembers("inner","vb1"));
+  EXPECT_TRUE(scheme.setGroupMembers("outer","inner"));
+  EXPECT_TRUE(scheme.getGroupHandle("outer",outer));
+  EXPECT_TRUE(scheme.getGroupHandle("inner",inner));
+  EXPECT_FALSE(scheme.getGroupHandle("fail",inner));
+
+  EXPECT_TRUE(scheme.getGroupMembers(outer,member_set));
+  EXPECT_EQ(member_set.count(),1);
+  EXPECT_TRUE(member_set[0]);
+
+  // Changing a nested group changes the groups which contain it
+  EXPECT_TRUE(scheme.addToGroup("vb3","inner"));
+  EXPECT_TRUE(scheme.getGroupMembers(outer,members));
+  EXPECT_THAT(members, ElementsAre(0,2));
+
+  EXPECT_TRUE(scheme.removeFromGroup("vb1","inner"));
+  EXPECT_TRUE(scheme.getGroupMembers(outer,members));
+  EXPECT_THAT(members, ElementsAre(2));
+
+  // Removing a group removes it from the other groups
+  EXPECT_TRUE(scheme.removeGroup("inner"));
+  EXPECT_TRUE(scheme.getGroupHandle("outer",outer));
+  EXPECT_TRUE(scheme.getGroupMembers(outer,members));
+  EXPECT_EQ(members.size(),0);
+
+  // Removing a block renumbers the members
+  EXPECT_TRUE(scheme.setGroupMembers("inner","vb3"));
+  EXPECT_TRUE(scheme.getGroupHandle("inner",inner));
+  EXPECT_TRUE(scheme.removeBlock(&vb1));
+  EXPECT_TRUE(scheme.getGroupMembers(inner,members));
+  EXPECT_THAT(members, ElementsAre(1));
+}
+
 TEST_F(GroupsTest, RemoveFromGroups) {
   std::vector<std::string> members, members_get;
 
@@ -344,7 +452,29 @@ TEST_F(DataFlowTest, Cyclic) {
   ConnectBlocksCyclic();
   // At this point the model is out-of-sync with the actual DFG
   EXPECT_TRUE(scheme.executable());
-  scheme.regenerateModel();
+  scheme.refreshModel();
+  EXPECT_FALSE(scheme.executable());
+}
+
+TEST_F(DataFlowTest, IncrementalModel) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+  EXPECT_TRUE(scheme.executable());
+  // Add some cycles
+  ConnectBlocksCyclic();
+  // Only dirty blocks are rescanned
+  EXPECT_TRUE(scheme.regenerateModel());
+  EXPECT_TRUE(scheme.executable());
+  EXPECT_TRUE(scheme.markBlockDirty("iob5"));
+  EXPECT_FALSE(scheme.markBlockDirty("nonexistent"));
+  EXPECT_FALSE(scheme.regenerateModel());
+  EXPECT_FALSE(scheme.executable());
+
+  // Removing a block removes its connections from the model
+  EXPECT_TRUE(scheme.removeBlock("iob5"));
+  EXPECT_TRUE(scheme.executable());
+  scheme.addBlock(&iob5);
   EXPECT_FALSE(scheme.executable());
 }
 
@@ -367,6 +497,75 @@ TEST_F(DataFlowTest, GetCycles) {
   EXPECT_THAT(exec_cycles, ElementsAre(c1,c2,c3,c4));
 }
 
+TEST_F(DataFlowTest, CyclicComponents) {
+  std::vector<std::vector<std::string> > components, flow_cycles;
+
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+  EXPECT_EQ(0,scheme.getFlowCyclicComponents(components));
+  EXPECT_EQ(0,scheme.getExecutionCyclicComponents(components));
+  EXPECT_EQ(scheme.getCyclicBlocks().size(),0);
+
+  // Add some cycles
+  ConnectBlocksCyclic();
+  scheme.refreshModel();
+  EXPECT_EQ(1,scheme.getFlowCyclicComponents(components));
+  EXPECT_EQ(components[0].size(),5);
+  EXPECT_EQ(scheme.getCyclicBlocks().size(),5);
+
+  // Latching one connection removes iob1 from the remaining cycle
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob1",true));
+  EXPECT_EQ(1,scheme.getExecutionCyclicComponents(components));
+  EXPECT_EQ(components[0].size(),4);
+  EXPECT_EQ(1,scheme.getFlowCyclicComponents(components));
+  EXPECT_EQ(components[0].size(),5);
+
+  // Latching the other connection removes all execution cycles
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob2",true));
+  EXPECT_EQ(0,scheme.getExecutionCyclicComponents(components));
+  EXPECT_TRUE(scheme.executable());
+
+  // Cycle enumeration is bounded
+  scheme.properties()->getPropertyType<unsigned int>("max_cycles")->set(2);
+  EXPECT_EQ(2,scheme.getFlowCycles(flow_cycles));
+  scheme.properties()->getPropertyType<unsigned int>("max_cycles")->set(0);
+  EXPECT_EQ(4,scheme.getFlowCycles(flow_cycles));
+}
+
+TEST_F(DataFlowTest, LatchFeedback) {
+  std::vector<std::string> sources, sinks;
+  std::vector<std::vector<std::string> > exec_cycles;
+
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+  EXPECT_TRUE(scheme.computeFeedbackLatches(sources, sinks));
+  EXPECT_EQ(sources.size(),0);
+
+  // Add some cycles
+  ConnectBlocksCyclic();
+  scheme.refreshModel();
+  EXPECT_FALSE(scheme.executable());
+
+  // Make the feedback connections expensive to latch
+  EXPECT_TRUE(scheme.setLatchCost("iob5","iob1",10.0));
+  EXPECT_TRUE(scheme.setLatchCost("iob5","iob2",10.0));
+  EXPECT_FALSE(scheme.setLatchCost("iob2","iob1",1.0));
+  EXPECT_FALSE(scheme.setLatchCost("iob1","iob2",-1.0));
+
+  EXPECT_TRUE(scheme.computeFeedbackLatches(sources, sinks));
+  EXPECT_EQ(sources.size(),2);
+  EXPECT_EQ(sinks.size(),2);
+  EXPECT_TRUE(std::find(sources.begin(), sources.end(), "iob5") == sources.end());
+
+  // Apply the latches
+  EXPECT_TRUE(scheme.latchFeedback());
+  EXPECT_TRUE(scheme.executable());
+  EXPECT_EQ(0,scheme.getExecutionCycles(exec_cycles));
+  EXPECT_EQ(1,scheme.minLatchCount());
+}
+
 TEST_F(DataFlowTest, LatchConnections) {
   std::vector<std::vector<std::string> > flow_cycles, exec_cycles;
 
@@ -403,6 +602,49 @@ TEST_F(DataFlowTest, LatchConnections) {
   EXPECT_THAT(execution_order, ElementsAre("iob1", "iob2", "iob3", "iob4", "iob5"));
 }
 
+TEST_F(DataFlowTest, Transaction) {
+  std::vector<std::string> execution_order;
+
+  // Connect blocks with cycles
+  ConnectBlocksAcyclic();
+  ConnectBlocksCyclic();
+
+  // A transaction which leaves cycles is rolled back
+  EXPECT_TRUE(scheme.beginTransaction());
+  EXPECT_FALSE(scheme.beginTransaction());
+  AddBlocks();
+  EXPECT_TRUE(scheme.inTransaction());
+  EXPECT_FALSE(scheme.commitTransaction());
+  EXPECT_FALSE(scheme.inTransaction());
+  EXPECT_FALSE(scheme.commitTransaction());
+  EXPECT_EQ(scheme.getBlocks().size(),0);
+
+  // Latching the cycles in the same transaction makes it executable
+  EXPECT_TRUE(scheme.beginTransaction());
+  AddBlocks();
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob1",true));
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob2",true));
+  EXPECT_TRUE(scheme.commitTransaction());
+  EXPECT_EQ(scheme.getBlocks().size(),5);
+  EXPECT_TRUE(scheme.getExecutionOrder(execution_order));
+  EXPECT_THAT(execution_order, ElementsAre("iob1", "iob2", "iob3", "iob4", "iob5"));
+
+  // Aborting restores removed blocks and their latches
+  EXPECT_TRUE(scheme.beginTransaction());
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob1",false));
+  EXPECT_TRUE(scheme.removeBlock("iob5"));
+  EXPECT_TRUE(scheme.abortTransaction());
+  EXPECT_EQ(scheme.getBlocks().size(),5);
+  EXPECT_TRUE(scheme.executable());
+
+  // Unlatching a cycle is rolled back on commit
+  EXPECT_TRUE(scheme.beginTransaction());
+  EXPECT_TRUE(scheme.latchInputs("iob2",false));
+  EXPECT_FALSE(scheme.commitTransaction());
+  EXPECT_TRUE(scheme.executable());
+  EXPECT_EQ(1,scheme.minLatchCount());
+}
+
 TEST_F(DataFlowTest, Latchanalysis) {
   std::vector<std::vector<std::string> > flow_cycles, exec_cycles;
 
@@ -433,6 +675,29 @@ TEST_F(DataFlowTest, Latchanalysis) {
   EXPECT_EQ(1,scheme.minLatchCount());
 }
 
+TEST_F(DataFlowTest, LatchCountBounds) {
+  // Connect blocks with cycles
+  ConnectBlocksAcyclic();
+  ConnectBlocksCyclic();
+  AddBlocks();
+
+  // Latch one connection inside every cycle and another on only some
+  scheme.latchConnections("iob5","iob1",true);
+  scheme.latchConnections("iob3","iob4",true);
+
+  // The c1 and c2 cycles cross both latches, c3 and c4 only cross one
+  EXPECT_EQ(1,scheme.latchCount(c1));
+  EXPECT_EQ(2,scheme.maxLatchCount());
+  EXPECT_EQ(1,scheme.minLatchCount());
+
+  // Unlatch everything
+  scheme.latchConnections("iob5","iob1",false);
+  scheme.latchConnections("iob3","iob4",false);
+
+  EXPECT_EQ(0,scheme.maxLatchCount());
+  EXPECT_EQ(0,scheme.minLatchCount());
+}
+
 TEST_F(DataFlowTest, StartAcyclic) {
   // Connect blocks without cycles
   ConnectBlocksAcyclic();
@@ -466,12 +731,894 @@ TEST_F(DataFlowTest, StartLatchConnections) {
   EXPECT_FALSE(scheme.latchConnections("iob5","iob1",true));
 
   scheme.stop();
-  EXPECT_FALSE(scheme.regenerateModel());
+  EXPECT_FALSE(scheme.refreshModel());
   EXPECT_TRUE(scheme.latchConnections("iob5","iob1",true));
   EXPECT_TRUE(scheme.latchConnections("iob5","iob2",true));
   EXPECT_TRUE(scheme.regenerateModel());
 }
 
+TEST_F(DataFlowTest, StartCompactModel) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+  scheme.computeConflicts();
+  EXPECT_EQ(scheme.getCompactModel().size(),0);
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  // The model is frozen while running
+  EXPECT_TRUE(scheme.start());
+  const conman::graph::CompactModel &model = scheme.getCompactModel();
+  ASSERT_EQ(model.size(),5);
+
+  // Ids are assigned in execution order
+  std::vector<std::string> execution_order;
+  EXPECT_TRUE(scheme.getExecutionOrder(execution_order));
+  EXPECT_THAT(execution_order, ElementsAre("iob1", "iob2", "iob3", "iob4", "iob5"));
+
+  conman::graph::BlockId id;
+  EXPECT_TRUE(model.getId(&iob5, id));
+  EXPECT_EQ(id,4);
+
+  // iob1 feeds iob2, iob3, and iob5
+  EXPECT_EQ(model.exec_out.degree(0),3);
+  EXPECT_EQ(model.exec_in.degree(4),2);
+  conman::BlockHandle iob5_handle;
+  EXPECT_TRUE(scheme.getBlockHandle("iob5",iob5_handle));
+  EXPECT_EQ(model.indices[4],iob5_handle);
+
+  // The frozen ESG can't be changed behind the snapshot's back
+  EXPECT_FALSE(scheme.latchConnections(&iob1,&iob2,true));
+  EXPECT_EQ(model.exec_out.degree(0),3);
+
+  // Plans compiled while running are built from the snapshot
+  EXPECT_TRUE(scheme.enableBlock("iob1",false));
+  EXPECT_TRUE(scheme.enableBlock("iob5",false));
+  scheme.updateHook();
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+
+  scheme.stop();
+  EXPECT_EQ(scheme.getCompactModel().size(),0);
+}
+
+TEST_F(DataFlowTest, ActiveBlocks) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  // Only running blocks are in the execution plan
+  EXPECT_EQ(0,scheme.getBlockPhases().size());
+  EXPECT_TRUE(scheme.enableBlock("iob2",false));
+  EXPECT_TRUE(scheme.enableBlock("iob4",false));
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+  EXPECT_TRUE(scheme.disableBlock("iob2"));
+  EXPECT_EQ(1,scheme.getBlockPhases().size());
+
+  // Blocks started outside of the scheme are picked up by the audit
+  EXPECT_TRUE(iob1.start());
+  scheme.updateHook();
+  EXPECT_EQ(1,scheme.getBlockPhases().size());
+  EXPECT_TRUE(scheme.auditExecutionPlan());
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+  EXPECT_FALSE(scheme.auditExecutionPlan());
+
+  // So are changes to the rates
+  EXPECT_TRUE(scheme.setPeriod(0.01));
+  EXPECT_TRUE(scheme.auditExecutionPlan());
+  EXPECT_TRUE(iob1.conman_hook_->setDesiredMinPeriod(0.05));
+  EXPECT_TRUE(scheme.auditExecutionPlan());
+  EXPECT_FALSE(scheme.auditExecutionPlan());
+}
+
+TEST_F(DataFlowTest, BackgroundAudit) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  scheme.properties()->getPropertyType<RTT::Seconds>("audit_period")->set(0.01);
+  EXPECT_TRUE(scheme.start());
+  EXPECT_TRUE(scheme.enableBlock("iob2",false));
+
+  // Blocks started outside of a running scheme are picked up without
+  // auditing the plan explicitly
+  EXPECT_TRUE(iob4.start());
+  for(int i=0; i < 100 && scheme.getBlockPhases().size() < 2; i++) {
+    usleep(10000);
+  }
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+
+  EXPECT_TRUE(scheme.stop());
+}
+
+TEST_F(DataFlowTest, BlockHandles) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  EXPECT_TRUE(scheme.setGroupMembers("first",blocks[0]));
+
+  // Resolve the names once
+  conman::BlockHandle iob2_handle;
+  conman::GroupHandle group_handle;
+  std::vector<conman::BlockHandle> first, second, group_members;
+  std::vector<std::string> second_names;
+  second_names += "iob2", "iob4";
+
+  EXPECT_FALSE(scheme.getBlockHandle("fail",iob2_handle));
+  EXPECT_TRUE(scheme.getBlockHandle("iob2",iob2_handle));
+  EXPECT_TRUE(scheme.getBlockHandles(second_names,second));
+  EXPECT_EQ(iob2_handle,second[0]);
+  EXPECT_TRUE(scheme.getGroupHandle("first",group_handle));
+  EXPECT_TRUE(scheme.getGroupMembers(group_handle,first));
+  ASSERT_EQ(1,first.size());
+
+  std::string name;
+  EXPECT_TRUE(scheme.getBlockName(first[0],name));
+  EXPECT_EQ("iob1",name);
+
+  // iob1 and iob2 conflict on the exclusive input of iob3
+  EXPECT_TRUE(scheme.setEnabledBlocks(second,true));
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_TRUE(iob4.isRunning());
+  EXPECT_FALSE(scheme.enableable(first));
+  EXPECT_FALSE(scheme.enableBlocks(first,true,false));
+
+  EXPECT_TRUE(scheme.switchBlocks(second,first,true,false));
+  EXPECT_TRUE(iob1.isRunning());
+  EXPECT_FALSE(iob2.isRunning());
+  EXPECT_FALSE(iob4.isRunning());
+
+  // Invalid handles are rejected
+  std::vector<conman::BlockHandle> invalid(1, 5);
+  EXPECT_FALSE(scheme.enableBlocks(invalid,true,false));
+
+  EXPECT_TRUE(scheme.disableBlocks(first,true));
+  EXPECT_FALSE(iob1.isRunning());
+}
+
+TEST_F(DataFlowTest, ConflictMatrix) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  std::vector<std::string> first_names, second_names;
+  first_names += "iob1", "iob5";
+  second_names += "iob2", "iob3";
+
+  std::vector<conman::BlockHandle> first, second;
+  EXPECT_TRUE(scheme.getBlockHandles(first_names,first));
+  EXPECT_TRUE(scheme.getBlockHandles(second_names,second));
+
+  EXPECT_TRUE(scheme.enableBlocks(first,true,false));
+  EXPECT_FALSE(scheme.enableable(second));
+  EXPECT_TRUE(scheme.enableable(std::string("iob3")));
+
+  // Forcing the switch disables only the conflicting block
+  EXPECT_TRUE(scheme.enableBlocks(second,true,true));
+  EXPECT_FALSE(iob1.isRunning());
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_TRUE(iob3.isRunning());
+  EXPECT_TRUE(iob5.isRunning());
+
+  // The conflicts are kept when other blocks are removed
+  EXPECT_TRUE(scheme.disableBlocks(true));
+  EXPECT_TRUE(scheme.removeBlock(&iob4));
+  EXPECT_TRUE(scheme.getBlockHandles(first_names,first));
+  EXPECT_TRUE(scheme.getBlockHandles(second_names,second));
+  EXPECT_TRUE(scheme.enableBlocks(first,true,false));
+  EXPECT_FALSE(scheme.enableable(second));
+}
+
+TEST_F(DataFlowTest, ExternalConflicts) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  // A block stopped outside of the scheme is picked up the next time the
+  // execution plan is compiled
+  EXPECT_TRUE(scheme.enableBlock("iob1",false));
+  EXPECT_TRUE(iob1.stop());
+  EXPECT_TRUE(scheme.enableBlock("iob4",false));
+  EXPECT_TRUE(scheme.enableable(std::string("iob2")));
+  EXPECT_TRUE(scheme.enableBlock("iob2",false));
+  EXPECT_FALSE(iob1.isRunning());
+
+  // Before then, a forced enable still gets past it
+  EXPECT_TRUE(scheme.enableBlock("iob1",true));
+  EXPECT_TRUE(iob1.stop());
+  EXPECT_TRUE(scheme.enableBlock("iob2",true));
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_FALSE(iob1.isRunning());
+
+  // The same goes for enabling a list of blocks
+  EXPECT_TRUE(scheme.enableBlock("iob1",true));
+  EXPECT_FALSE(iob2.isRunning());
+  EXPECT_TRUE(iob1.stop());
+  std::vector<std::string> second_names;
+  second_names += "iob2";
+  EXPECT_TRUE(scheme.enableBlocks(second_names,true,true));
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_FALSE(iob1.isRunning());
+
+  // A block started outside of the scheme conflicts once it's picked up
+  EXPECT_TRUE(scheme.disableBlock("iob2"));
+  EXPECT_TRUE(iob1.start());
+  EXPECT_TRUE(scheme.disableBlock("iob4"));
+  EXPECT_FALSE(scheme.enableable(std::string("iob2")));
+  EXPECT_FALSE(scheme.enableBlock("iob2",false));
+  EXPECT_TRUE(scheme.enableBlock("iob2",true));
+  EXPECT_FALSE(iob1.isRunning());
+}
+
+TEST_F(DataFlowTest, Modes) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  std::vector<std::string> a_blocks, b_blocks, bad_blocks, b_group;
+  a_blocks += "iob1", "iob5";
+  b_group += "iob2", "iob3";
+  b_blocks += "b_group";
+  bad_blocks += "iob1", "iob2";
+
+  EXPECT_TRUE(scheme.addGroup("b_group"));
+  EXPECT_TRUE(scheme.setGroupMembers("b_group", b_group));
+
+  EXPECT_TRUE(scheme.defineMode("a", a_blocks));
+  EXPECT_TRUE(scheme.defineMode("b", b_blocks));
+  // Modes can't contain conflicting blocks
+  EXPECT_FALSE(scheme.defineMode("bad", bad_blocks));
+  EXPECT_FALSE(scheme.hasMode("bad"));
+  EXPECT_THAT(scheme.getModes(), ElementsAre("a", "b"));
+
+  EXPECT_TRUE(scheme.enableBlock("iob4",false));
+
+  EXPECT_TRUE(scheme.switchMode("a"));
+  EXPECT_TRUE(iob1.isRunning());
+  EXPECT_FALSE(iob2.isRunning());
+  EXPECT_FALSE(iob3.isRunning());
+  EXPECT_FALSE(iob4.isRunning());
+  EXPECT_TRUE(iob5.isRunning());
+
+  conman::ModeHandle b;
+  EXPECT_TRUE(scheme.getModeHandle("b", b));
+  EXPECT_TRUE(scheme.switchMode(b));
+  EXPECT_FALSE(iob1.isRunning());
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_TRUE(iob3.isRunning());
+  EXPECT_FALSE(iob5.isRunning());
+
+  EXPECT_EQ(2, scheme.properties()->getPropertyType<unsigned int>("switch_count")->get());
+
+  // Handles are renumbered when modes are removed
+  EXPECT_TRUE(scheme.removeMode("a"));
+  EXPECT_FALSE(scheme.switchMode("a"));
+  EXPECT_TRUE(scheme.getModeHandle("b", b));
+  EXPECT_EQ(0, b);
+}
+
+TEST_F(DataFlowTest, RequestMode) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  std::vector<std::string> a_blocks, b_blocks;
+  a_blocks += "iob1", "iob5";
+  b_blocks += "iob2", "iob3";
+  EXPECT_TRUE(scheme.defineMode("a", a_blocks));
+  EXPECT_TRUE(scheme.defineMode("b", b_blocks));
+  EXPECT_FALSE(scheme.requestMode(std::string("c")));
+
+  // Requests are only applied at the start of a cycle
+  EXPECT_TRUE(scheme.requestMode(std::string("a")));
+  EXPECT_FALSE(iob1.isRunning());
+  scheme.updateHook();
+  EXPECT_TRUE(iob1.isRunning());
+  EXPECT_TRUE(iob5.isRunning());
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+
+  // Only the most recent request is applied
+  conman::ModeHandle a, b;
+  EXPECT_TRUE(scheme.getModeHandle("a", a));
+  EXPECT_TRUE(scheme.getModeHandle("b", b));
+  EXPECT_TRUE(scheme.requestMode(a));
+  EXPECT_TRUE(scheme.requestMode(b));
+  scheme.updateHook();
+  EXPECT_FALSE(iob1.isRunning());
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_TRUE(iob3.isRunning());
+  EXPECT_FALSE(iob5.isRunning());
+
+  EXPECT_EQ(2, scheme.properties()->getPropertyType<unsigned int>("switch_count")->get());
+
+  // Modes can't be removed while a switch is pending
+  std::vector<std::string> c_blocks;
+  c_blocks += "iob4", "iob5";
+  EXPECT_TRUE(scheme.defineMode("c", c_blocks));
+  EXPECT_TRUE(iob5.cleanup());
+  EXPECT_TRUE(scheme.requestMode(std::string("c")));
+  EXPECT_FALSE(scheme.removeMode("a"));
+
+  // A switch which can't be completed is rolled back
+  scheme.updateHook();
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_TRUE(iob3.isRunning());
+  EXPECT_FALSE(iob4.isRunning());
+  EXPECT_FALSE(iob5.isRunning());
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+  EXPECT_TRUE(scheme.removeMode("a"));
+}
+
+TEST_F(DataFlowTest, Standby) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+
+  EXPECT_TRUE(scheme.enableBlock("iob1",false));
+
+  // Blocks in standby are executed, but don't conflict with running blocks
+  EXPECT_TRUE(scheme.standbyBlock("iob2"));
+  EXPECT_TRUE(scheme.inStandby("iob2"));
+  EXPECT_TRUE(iob1.isRunning());
+  EXPECT_TRUE(iob2.isRunning());
+  EXPECT_EQ(2,scheme.getBlockPhases().size());
+  EXPECT_FALSE(scheme.enableable(std::string("iob2")));
+
+  // Promoting the block still checks for conflicts
+  EXPECT_FALSE(scheme.enableBlock("iob2",false));
+  EXPECT_TRUE(scheme.enableBlock("iob2",true));
+  EXPECT_FALSE(scheme.inStandby("iob2"));
+  EXPECT_FALSE(iob1.isRunning());
+  EXPECT_TRUE(iob2.isRunning());
+
+  // Enabled blocks can be put back into standby without stopping them
+  EXPECT_TRUE(scheme.standbyBlock("iob2"));
+  EXPECT_TRUE(scheme.inStandby("iob2"));
+  EXPECT_TRUE(scheme.enableBlock("iob1",false));
+
+  // Disabling a block takes it out of standby
+  EXPECT_TRUE(scheme.disableBlock("iob2"));
+  EXPECT_FALSE(scheme.inStandby("iob2"));
+  EXPECT_FALSE(iob2.isRunning());
+}
+
+TEST_F(DataFlowTest, StartWavefront) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::WAVEFRONT);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(2);
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+  EXPECT_TRUE(scheme.enableBlocks(blocks,true,false));
+
+  // Overrun policies other than EVENT aren't applied by the executors
+  scheme.properties()->getPropertyType<conman::OverrunPolicy::Mode>("overrun_policy")->set(conman::OverrunPolicy::SKIP);
+  EXPECT_FALSE(scheme.start());
+  scheme.properties()->getPropertyType<conman::OverrunPolicy::Mode>("overrun_policy")->set(conman::OverrunPolicy::EVENT);
+
+  EXPECT_TRUE(scheme.start());
+  for(int i=0; i < 100; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(RTT::TaskContext::Running, scheme.getTaskState());
+  EXPECT_TRUE(scheme.stop());
+}
+
+TEST_F(SchemeTest, WavefrontReplan) {
+  std::vector<std::string> log;
+  RTT::os::Mutex log_mutex;
+  OrderBlock a("a", log, log_mutex), b("b", log, log_mutex), c("c", log, log_mutex);
+
+  // a feeds b and c, and b feeds c
+  a.out1.connectTo(&b.in1);
+  a.out2.connectTo(&c.in2);
+  b.out1.connectTo(&c.in1);
+
+  EXPECT_TRUE(scheme.addBlock(&a));
+  EXPECT_TRUE(scheme.addBlock(&b));
+  EXPECT_TRUE(scheme.addBlock(&c));
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::WAVEFRONT);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(2);
+
+  std::vector<std::string> blocks;
+  blocks += "a", "b", "c";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+  EXPECT_TRUE(scheme.enableBlocks(blocks,true,false));
+  EXPECT_TRUE(scheme.start());
+
+  // Publish a new plan with a different number of levels every cycle
+  for(int i=0; i < 100; i++) {
+    if(i % 2 == 0) {
+      EXPECT_TRUE(scheme.disableBlock("b"));
+    } else {
+      EXPECT_TRUE(scheme.enableBlock("b",false));
+    }
+
+    log.clear();
+    scheme.updateHook();
+
+    if(i % 2 == 0) {
+      EXPECT_THAT(log, ElementsAre("a", "c"));
+    } else {
+      EXPECT_THAT(log, ElementsAre("a", "b", "c"));
+    }
+  }
+
+  EXPECT_EQ(RTT::TaskContext::Running, scheme.getTaskState());
+  EXPECT_TRUE(scheme.stop());
+}
+
+TEST_F(DataFlowTest, StartWorkStealing) {
+  // Connect blocks without cycles
+  ConnectBlocksAcyclic();
+  AddBlocks();
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::WORK_STEALING);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(2);
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+  EXPECT_TRUE(scheme.enableBlocks(blocks,true,false));
+
+  EXPECT_TRUE(scheme.start());
+  for(int i=0; i < 100; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(RTT::TaskContext::Running, scheme.getTaskState());
+
+  // One entry for the scheme's thread and one for each worker
+  EXPECT_EQ(3,scheme.getWorkerUtilization().size());
+
+  EXPECT_TRUE(scheme.stop());
+  EXPECT_EQ(0,scheme.getWorkerUtilization().size());
+}
+
+TEST_F(DataFlowTest, StartPipeline) {
+  // Connect blocks with latched cycles
+  ConnectBlocksAcyclic();
+  ConnectBlocksCyclic();
+  AddBlocks();
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob1",true));
+  EXPECT_TRUE(scheme.latchConnections("iob5","iob2",true));
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::PIPELINE);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(1);
+
+  std::vector<std::string> blocks;
+  blocks += "iob1", "iob2", "iob3", "iob4", "iob5";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+  EXPECT_TRUE(scheme.enableBlocks(blocks,true,false));
+
+  EXPECT_TRUE(scheme.start());
+  for(int i=0; i < 100; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(RTT::TaskContext::Running, scheme.getTaskState());
+
+  // The latched connections are within a single stage, so they add no latency
+  EXPECT_EQ(1,scheme.getStageLatencies().size());
+  EXPECT_EQ(0,scheme.getStageLatencies()[0]);
+  EXPECT_EQ(1,scheme.getStageLoads().size());
+  EXPECT_EQ(2,scheme.getWorkerUtilization().size());
+
+  EXPECT_TRUE(scheme.stop());
+  EXPECT_EQ(0,scheme.getStageLatencies().size());
+  EXPECT_EQ(0,scheme.getStageLoads().size());
+}
+
+TEST_F(SchemeTest, PipelineLatency) {
+  ValueBlock source("source"), sink("sink");
+  source.out.connectTo(&sink.in);
+
+  EXPECT_TRUE(scheme.addBlock(&source));
+  EXPECT_TRUE(scheme.addBlock(&sink));
+
+  // The latched connection splits the scheme into two stages
+  EXPECT_TRUE(scheme.latchConnections("source","sink",true));
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::PIPELINE);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(1);
+
+  std::vector<std::string> blocks;
+  blocks += "source", "sink";
+  for(size_t i=0; i < blocks.size(); i++) {
+    scheme.getPeer(blocks[i])->configure();
+  }
+  EXPECT_TRUE(scheme.enableBlocks(blocks,true,false));
+
+  EXPECT_TRUE(scheme.start());
+  EXPECT_EQ(2,scheme.getStageLoads().size());
+
+  // The sink always sees the sample that the source wrote in the previous
+  // cycle, even though the stages are executed concurrently
+  for(int i=0; i < 100; i++) {
+    scheme.updateHook();
+    EXPECT_EQ(source.count, sink.count);
+    EXPECT_EQ(double(source.count - 1), sink.received);
+  }
+
+  EXPECT_TRUE(scheme.stop());
+}
+
+TEST_F(SchemeTest, PipelineStandby) {
+  ValueBlock source("source"), sink("sink");
+  source.out.connectTo(&sink.in);
+
+  EXPECT_TRUE(scheme.addBlock(&source));
+  EXPECT_TRUE(scheme.addBlock(&sink));
+  EXPECT_TRUE(scheme.latchConnections("source","sink",true));
+
+  scheme.properties()->getPropertyType<conman::ExecutionMode::Mode>("execution_mode")->set(conman::ExecutionMode::PIPELINE);
+  scheme.properties()->getPropertyType<unsigned int>("n_workers")->set(1);
+
+  source.configure();
+  sink.configure();
+  EXPECT_TRUE(scheme.enableBlock("sink",false));
+
+  // The connection of a block in standby can't be relayed between stages
+  EXPECT_TRUE(scheme.standbyBlock("source"));
+  EXPECT_FALSE(scheme.start());
+
+  // Disabling the block restores its connection
+  EXPECT_TRUE(scheme.disableBlock("source"));
+  EXPECT_TRUE(scheme.start());
+  EXPECT_EQ(2,scheme.getStageLoads().size());
+
+  // A block whose connection is relayed can't be put into standby
+  EXPECT_FALSE(scheme.standbyBlock("source"));
+  EXPECT_FALSE(source.isRunning());
+
+  // The relayed connection still works
+  EXPECT_TRUE(scheme.enableBlock("source",false));
+  for(int i=0; i < 10; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(double(source.count - 1), sink.received);
+
+  EXPECT_TRUE(scheme.stop());
+}
+
+TEST_F(SchemeTest, CycleBudget) {
+  CountingBlock critical("critical"), best_effort("best_effort");
+  EXPECT_TRUE(scheme.addBlock(&critical));
+  EXPECT_TRUE(scheme.addBlock(&best_effort));
+  EXPECT_TRUE(critical.conman_hook_->setCriticality(conman::Criticality::CRITICAL));
+
+  critical.configure();
+  best_effort.configure();
+  EXPECT_TRUE(scheme.enableBlock("critical",false));
+  EXPECT_TRUE(scheme.enableBlock("best_effort",false));
+
+  // Every cycle overruns a one-nanosecond budget
+  scheme.properties()->getPropertyType<RTT::nsecs>("cycle_budget")->set(1);
+  scheme.properties()->getPropertyType<conman::OverrunPolicy::Mode>("overrun_policy")->set(conman::OverrunPolicy::SKIP);
+
+  for(int i=0; i < 10; i++) {
+    scheme.updateHook();
+  }
+
+  // Only the critical block is executed
+  EXPECT_EQ(10,critical.count);
+  EXPECT_EQ(0,best_effort.count);
+  EXPECT_EQ(10,scheme.properties()->getPropertyType<unsigned int>("overrun_count")->get());
+
+  // Without a budget, both blocks are executed
+  scheme.properties()->getPropertyType<RTT::nsecs>("cycle_budget")->set(0);
+  scheme.updateHook();
+  EXPECT_EQ(11,critical.count);
+  EXPECT_EQ(1,best_effort.count);
+
+  // Budgets longer than 2^32 nanoseconds aren't truncated
+  scheme.properties()->getPropertyType<RTT::nsecs>("cycle_budget")->set(5000000000LL);
+  scheme.updateHook();
+  EXPECT_EQ(12,critical.count);
+  EXPECT_EQ(2,best_effort.count);
+  EXPECT_EQ(10,scheme.properties()->getPropertyType<unsigned int>("overrun_count")->get());
+}
+
+TEST_F(SchemeTest, Instrumentation) {
+  CountingBlock block("block");
+  EXPECT_TRUE(scheme.addBlock(&block));
+  block.configure();
+  EXPECT_TRUE(scheme.enableBlock("block",false));
+
+  boost::shared_ptr<conman::Hook> hook = conman::Hook::GetHook(&block);
+
+  EXPECT_FALSE(scheme.setInstrumentation(conman::Instrumentation::SAMPLED, 0));
+  EXPECT_TRUE(scheme.setInstrumentation(conman::Instrumentation::OFF, 1));
+  EXPECT_EQ(conman::Instrumentation::OFF, hook->getInstrumentation());
+
+  // Blocks still execute without statistics
+  for(int i=0; i < 10; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(10,block.count);
+  EXPECT_EQ(0.0,hook->getDurationMax());
+
+  // Sampled statistics are only computed every few executions
+  EXPECT_TRUE(hook->setInstrumentation(conman::Instrumentation::SAMPLED, 5));
+  for(int i=0; i < 4; i++) {
+    scheme.updateHook();
+  }
+  EXPECT_EQ(0.0,hook->getDurationMax());
+  scheme.updateHook();
+  EXPECT_EQ(15,block.count);
+  EXPECT_LT(0.0,hook->getDurationMax());
+
+  // The statistics properties are still reported in seconds
+  RTT::Property<RTT::Seconds> *max_duration =
+    block.provides("conman_hook")->properties()->getPropertyType<RTT::Seconds>("max_exec_duration");
+  ASSERT_TRUE(max_duration != NULL);
+  EXPECT_EQ(hook->getDurationMax(),max_duration->get());
+}
+
+TEST(ExecutionPlanTest, RateDivisor) {
+  // Schemes without a fixed period let the hooks decide
+  EXPECT_EQ(0,conman::ExecutionPlan::RateDivisor(0.0,0.01));
+
+  // Blocks run at least once per scheme cycle
+  EXPECT_EQ(1,conman::ExecutionPlan::RateDivisor(0.001,0.0));
+  EXPECT_EQ(1,conman::ExecutionPlan::RateDivisor(0.001,0.0005));
+  EXPECT_EQ(1,conman::ExecutionPlan::RateDivisor(0.001,0.001));
+
+  // Exact multiples don't get rounded up by floating-point error
+  EXPECT_EQ(10,conman::ExecutionPlan::RateDivisor(0.001,0.01));
+  EXPECT_EQ(3,conman::ExecutionPlan::RateDivisor(0.001,0.003));
+
+  // Non-multiples never run faster than the desired minimum period
+  EXPECT_EQ(2,conman::ExecutionPlan::RateDivisor(0.001,0.0015));
+
+  // Periods in nanoseconds are compared exactly
+  EXPECT_EQ(3,conman::ExecutionPlan::RateDivisor(RTT::nsecs(1000000),RTT::nsecs(3000000)));
+  EXPECT_EQ(4,conman::ExecutionPlan::RateDivisor(RTT::nsecs(1000000),RTT::nsecs(3000001)));
+}
+
+TEST(ExecutionPlanTest, Slots) {
+  conman::ExecutionPlan plan;
+  plan.steps.resize(3);
+  plan.steps[0].rate_divisor = 1;
+  plan.steps[0].phase = 0;
+  plan.steps[1].rate_divisor = 2;
+  plan.steps[1].phase = 1;
+  plan.steps[2].rate_divisor = 5;
+  plan.steps[2].phase = 3;
+
+  // The hyperperiod is the least common multiple of the divisors
+  EXPECT_TRUE(plan.computeSlots(1000));
+  EXPECT_EQ(10,plan.hyperperiod);
+  EXPECT_EQ(11,plan.slot_offsets.size());
+
+  std::vector<unsigned int> slot0(
+      plan.slot_steps.begin() + plan.slot_offsets[0],
+      plan.slot_steps.begin() + plan.slot_offsets[1]);
+  EXPECT_THAT(slot0, ElementsAre(0));
+
+  std::vector<unsigned int> slot3(
+      plan.slot_steps.begin() + plan.slot_offsets[3],
+      plan.slot_steps.begin() + plan.slot_offsets[4]);
+  EXPECT_THAT(slot3, ElementsAre(0,1,2));
+
+  // Each step appears once per period
+  EXPECT_EQ(10+5+2,plan.slot_steps.size());
+
+  // Schedules which are too long aren't precomputed
+  EXPECT_FALSE(plan.computeSlots(5));
+  EXPECT_EQ(0,plan.hyperperiod);
+  EXPECT_EQ(0,plan.slot_steps.size());
+
+  // Aperiodic schemes don't have a static schedule
+  plan.steps[1].rate_divisor = 0;
+  EXPECT_TRUE(plan.computeSlots(1000));
+  EXPECT_EQ(0,plan.hyperperiod);
+}
+
+TEST(ExecutionPlanTest, BalancePhases) {
+  conman::ExecutionPlan plan;
+
+  // One fast block and four slow blocks, with an edge from 1 to 2
+  plan.steps.resize(5);
+  for(size_t i=0; i < plan.steps.size(); i++) {
+    plan.steps[i].rate_divisor = (i == 0) ? 1 : 4;
+    plan.steps[i].phase = 0;
+    plan.steps[i].load = 1000;
+  }
+  plan.successor_offsets += 0, 0, 1, 1, 1, 1;
+  plan.successors += 2;
+
+  std::vector<bool> pinned(plan.steps.size(), false);
+  EXPECT_TRUE(plan.balancePhases(pinned, 1000));
+
+  // Connected blocks with the same rate share a phase
+  EXPECT_EQ(plan.steps[1].phase, plan.steps[2].phase);
+
+  // The slow blocks are spread out so no cycle runs more than two of them
+  EXPECT_TRUE(plan.computeSlots(1000));
+  std::vector<RTT::nsecs> loads;
+  plan.getSlotLoads(loads);
+  EXPECT_EQ(4,loads.size());
+  EXPECT_EQ(3000,*std::max_element(loads.begin(), loads.end()));
+  EXPECT_EQ(1000,*std::min_element(loads.begin(), loads.end()));
+
+  // Pinned blocks keep their phases
+  pinned[3] = true;
+  plan.steps[3].phase = 3;
+  EXPECT_TRUE(plan.balancePhases(pinned, 1000));
+  EXPECT_EQ(3,plan.steps[3].phase);
+}
+
+TEST(DynamicTopologicalOrderTest, AddEdges) {
+  typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS> Graph;
+  Graph graph(4);
+
+  conman::graph::DynamicTopologicalOrder<Graph> topology;
+  EXPECT_TRUE(topology.reset(graph));
+  EXPECT_EQ(topology.order().size(),4);
+
+  // Insert edges which contradict the initial order
+  std::vector<std::pair<int,int> > edges;
+  edges.push_back(std::make_pair(0,1));
+  edges.push_back(std::make_pair(2,3));
+  edges.push_back(std::make_pair(1,2));
+
+  for(size_t i=0; i < edges.size(); i++) {
+    boost::add_edge(edges[i].first, edges[i].second, graph);
+    EXPECT_TRUE(topology.addEdge(graph, edges[i].first, edges[i].second));
+  }
+
+  EXPECT_TRUE(topology.valid());
+  EXPECT_THAT(topology.order(), ElementsAre(0,1,2,3));
+
+  // Closing a cycle invalidates the order
+  boost::add_edge(3, 0, graph);
+  EXPECT_FALSE(topology.addEdge(graph, 3, 0));
+  EXPECT_FALSE(topology.valid());
+
+  // Breaking the cycle allows the order to be recomputed
+  boost::remove_edge(3, 0, graph);
+  EXPECT_TRUE(topology.reset(graph));
+  EXPECT_THAT(topology.order(), ElementsAre(0,1,2,3));
+}
+
+TEST(FeedbackArcSetTest, Weights) {
+  using conman::graph::WeightedArc;
+
+  // Two cycles which share the arc 0 -> 1, and a self-loop
+  std::vector<WeightedArc> arcs;
+  arcs.push_back(WeightedArc(0,1,1.0));
+  arcs.push_back(WeightedArc(1,2,1.0));
+  arcs.push_back(WeightedArc(2,0,1.0));
+  arcs.push_back(WeightedArc(1,3,1.0));
+  arcs.push_back(WeightedArc(3,0,1.0));
+  arcs.push_back(WeightedArc(3,3,0.5));
+
+  std::vector<size_t> feedback_arcs;
+
+  // The shared arc breaks both cycles
+  EXPECT_EQ(1.5,conman::graph::FeedbackArcSet(4, arcs, feedback_arcs));
+  EXPECT_THAT(feedback_arcs, ElementsAre(0,5));
+
+  // Unless it's expensive
+  arcs[0].weight = 5.0;
+  EXPECT_EQ(2.5,conman::graph::FeedbackArcSet(4, arcs, feedback_arcs));
+  EXPECT_EQ(feedback_arcs.size(),3);
+
+  // The heuristic also breaks every cycle
+  EXPECT_LE(2.5,conman::graph::FeedbackArcSet(4, arcs, feedback_arcs, 0));
+  EXPECT_TRUE(std::find(feedback_arcs.begin(), feedback_arcs.end(), 5) != feedback_arcs.end());
+}
+
+TEST(CompactGraphTest, Build) {
+  std::vector<std::pair<conman::graph::BlockId, conman::graph::BlockId> > edges;
+  edges.push_back(std::make_pair(2,0));
+  edges.push_back(std::make_pair(0,2));
+  edges.push_back(std::make_pair(0,1));
+  edges.push_back(std::make_pair(0,2));
+
+  conman::graph::CompactAdjacency adjacency;
+  adjacency.build(4, edges);
+
+  // Rows are sorted and parallel edges are merged
+  EXPECT_THAT(adjacency.offsets, ElementsAre(0,2,2,3,3));
+  EXPECT_THAT(adjacency.targets, ElementsAre(1,2,0));
+  EXPECT_EQ(adjacency.degree(0),2);
+  EXPECT_EQ(adjacency.degree(3),0);
+  EXPECT_EQ(adjacency.begin(3),adjacency.end(3));
+
+  adjacency.clear();
+  EXPECT_EQ(adjacency.targets.size(),0);
+}
+
+TEST(TimerTest, Sources) {
+  conman::Timer timer, other_timer;
+  EXPECT_FALSE(timer.setSource(42));
+  EXPECT_EQ(conman::TimerSource::RTT, timer.getSource());
+
+  // The TSC falls back to the raw monotonic clock if it isn't usable
+  EXPECT_TRUE(timer.setSource(conman::TimerSource::TSC));
+  EXPECT_NE(conman::TimerSource::RTT, timer.getSource());
+
+  // Each timer has its own source
+  EXPECT_EQ(conman::TimerSource::RTT, other_timer.getSource());
+
+  // Durations are consistent with the raw monotonic clock
+  const RTT::nsecs start = timer.getNSecs();
+  const RTT::nsecs raw_start = conman::Timer::ReadMonotonicRaw();
+  usleep(10000);
+  const RTT::nsecs elapsed = timer.getNSecs(start);
+  const RTT::nsecs raw_elapsed = conman::Timer::ReadMonotonicRaw() - raw_start;
+  EXPECT_LE(9000000, elapsed);
+  EXPECT_NEAR(raw_elapsed, elapsed, 1000000);
+
+  EXPECT_TRUE(timer.setSource(conman::TimerSource::RTT));
+  EXPECT_EQ(conman::TimerSource::RTT, timer.getSource());
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 